@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace Coffee::Benchmark {
+
+    /**
+     * @brief Measures the time of one call of a function.
+     *
+     * Each run calls the function until at least 10 milliseconds passed, so short functions are not lost in the
+     * resolution of the clock, and the fastest run is kept.
+     *
+     * @param function The function to measure.
+     * @param runs The number of runs.
+     * @return The time of one call in milliseconds.
+     */
+    template <typename Function>
+    double Measure(Function&& function, int runs = 5)
+    {
+        constexpr double minimumRunTime = 10.0;
+
+        double best = std::numeric_limits<double>::max();
+
+        for (int run = 0; run < runs; run++)
+        {
+            uint32_t calls = 0;
+            double elapsed = 0.0;
+
+            auto start = std::chrono::steady_clock::now();
+            do
+            {
+                function();
+                calls++;
+                elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            } while (elapsed < minimumRunTime);
+
+            best = std::min(best, elapsed / calls);
+        }
+
+        return best;
+    }
+
+    /**
+     * @brief Checks if the benchmark was started with --quick, used by CTest to only check the results.
+     * @param argc The argument count of main.
+     * @param argv The arguments of main.
+     * @return True if only the smallest sizes should run.
+     */
+    inline bool IsQuick(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::strcmp(argv[i], "--quick") == 0)
+                return true;
+        }
+
+        return false;
+    }
+
+}
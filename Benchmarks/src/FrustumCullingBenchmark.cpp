@@ -0,0 +1,192 @@
+// Compares the batched culling kernel (CullAABBs, on boxes stored as a structure of arrays and as an array of AABB)
+// with Frustum::Contains called on every box, and with a scalar loop doing the same plane test as the kernel.
+
+#include "Benchmark.h"
+
+#include "CoffeeEngine/Math/Frustum.h"
+#include "CoffeeEngine/Math/FrustumCulling.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Coffee;
+
+namespace {
+
+    constexpr float s_WorldSize = 200.0f; ///< The half size of the area the boxes are spread in.
+
+    std::vector<AABB> CreateBoxes(uint32_t count, std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> position(-s_WorldSize, s_WorldSize);
+        std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+        std::vector<AABB> boxes;
+        boxes.reserve(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 center(position(generator), position(generator) * 0.1f, position(generator));
+            glm::vec3 halfSize(size(generator), size(generator), size(generator));
+            boxes.emplace_back(center - halfSize, center + halfSize);
+        }
+
+        return boxes;
+    }
+
+    // Cameras standing in the middle of the area and looking around it, each one sees a part of the boxes
+    std::vector<Frustum> CreateFrustums(uint32_t count)
+    {
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, s_WorldSize);
+
+        std::vector<Frustum> frustums;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            float angle = glm::radians(360.0f) * i / count;
+            glm::vec3 eye(0.0f, 5.0f, 0.0f);
+            glm::vec3 direction(std::cos(angle), -0.1f, std::sin(angle));
+            frustums.emplace_back(projection * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+
+        return frustums;
+    }
+
+    // The distance of the p-vertex of a box to a plane, negative when the box is fully behind it
+    float GetDistance(const glm::vec4& plane, const AABB& box)
+    {
+        glm::vec3 normal(plane);
+        return glm::dot(normal, box.GetCenter()) + plane.w + glm::dot(glm::abs(normal), box.GetHalfSize());
+    }
+
+    bool TouchesPlane(const Frustum& frustum, const AABB& box)
+    {
+        for (int plane = 0; plane < FrustumPlanes::Count; plane++)
+        {
+            if (std::abs(GetDistance(frustum.GetPlanes()[plane], box)) < 1e-3f)
+                return true;
+        }
+
+        return false;
+    }
+
+    // The plane test of the kernel, one box and one plane at a time
+    void CullScalar(const Frustum& frustum, const std::vector<AABB>& boxes, uint8_t* visible)
+    {
+        const glm::vec4* planes = frustum.GetPlanes();
+
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            visible[i] = 1;
+            for (int plane = 0; plane < FrustumPlanes::Count; plane++)
+            {
+                if (GetDistance(planes[plane], boxes[i]) < 0.0f)
+                {
+                    visible[i] = 0;
+                    break;
+                }
+            }
+        }
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = Benchmark::IsQuick(argc, argv);
+
+    std::mt19937 generator(7);
+    std::vector<Frustum> frustums = CreateFrustums(8);
+    std::vector<uint32_t> counts = quick ? std::vector<uint32_t>{10000} : std::vector<uint32_t>{10000, 100000, 1000000};
+
+    std::printf("%10s %10s %10s %14s %14s %14s %14s\n", "boxes", "visible", "extra", "Contains (ms)", "scalar (ms)", "SoA (ms)", "AoS (ms)");
+
+    for (uint32_t count : counts)
+    {
+        std::vector<AABB> boxes = CreateBoxes(count, generator);
+
+        AABBSoA soa;
+        soa.Resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            soa.Set(i, boxes[i]);
+        }
+
+        std::vector<uint8_t> contains(count);
+        std::vector<uint8_t> scalar(count);
+        std::vector<uint8_t> soaVisible(count);
+        std::vector<uint8_t> aosVisible(count);
+
+        // The kernel can keep a few boxes Contains rejects with the frustum corners, it must never cull a visible one
+        uint64_t visibleCount = 0;
+        uint64_t extraCount = 0;
+        for (const Frustum& frustum : frustums)
+        {
+            FrustumPlanes planes(frustum);
+            CullScalar(frustum, boxes, scalar.data());
+            CullAABBs(planes, soa, 0, count, soaVisible.data());
+            CullAABBs(planes, boxes.data(), count, sizeof(AABB), aosVisible.data());
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                contains[i] = frustum.Contains(boxes[i]);
+
+                if (contains[i] && !soaVisible[i])
+                {
+                    std::printf("CullAABBs culled the visible box %u\n", i);
+                    return 1;
+                }
+
+                // The operations are the same, only a box touching a plane could differ with FMA contraction
+                if ((soaVisible[i] != aosVisible[i] || soaVisible[i] != scalar[i]) && !TouchesPlane(frustum, boxes[i]))
+                {
+                    std::printf("The culling paths do not match at box %u\n", i);
+                    return 1;
+                }
+
+                visibleCount += contains[i];
+                extraCount += !contains[i] && soaVisible[i];
+            }
+        }
+
+        double containsTime = Benchmark::Measure([&]() {
+            for (const Frustum& frustum : frustums)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    contains[i] = frustum.Contains(boxes[i]);
+                }
+            }
+        }, 3) / frustums.size();
+
+        double scalarTime = Benchmark::Measure([&]() {
+            for (const Frustum& frustum : frustums)
+            {
+                CullScalar(frustum, boxes, scalar.data());
+            }
+        }, 3) / frustums.size();
+
+        double soaTime = Benchmark::Measure([&]() {
+            for (const Frustum& frustum : frustums)
+            {
+                CullAABBs(FrustumPlanes(frustum), soa, 0, count, soaVisible.data());
+            }
+        }, 3) / frustums.size();
+
+        double aosTime = Benchmark::Measure([&]() {
+            for (const Frustum& frustum : frustums)
+            {
+                CullAABBs(FrustumPlanes(frustum), boxes.data(), count, sizeof(AABB), aosVisible.data());
+            }
+        }, 3) / frustums.size();
+
+        std::printf("%10u %10llu %10llu %14.4f %14.4f %14.4f %14.4f\n", count, (unsigned long long)(visibleCount / frustums.size()),
+                    (unsigned long long)(extraCount / frustums.size()), containsTime, scalarTime, soaTime, aosTime);
+    }
+
+    return 0;
+}
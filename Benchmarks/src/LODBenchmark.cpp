@@ -0,0 +1,334 @@
+// Counts the triangles submitted with and without the levels of detail while a camera walks through a generated
+// outdoor scene: a terrain split in chunks and thousands of rocks, bushes and trees spread over it. The levels are
+// built by MeshSimplifier like Mesh::GenerateLODs does and selected by LODComponent::SelectLevel like the renderer.
+
+#include "Benchmark.h"
+
+#include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Math/Frustum.h"
+#include "CoffeeEngine/Renderer/MeshSimplifier.h"
+#include "CoffeeEngine/Scene/Components.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace Coffee;
+
+namespace {
+
+    constexpr float s_ChunkSize = 32.0f; ///< The size of a terrain chunk, in meters.
+    constexpr uint32_t s_ChunkResolution = 32; ///< The quads along each side of a terrain chunk.
+
+    struct LODMesh
+    {
+        const char* Name = "";
+        std::vector<glm::vec3> Positions;
+        std::vector<uint32_t> Indices;
+        std::vector<std::vector<uint32_t>> LODs; ///< The simplified levels, the first one is level 1.
+        AABB Bounds;
+
+        uint32_t GetLODCount() const { return static_cast<uint32_t>(LODs.size()) + 1; }
+
+        // Levels past the last one return the last one, like Mesh::GetIndexCount
+        uint32_t GetTriangleCount(uint32_t lod) const
+        {
+            if (lod == 0 || LODs.empty())
+                return static_cast<uint32_t>(Indices.size() / 3);
+
+            return static_cast<uint32_t>(LODs[std::min<size_t>(lod, LODs.size()) - 1].size() / 3);
+        }
+    };
+
+    struct Instance
+    {
+        const LODMesh* Mesh;
+        glm::mat4 Transform;
+        AABB WorldBounds;
+    };
+
+    float GetTerrainHeight(float x, float z)
+    {
+        return 20.0f * std::sin(x * 0.01f) * std::cos(z * 0.013f) + 4.0f * std::sin(x * 0.07f + z * 0.05f) +
+               std::sin(x * 0.3f) * std::sin(z * 0.27f);
+    }
+
+    void ComputeBounds(LODMesh& mesh)
+    {
+        mesh.Bounds = AABB(mesh.Positions[0], mesh.Positions[0]);
+        for (const glm::vec3& position : mesh.Positions)
+        {
+            mesh.Bounds.min = glm::min(mesh.Bounds.min, position);
+            mesh.Bounds.max = glm::max(mesh.Bounds.max, position);
+        }
+    }
+
+    // A chunk in local coordinates, its borders are borders of the mesh so the simplifier keeps them
+    LODMesh CreateTerrainChunk(float originX, float originZ)
+    {
+        LODMesh mesh;
+        mesh.Name = "terrain chunk";
+
+        float step = s_ChunkSize / s_ChunkResolution;
+        for (uint32_t z = 0; z <= s_ChunkResolution; z++)
+        {
+            for (uint32_t x = 0; x <= s_ChunkResolution; x++)
+            {
+                mesh.Positions.emplace_back(x * step, GetTerrainHeight(originX + x * step, originZ + z * step), z * step);
+            }
+        }
+
+        for (uint32_t z = 0; z < s_ChunkResolution; z++)
+        {
+            for (uint32_t x = 0; x < s_ChunkResolution; x++)
+            {
+                uint32_t corner = z * (s_ChunkResolution + 1) + x;
+                mesh.Indices.insert(mesh.Indices.end(), {corner, corner + s_ChunkResolution + 1, corner + 1});
+                mesh.Indices.insert(mesh.Indices.end(), {corner + 1, corner + s_ChunkResolution + 1, corner + s_ChunkResolution + 2});
+            }
+        }
+
+        ComputeBounds(mesh);
+        return mesh;
+    }
+
+    // A closed subdivided icosahedron with a bumpy surface, the shape of the props
+    LODMesh CreateProp(const char* name, uint32_t subdivisions, float bumpiness)
+    {
+        LODMesh mesh;
+        mesh.Name = name;
+
+        const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+        mesh.Positions = {{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0}, {0, -1, t}, {0, 1, t},
+                          {0, -1, -t}, {0, 1, -t}, {t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}};
+        mesh.Indices = {0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11, 1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+                        3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9, 4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1};
+
+        for (glm::vec3& position : mesh.Positions)
+            position = glm::normalize(position);
+
+        for (uint32_t level = 0; level < subdivisions; level++)
+        {
+            std::map<std::pair<uint32_t, uint32_t>, uint32_t> midpoints;
+            auto getMidpoint = [&](uint32_t a, uint32_t b) {
+                auto [it, inserted] = midpoints.try_emplace({std::min(a, b), std::max(a, b)}, static_cast<uint32_t>(mesh.Positions.size()));
+                if (inserted)
+                    mesh.Positions.push_back(glm::normalize(mesh.Positions[a] + mesh.Positions[b]));
+                return it->second;
+            };
+
+            std::vector<uint32_t> indices;
+            for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+            {
+                uint32_t a = mesh.Indices[i], b = mesh.Indices[i + 1], c = mesh.Indices[i + 2];
+                uint32_t ab = getMidpoint(a, b), bc = getMidpoint(b, c), ca = getMidpoint(c, a);
+                indices.insert(indices.end(), {a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca});
+            }
+            mesh.Indices = std::move(indices);
+        }
+
+        for (glm::vec3& position : mesh.Positions)
+        {
+            position *= 1.0f + bumpiness * std::sin(position.x * 5.0f) * std::sin(position.y * 7.0f) * std::sin(position.z * 6.0f);
+        }
+
+        ComputeBounds(mesh);
+        return mesh;
+    }
+
+    // The loop of Mesh::GenerateLODs, Mesh itself can not be used without a graphics context
+    void GenerateLODs(LODMesh& mesh, uint32_t maxLevels = 4)
+    {
+        constexpr size_t minLODTriangleCount = 256;
+
+        if (mesh.Indices.size() < minLODTriangleCount * 3)
+            return;
+
+        MeshSimplifier simplifier(mesh.Positions.data(), mesh.Positions.size(), sizeof(glm::vec3));
+
+        for (uint32_t level = 0; level < maxLevels; level++)
+        {
+            const std::vector<uint32_t>& previous = mesh.LODs.empty() ? mesh.Indices : mesh.LODs.back();
+            size_t previousCount = previous.size();
+
+            float error;
+            std::vector<uint32_t> indices = simplifier.Simplify(previous, previousCount / 2, error);
+
+            if (indices.size() * 10 > previousCount * 9)
+                break;
+
+            mesh.LODs.push_back(std::move(indices));
+        }
+    }
+
+    // A walk through the scene at eye height, looking ahead with the head turning from side to side
+    std::vector<std::pair<glm::vec3, glm::mat4>> CreateCameras(uint32_t count, float worldSize)
+    {
+        std::vector<std::pair<glm::vec3, glm::mat4>> cameras;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            float progress = (i + 0.5f) / count;
+            float x = worldSize * (0.1f + 0.8f * progress);
+            float z = worldSize * (0.5f + 0.3f * std::sin(progress * 6.0f));
+            glm::vec3 eye(x, GetTerrainHeight(x, z) + 1.8f, z);
+
+            float yaw = 0.6f * std::sin(i * 0.7f);
+            glm::vec3 direction(std::cos(yaw), -0.05f, std::sin(yaw));
+            cameras.emplace_back(eye, glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+
+        return cameras;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = Benchmark::IsQuick(argc, argv);
+
+    uint32_t chunkCount = quick ? 8 : 32; ///< Chunks along each side of the terrain.
+    uint32_t propCount = quick ? 2000 : 40000;
+    uint32_t cameraCount = quick ? 8 : 64;
+    float worldSize = chunkCount * s_ChunkSize;
+
+    std::mt19937 generator(2024);
+
+    // The scene, each terrain chunk has its own mesh and the props share three meshes
+    std::vector<LODMesh> chunks;
+    chunks.reserve(chunkCount * chunkCount);
+    for (uint32_t z = 0; z < chunkCount; z++)
+    {
+        for (uint32_t x = 0; x < chunkCount; x++)
+        {
+            chunks.push_back(CreateTerrainChunk(x * s_ChunkSize, z * s_ChunkSize));
+        }
+    }
+
+    std::array<LODMesh, 3> props = {CreateProp("rock", 4, 0.2f), CreateProp("bush", 3, 0.1f), CreateProp("tree", 4, 0.05f)};
+
+    auto start = std::chrono::steady_clock::now();
+    for (LODMesh& chunk : chunks)
+        GenerateLODs(chunk);
+    for (LODMesh& prop : props)
+        GenerateLODs(prop);
+    double generationTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const LODMesh* mesh : {&chunks[0], &props[0], &props[1], &props[2]})
+    {
+        std::printf("%-14s levels:", mesh->Name);
+        for (uint32_t lod = 0; lod < mesh->GetLODCount(); lod++)
+        {
+            std::printf(" %6u", mesh->GetTriangleCount(lod));
+
+            if (lod > 0 && mesh->GetTriangleCount(lod) >= mesh->GetTriangleCount(lod - 1))
+            {
+                std::printf("\nThe level %u of %s does not reduce the triangles\n", lod, mesh->Name);
+                return 1;
+            }
+        }
+        std::printf(" triangles\n");
+    }
+
+    std::vector<Instance> instances;
+    for (uint32_t i = 0; i < chunks.size(); i++)
+    {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3((i % chunkCount) * s_ChunkSize, 0.0f, (i / chunkCount) * s_ChunkSize));
+        instances.push_back({&chunks[i], transform, chunks[i].Bounds.CalculateTransformedAABB(transform)});
+    }
+
+    std::uniform_real_distribution<float> position(0.0f, worldSize);
+    std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+    std::uniform_real_distribution<float> size(0.5f, 1.5f);
+    std::uniform_int_distribution<int> kind(0, 2);
+    for (uint32_t i = 0; i < propCount; i++)
+    {
+        const LODMesh& prop = props[kind(generator)];
+        float x = position(generator);
+        float z = position(generator);
+
+        // Trees are tall and thin, rocks and bushes are squashed on the ground
+        glm::vec3 scale = &prop == &props[2] ? glm::vec3(1.5f, 6.0f, 1.5f) * size(generator) : glm::vec3(1.0f, 0.6f, 1.0f) * size(generator);
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, GetTerrainHeight(x, z) + scale.y * 0.5f, z)) *
+                              glm::rotate(glm::mat4(1.0f), angle(generator), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::mat4(1.0f), scale);
+        instances.push_back({&prop, transform, prop.Bounds.CalculateTransformedAABB(transform)});
+    }
+
+    uint64_t fullDetailTriangles = 0;
+    for (const Instance& instance : instances)
+        fullDetailTriangles += instance.Mesh->GetTriangleCount(0);
+
+    std::printf("Scene: %u terrain chunks, %u props, %llu triangles at full detail, LODs generated in %.1f ms\n",
+                chunkCount * chunkCount, propCount, (unsigned long long)fullDetailTriangles, generationTime);
+
+    // Every visible instance is submitted, like the renderer does after the frustum culling
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    LODComponent lod;
+
+    uint64_t visibleCount = 0;
+    uint64_t submittedFull = 0;
+    uint64_t submittedLOD = 0;
+    uint64_t minFull = UINT64_MAX, maxFull = 0, minLOD = UINT64_MAX, maxLOD = 0;
+    std::array<uint64_t, LODComponent::MaxLevels + 1> levelCounts = {};
+
+    std::vector<std::pair<glm::vec3, glm::mat4>> cameras = CreateCameras(cameraCount, worldSize);
+    for (const auto& [eye, view] : cameras)
+    {
+        Frustum frustum(projection * view);
+        uint64_t frameFull = 0;
+        uint64_t frameLOD = 0;
+
+        for (const Instance& instance : instances)
+        {
+            if (!frustum.Contains(instance.WorldBounds))
+                continue;
+
+            uint32_t level = lod.SelectLevel(instance.Mesh->Bounds, instance.Transform, projection, eye, instance.Mesh->GetLODCount());
+
+            visibleCount++;
+            levelCounts[level]++;
+            frameFull += instance.Mesh->GetTriangleCount(0);
+            frameLOD += instance.Mesh->GetTriangleCount(level);
+        }
+
+        submittedFull += frameFull;
+        submittedLOD += frameLOD;
+        minFull = std::min(minFull, frameFull);
+        maxFull = std::max(maxFull, frameFull);
+        minLOD = std::min(minLOD, frameLOD);
+        maxLOD = std::max(maxLOD, frameLOD);
+    }
+
+    if (submittedLOD > submittedFull)
+    {
+        std::printf("The levels of detail submitted more triangles than the full detail meshes\n");
+        return 1;
+    }
+
+    std::printf("Triangles submitted per frame over %u frames, %llu visible instances on average:\n", cameraCount,
+                (unsigned long long)(visibleCount / cameraCount));
+    std::printf("%14s %12s %12s %12s\n", "", "average", "min", "max");
+    std::printf("%14s %12llu %12llu %12llu\n", "full detail", (unsigned long long)(submittedFull / cameraCount),
+                (unsigned long long)minFull, (unsigned long long)maxFull);
+    std::printf("%14s %12llu %12llu %12llu\n", "with LODs", (unsigned long long)(submittedLOD / cameraCount),
+                (unsigned long long)minLOD, (unsigned long long)maxLOD);
+    std::printf("Reduction: %.1f%%\n", submittedFull > 0 ? 100.0 * (1.0 - double(submittedLOD) / double(submittedFull)) : 0.0);
+
+    std::printf("Visible instances per level:");
+    for (size_t level = 0; level < levelCounts.size(); level++)
+    {
+        std::printf(" %zu: %.1f%%", level, visibleCount > 0 ? 100.0 * levelCounts[level] / visibleCount : 0.0);
+    }
+    std::printf("\n");
+
+    return 0;
+}
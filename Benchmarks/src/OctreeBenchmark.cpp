@@ -0,0 +1,229 @@
+// Checks that the loose octree never culls a visible object and compares the cost of its queries with the classic
+// octree, which places each object by its origin. The reference is Frustum::Contains on every object. Also compares
+// the time to fill the octree with Insert, one object at a time, and with Build.
+
+#include "Benchmark.h"
+
+#include "CoffeeEngine/Core/DataStructures/Octree.h"
+#include "CoffeeEngine/Math/Frustum.h"
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Coffee;
+
+namespace {
+
+    constexpr float s_WorldSize = 50.0f; ///< The half size of the root of the octree.
+
+    volatile uint32_t s_VisibleCount = 0; ///< Keeps the compiler from removing the brute force loop.
+
+    std::vector<ObjectContainer<uint32_t>> CreateScene(uint32_t count, std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> position(-s_WorldSize, s_WorldSize);
+        std::uniform_real_distribution<float> smallSize(0.1f, 1.5f);
+        std::uniform_real_distribution<float> largeSize(3.0f, 20.0f);
+        std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+        std::uniform_int_distribution<int> cell(-4, 4);
+        std::uniform_int_distribution<int> kind(0, 9);
+
+        std::vector<ObjectContainer<uint32_t>> objects;
+        objects.reserve(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            glm::vec3 center;
+            glm::vec3 halfSize;
+
+            switch (kind(generator))
+            {
+                case 0:
+                case 1:
+                    // Large objects centered close to the cell boundaries of the first levels, they straddle them
+                    center = glm::vec3(cell(generator), cell(generator), cell(generator)) * (s_WorldSize / 4.0f) +
+                             glm::vec3(jitter(generator), jitter(generator), jitter(generator));
+                    halfSize = glm::vec3(largeSize(generator), largeSize(generator), largeSize(generator));
+                    break;
+                case 2:
+                    // Objects partially or completely out of the bounds of the root
+                    center = glm::vec3(position(generator), position(generator), position(generator)) * 1.2f;
+                    halfSize = glm::vec3(largeSize(generator));
+                    break;
+                default:
+                    center = glm::vec3(position(generator), position(generator), position(generator));
+                    halfSize = glm::vec3(smallSize(generator), smallSize(generator), smallSize(generator));
+                    break;
+            }
+
+            objects.emplace_back(glm::translate(glm::mat4(1.0f), center), AABB(-halfSize, halfSize), i);
+        }
+
+        return objects;
+    }
+
+    // A camera flying along a circle around the world, looking at random points, the frustums of consecutive frames
+    // overlap so the visibility cache is used
+    std::vector<Frustum> CreateFrustums(uint32_t count, std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> target(-s_WorldSize, s_WorldSize);
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 120.0f);
+
+        std::vector<Frustum> frustums;
+        glm::vec3 lookAt(0.0f);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            float angle = 0.02f * i;
+            glm::vec3 eye(std::cos(angle) * s_WorldSize * 0.8f, 10.0f * std::sin(angle * 3.0f), std::sin(angle) * s_WorldSize * 0.8f);
+
+            if (i % 32 == 0)
+            {
+                lookAt = glm::vec3(target(generator), target(generator) * 0.3f, target(generator));
+            }
+
+            frustums.emplace_back(projection * glm::lookAt(eye, lookAt, glm::vec3(0.0f, 1.0f, 0.0f)));
+        }
+
+        return frustums;
+    }
+
+    struct CheckResult
+    {
+        uint64_t Missed = 0; ///< Objects visible to Frustum::Contains but culled by the octree.
+        uint64_t Extra = 0; ///< Objects returned by the octree that Frustum::Contains rejects, the query is conservative.
+    };
+
+    CheckResult Check(const Octree<uint32_t>& octree, const std::vector<ObjectContainer<uint32_t>>& objects, const std::vector<Frustum>& frustums)
+    {
+        CheckResult result;
+        std::vector<uint8_t> returned(objects.size());
+
+        for (const Frustum& frustum : frustums)
+        {
+            std::fill(returned.begin(), returned.end(), 0);
+            for (const ObjectContainer<uint32_t>& object : octree.Query(frustum))
+            {
+                returned[object.object] = 1;
+            }
+
+            for (const ObjectContainer<uint32_t>& object : objects)
+            {
+                bool visible = frustum.Contains(object.worldAABB);
+                if (visible && !returned[object.object])
+                    result.Missed++;
+                else if (!visible && returned[object.object])
+                    result.Extra++;
+            }
+        }
+
+        return result;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = Benchmark::IsQuick(argc, argv);
+
+    std::mt19937 generator(1234);
+    std::vector<Frustum> frustums = CreateFrustums(quick ? 64 : 256, generator);
+    std::vector<uint32_t> counts = quick ? std::vector<uint32_t>{2000} : std::vector<uint32_t>{2000, 20000, 200000};
+
+    bool failed = false;
+
+    std::printf("%8s %10s %6s %12s %10s %10s %12s %12s %12s\n", "objects", "looseness", "build", "build (ms)", "missed", "extra", "query (ms)",
+                "cached (ms)", "brute (ms)");
+
+    for (uint32_t count : counts)
+    {
+        std::vector<ObjectContainer<uint32_t>> objects = CreateScene(count, generator);
+
+        double bruteTime = Benchmark::Measure([&]() {
+            uint32_t visibleCount = 0;
+            for (const Frustum& frustum : frustums)
+            {
+                for (const ObjectContainer<uint32_t>& object : objects)
+                {
+                    visibleCount += frustum.Contains(object.worldAABB);
+                }
+            }
+            s_VisibleCount = visibleCount;
+        }, 3) / frustums.size();
+
+        for (float looseness : {0.0f, 1.0f, 2.0f})
+        {
+            for (bool bulk : {false, true})
+            {
+                auto fill = [&](Octree<uint32_t>& octree) {
+                    if (bulk)
+                    {
+                        octree.Build(objects);
+                    }
+                    else
+                    {
+                        for (const ObjectContainer<uint32_t>& object : objects)
+                        {
+                            octree.Insert(object);
+                        }
+                    }
+                };
+
+                // Includes the destruction of the nodes, which costs the same for both
+                double buildTime = Benchmark::Measure([&]() {
+                    Octree<uint32_t> octree(AABB(glm::vec3(-s_WorldSize), glm::vec3(s_WorldSize)), 8, 6, looseness);
+                    fill(octree);
+                }, 3);
+
+                Octree<uint32_t> octree(AABB(glm::vec3(-s_WorldSize), glm::vec3(s_WorldSize)), 8, 6, looseness);
+                fill(octree);
+
+                // Checked with and without the temporal visibility cache
+                octree.SetVisibilityCache(false);
+                CheckResult result = Check(octree, objects, frustums);
+                octree.SetVisibilityCache(true);
+                CheckResult cachedResult = Check(octree, objects, frustums);
+
+                result.Missed += cachedResult.Missed;
+                result.Extra += cachedResult.Extra;
+
+                // The classic mode is known to miss the objects that straddle the cells, it is only measured
+                if (octree.IsLoose() && result.Missed > 0)
+                {
+                    failed = true;
+                }
+
+                octree.SetVisibilityCache(false);
+                double queryTime = Benchmark::Measure([&]() {
+                    for (const Frustum& frustum : frustums)
+                    {
+                        octree.Query(frustum);
+                    }
+                }, 3) / frustums.size();
+
+                octree.SetVisibilityCache(true);
+                double cachedTime = Benchmark::Measure([&]() {
+                    for (const Frustum& frustum : frustums)
+                    {
+                        octree.Query(frustum);
+                    }
+                }, 3) / frustums.size();
+
+                std::printf("%8u %10.1f %6s %12.2f %10llu %10llu %12.4f %12.4f %12.4f\n", count, looseness, bulk ? "bulk" : "insert",
+                            buildTime, (unsigned long long)result.Missed, (unsigned long long)result.Extra, queryTime, cachedTime, bruteTime);
+            }
+        }
+    }
+
+    if (failed)
+    {
+        std::printf("The loose octree culled visible objects\n");
+        return 1;
+    }
+
+    return 0;
+}
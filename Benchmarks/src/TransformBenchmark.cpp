@@ -0,0 +1,220 @@
+// Compares the 4x4 matrix path of TransformComponent (quaternion from euler angles, toMat4 and two 4x4 multiplies)
+// with the cached 3x4 affine path used by SceneTree, on an 8-ary hierarchy updated level by level.
+
+#include "Benchmark.h"
+
+#include "CoffeeEngine/Math/AffineTransform.h"
+#include "CoffeeEngine/Scene/Components.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace Coffee;
+
+namespace {
+
+    struct Hierarchy
+    {
+        std::vector<TransformComponent> Transforms;
+        std::vector<int32_t> ParentIndices; ///< Parents are always before their children.
+        std::vector<uint32_t> LevelOffsets; ///< First index of each depth level, plus the total size at the end.
+        std::vector<Affine3x4> WorldMatrices;
+    };
+
+    Hierarchy CreateHierarchy(uint32_t count)
+    {
+        constexpr uint32_t childCount = 8;
+
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+        std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+        Hierarchy hierarchy;
+        hierarchy.Transforms.resize(count);
+        hierarchy.ParentIndices.resize(count);
+        hierarchy.WorldMatrices.resize(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            TransformComponent& transform = hierarchy.Transforms[i];
+            transform.Position = {position(generator), position(generator), position(generator)};
+            transform.Rotation = {angle(generator), angle(generator), angle(generator)};
+            transform.Scale = glm::vec3(scale(generator));
+
+            // Breadth first numbering, so each depth level is a contiguous range
+            hierarchy.ParentIndices[i] = i == 0 ? -1 : static_cast<int32_t>((i - 1) / childCount);
+        }
+
+        uint32_t levelBegin = 0;
+        uint32_t levelSize = 1;
+        while (levelBegin < count)
+        {
+            hierarchy.LevelOffsets.push_back(levelBegin);
+            levelBegin += levelSize;
+            levelSize *= childCount;
+        }
+        hierarchy.LevelOffsets.push_back(count);
+
+        return hierarchy;
+    }
+
+    // The path of SceneTree::UpdateTransforms, every transform goes through TransformComponent::SetWorldTransform
+    void UpdateMatrixPath(Hierarchy& hierarchy)
+    {
+        for (size_t i = 0; i < hierarchy.Transforms.size(); i++)
+        {
+            int32_t parentIndex = hierarchy.ParentIndices[i];
+            hierarchy.Transforms[i].SetWorldTransform(parentIndex != -1 ? hierarchy.Transforms[parentIndex].GetWorldTransform() : glm::mat4(1.0f));
+        }
+    }
+
+    // The path of SceneTree::UpdateAffineTransforms, the transforms of a level are composed in batches
+    void UpdateAffinePath(Hierarchy& hierarchy)
+    {
+        constexpr uint32_t batchSize = 64;
+        static const Affine3x4 identity;
+
+        const Affine3x4* parents[batchSize];
+        const Affine3x4* locals[batchSize];
+        Affine3x4* results[batchSize];
+
+        for (size_t level = 0; level + 1 < hierarchy.LevelOffsets.size(); level++)
+        {
+            for (uint32_t begin = hierarchy.LevelOffsets[level]; begin < hierarchy.LevelOffsets[level + 1]; begin += batchSize)
+            {
+                uint32_t end = std::min(begin + batchSize, hierarchy.LevelOffsets[level + 1]);
+
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    int32_t parentIndex = hierarchy.ParentIndices[i];
+                    parents[i - begin] = parentIndex != -1 ? &hierarchy.WorldMatrices[parentIndex] : &identity;
+                    locals[i - begin] = &hierarchy.Transforms[i].GetLocalAffineTransform();
+                    results[i - begin] = &hierarchy.WorldMatrices[i];
+                }
+
+                Affine3x4::MultiplyBatch(parents, locals, results, end - begin);
+
+                for (uint32_t i = begin; i < end; i++)
+                {
+                    hierarchy.Transforms[i].SetWorldAffineTransform(hierarchy.WorldMatrices[i]);
+                }
+            }
+        }
+    }
+
+    void RotateAll(Hierarchy& hierarchy)
+    {
+        for (TransformComponent& transform : hierarchy.Transforms)
+        {
+            transform.Rotation.y += 1.0f;
+        }
+    }
+
+    bool Compare(const Hierarchy& a, const Hierarchy& b)
+    {
+        for (size_t i = 0; i < a.Transforms.size(); i++)
+        {
+            const glm::mat4& lhs = a.Transforms[i].GetWorldTransform();
+            const glm::mat4& rhs = b.Transforms[i].GetWorldTransform();
+
+            for (int column = 0; column < 4; column++)
+            {
+                for (int row = 0; row < 4; row++)
+                {
+                    float tolerance = 1e-3f * std::max(1.0f, std::abs(lhs[column][row]));
+                    if (!(std::abs(lhs[column][row] - rhs[column][row]) <= tolerance))
+                    {
+                        std::printf("Mismatch at transform %zu: %f != %f\n", i, lhs[column][row], rhs[column][row]);
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = Benchmark::IsQuick(argc, argv);
+
+    std::printf("Affine batch kernel: %s\n", COFFEE_AFFINE_TRANSFORM_AVX ? "AVX, 2 transforms per iteration" : "SSE, 1 transform per iteration");
+    std::printf("%10s %16s %16s %16s %16s %16s\n", "transforms", "4x4 (ms)", "affine (ms)", "affine cached", "Multiply (ms)", "MultiplyBatch");
+
+    std::vector<uint32_t> counts = quick ? std::vector<uint32_t>{4096} : std::vector<uint32_t>{4096, 65536, 1 << 20};
+
+    for (uint32_t count : counts)
+    {
+        Hierarchy matrixHierarchy = CreateHierarchy(count);
+        Hierarchy affineHierarchy = CreateHierarchy(count);
+
+        UpdateMatrixPath(matrixHierarchy);
+        UpdateAffinePath(affineHierarchy);
+
+        if (!Compare(matrixHierarchy, affineHierarchy))
+            return 1;
+
+        // Every local transform changed, both paths rebuild the quaternion and the local matrix
+        double matrixTime = Benchmark::Measure([&]() {
+            RotateAll(matrixHierarchy);
+            UpdateMatrixPath(matrixHierarchy);
+        });
+        double affineTime = Benchmark::Measure([&]() {
+            RotateAll(affineHierarchy);
+            UpdateAffinePath(affineHierarchy);
+        });
+
+        // Only the parents moved, the affine path reuses the cached local matrices
+        double cachedTime = Benchmark::Measure([&]() { UpdateAffinePath(affineHierarchy); });
+
+        // The composition alone, one transform at a time against the batch kernel
+        std::vector<const Affine3x4*> parents(count);
+        std::vector<const Affine3x4*> locals(count);
+        std::vector<Affine3x4> singleResults(count);
+        std::vector<Affine3x4> batchResults(count);
+        std::vector<Affine3x4*> results(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            int32_t parentIndex = affineHierarchy.ParentIndices[i];
+            parents[i] = &affineHierarchy.WorldMatrices[parentIndex != -1 ? parentIndex : 0];
+            locals[i] = &affineHierarchy.Transforms[i].GetLocalAffineTransform();
+        }
+
+        double singleTime = Benchmark::Measure([&]() {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                Affine3x4::Multiply(*parents[i], *locals[i], singleResults[i]);
+            }
+        });
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            results[i] = &batchResults[i];
+        }
+        double batchTime = Benchmark::Measure([&]() { Affine3x4::MultiplyBatch(parents.data(), locals.data(), results.data(), count); });
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            for (int row = 0; row < 3; row++)
+            {
+                // The compiler may contract the multiplies and adds of one kernel into FMA, so the bits can differ
+                glm::vec4 difference = glm::abs(singleResults[i].Rows[row] - batchResults[i].Rows[row]);
+                if (glm::max(glm::max(difference.x, difference.y), glm::max(difference.z, difference.w)) > 1e-3f)
+                {
+                    std::printf("MultiplyBatch does not match Multiply at transform %u\n", i);
+                    return 1;
+                }
+            }
+        }
+
+        std::printf("%10u %16.3f %16.3f %16.3f %16.3f %16.3f\n", count, matrixTime, affineTime, cachedTime, singleTime, batchTime);
+    }
+
+    return 0;
+}
@@ -404,6 +404,55 @@ namespace Coffee {
             }
         }
 
+        if(entity.HasComponent<OccluderComponent>())
+        {
+            auto& occluderComponent = entity.GetComponent<OccluderComponent>();
+            bool isCollapsingHeaderOpen = true;
+            if(ImGui::CollapsingHeader("Occluder", &isCollapsingHeaderOpen, ImGuiTreeNodeFlags_DefaultOpen))
+            {
+                ImGui::Text("Occluder Mesh: %s", occluderComponent.OccluderMesh ? occluderComponent.OccluderMesh->GetName().c_str() : "Entity Mesh");
+                if(occluderComponent.OccluderMesh && ImGui::Button("Use Entity Mesh"))
+                {
+                    occluderComponent.OccluderMesh = nullptr;
+                }
+
+                if(!isCollapsingHeaderOpen)
+                {
+                    entity.RemoveComponent<OccluderComponent>();
+                }
+            }
+        }
+
+        if(entity.HasComponent<LODComponent>())
+        {
+            auto& lodComponent = entity.GetComponent<LODComponent>();
+            bool isCollapsingHeaderOpen = true;
+            if(ImGui::CollapsingHeader("Level Of Detail", &isCollapsingHeaderOpen, ImGuiTreeNodeFlags_DefaultOpen))
+            {
+                for (uint32_t i = 0; i < LODComponent::MaxLevels; i++)
+                {
+                    std::string label = "LOD " + std::to_string(i + 1) + " Screen Size";
+                    ImGui::DragFloat(label.c_str(), &lodComponent.ScreenSizes[i], 0.005f, 0.0f, 1.0f);
+                }
+                ImGui::DragFloat("Bias", &lodComponent.Bias, 0.01f, 0.0f, 10.0f);
+                ImGui::SliderInt("Forced Level", &lodComponent.ForcedLevel, -1, LODComponent::MaxLevels);
+
+                const Ref<Mesh> mesh = entity.HasComponent<MeshComponent>() ? entity.GetComponent<MeshComponent>().GetMesh() : nullptr;
+                if(mesh)
+                {
+                    for (uint32_t i = 0; i < mesh->GetLODCount(); i++)
+                    {
+                        ImGui::Text("LOD %d: %d triangles", i, mesh->GetIndexCount(i) / 3);
+                    }
+                }
+
+                if(!isCollapsingHeaderOpen)
+                {
+                    entity.RemoveComponent<LODComponent>();
+                }
+            }
+        }
+
         if(entity.HasComponent<MaterialComponent>())
         {
             // Move this function to another site
@@ -781,7 +830,8 @@ namespace Coffee {
 
             std::string items[] = {"Tag Component",        "Transform Component", "Mesh Component",
                                    "Material Component",   "Light Component",     "Camera Component",
-                                   "Lua Script Component", "Canvas Component",    "Text Renderer"};
+                                   "Lua Script Component", "Canvas Component",    "Text Renderer",
+                                   "Occluder Component",   "LOD Component"};
             static int item_current = 1;
 
             if (ImGui::BeginListBox("##listbox 2", ImVec2(-FLT_MIN, ImGui::GetContentRegionAvail().y - 200)))
@@ -864,6 +914,18 @@ namespace Coffee {
 						entity.AddComponent<TextComponent>();
 					ImGui::CloseCurrentPopup();
 				}
+                else if (items[item_current] == "Occluder Component")
+                {
+                    if (!entity.HasComponent<OccluderComponent>())
+                        entity.AddComponent<OccluderComponent>();
+                    ImGui::CloseCurrentPopup();
+                }
+                else if (items[item_current] == "LOD Component")
+                {
+                    if (!entity.HasComponent<LODComponent>())
+                        entity.AddComponent<LODComponent>();
+                    ImGui::CloseCurrentPopup();
+                }
                 else
                 {
                     ImGui::CloseCurrentPopup();
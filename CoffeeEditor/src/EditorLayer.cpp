@@ -66,6 +66,8 @@ namespace Coffee {
     {
         ZoneScoped;
 
+        UpdateSceneLoad();
+
         switch (m_SceneState)
         {
             case SceneState::Edit:
@@ -140,16 +142,19 @@ namespace Coffee {
 
                 if (mouseX >= 0 && mouseY >= 0 && mouseX < (int)viewportSize.x && mouseY < (int)viewportSize.y)
                 {
-                    const glm::vec4& pixelData = Renderer::GetEntityIDAtPixel(mouseX, mouseY);
+                    // Unproject the pixel to a ray from the near plane to the far plane, t goes from 0 to 1
+                    glm::vec2 ndc = (glm::vec2(mouseX, mouseY) + 0.5f) / viewportSize * 2.0f - 1.0f;
+                    glm::mat4 inverseViewProjection = glm::inverse(m_EditorCamera.GetProjection() * m_EditorCamera.GetViewMatrix());
 
-                    /// Convert the vec3 back to uint32_t
-                    uint32_t r = static_cast<uint32_t>(pixelData.r * 255.0f);
-                    uint32_t g = static_cast<uint32_t>(pixelData.g * 255.0f);
-                    uint32_t b = static_cast<uint32_t>(pixelData.b * 255.0f);
+                    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.0f, 1.0f);
+                    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+                    nearPoint /= nearPoint.w;
+                    farPoint /= farPoint.w;
 
-                    uint32_t entityID = (r << 0) | (g << 8) | (b << 16);
+                    Ray ray(glm::vec3(nearPoint), glm::vec3(farPoint - nearPoint));
 
-                    Entity hoveredEntity = entityID == 16777215 ? Entity() : Entity((entt::entity)entityID, m_ActiveScene.get());
+                    RaycastHit hit;
+                    Entity hoveredEntity = m_ActiveScene->Raycast(ray, 1.0f, hit) ? Entity(hit.Entity, m_ActiveScene.get()) : Entity();
 
                     m_SceneTreePanel.SetSelectedEntity(hoveredEntity);
                 }
@@ -200,6 +205,8 @@ namespace Coffee {
                 if (ImGui::MenuItem(ICON_LC_FOLDER_OPEN " Open Scene...", "Ctrl+O")) { OpenScene(); }
                 if (ImGui::MenuItem(ICON_LC_SAVE " Save Scene", "Ctrl+S")) { SaveScene(); }
                 if (ImGui::MenuItem(ICON_LC_SAVE " Save Scene As...", "Ctrl+Shift+S")) { SaveSceneAs(); }
+                // Faster to load on big levels, JSON stays the default so the scenes can be diffed and merged
+                if (ImGui::MenuItem(ICON_LC_SAVE " Save Scene as Binary...")) { SaveScene(ResourceFormat::Binary); }
                 if (ImGui::MenuItem(ICON_LC_X " Exit")) { Application::Get().Close(); }
                 ImGui::EndMenu();
             }
@@ -280,6 +287,12 @@ namespace Coffee {
                 break;
             }
 
+            if(m_SceneLoader)
+            {
+                ImGui::SameLine();
+                ImGui::ProgressBar(m_SceneLoader->GetProgress(), ImVec2(150.0f, 0.0f), "Loading scene...");
+            }
+
             //set the fps counter in the right side of the menu bar
             ImVec2 textSize = ImGui::CalcTextSize(("FPS:" + std::to_string(Application::Get().GetFPS())).c_str());
             ImGui::SetCursorPosX(ImGui::GetWindowWidth() - textSize.x);
@@ -409,15 +422,20 @@ namespace Coffee {
         //transparent overlay displaying fps draw calls etc
         ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoDocking | /*ImGuiWindowFlags_AlwaysAutoResize |*/ ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
 
-        ImGui::SetNextWindowPos(ImVec2(ImGui::GetWindowPos().x + ImGui::GetWindowSize().x - 205, ImGui::GetWindowPos().y + ImGui::GetWindowSize().y - 100));
+        ImGui::SetNextWindowPos(ImVec2(ImGui::GetWindowPos().x + ImGui::GetWindowSize().x - 205, ImGui::GetWindowPos().y + ImGui::GetWindowSize().y - 120));
 
         ImGui::SetNextWindowBgAlpha(0.35f); // Transparent background
 
         ImGui::Begin("Renderer Stats", NULL, window_flags);
         ImGui::Text("Size: %.0f x %.0f (%0.1fMP)", m_ViewportSize.x, m_ViewportSize.y, m_ViewportSize.x * m_ViewportSize.y / 1000000.0f);
         ImGui::Text("Draw Calls: %d", Renderer::GetStats().DrawCalls);
+        ImGui::Text("State Changes: %d materials, %d shaders", Renderer::GetStats().MaterialChanges, Renderer::GetStats().ShaderChanges);
         ImGui::Text("Vertex Count: %d", Renderer::GetStats().VertexCount);
         ImGui::Text("Index Count: %d", Renderer::GetStats().IndexCount);
+        ImGui::Text("Triangles: %d (%d full detail)", Renderer::GetStats().TriangleCount, Renderer::GetStats().FullDetailTriangleCount);
+        ImGui::Text("Lights: %d (max %d per cluster)", Renderer::GetStats().LightCount, Renderer::GetStats().MaxClusterLightCount);
+        ImGui::Text("Visibility Cache: %d hits, %d misses", Renderer::GetStats().VisibilityCacheHits, Renderer::GetStats().VisibilityCacheMisses);
+        ImGui::Text("Transforms Updated: %d", m_ActiveScene->m_SceneTree->GetUpdatedTransformCount());
         ImGui::End();
 
         // Display EditorCamera speed vertical slider & zoom vertical slider at the center left
@@ -547,6 +565,46 @@ namespace Coffee {
         {
             m_ActiveScene->m_Octree.Clear();
         }
+        ImGui::Text("Objects: %d", (int)m_ActiveScene->m_Octree.Size());
+        float looseness = m_ActiveScene->m_Octree.GetLooseness();
+        if(ImGui::SliderFloat("Looseness", &looseness, 0.0f, 3.0f))
+        {
+            m_ActiveScene->m_Octree.SetLooseness(looseness);
+        }
+        const char* spatialIndexNames[] = { "Octree", "Linear Octree", "BVH", "Flat" };
+        int spatialIndex = (int)m_ActiveScene->GetSpatialIndex();
+        if(ImGui::Combo("Spatial Index", &spatialIndex, spatialIndexNames, IM_ARRAYSIZE(spatialIndexNames)))
+        {
+            m_ActiveScene->SetSpatialIndex((SpatialIndexType)spatialIndex);
+        }
+        if(m_ActiveScene->GetSpatialIndex() == SpatialIndexType::LinearOctree)
+        {
+            ImGui::Text("Linear Nodes: %d", (int)m_ActiveScene->m_LinearOctree.GetNodes().size());
+        }
+        else if(m_ActiveScene->GetSpatialIndex() == SpatialIndexType::BVH)
+        {
+            ImGui::Text("BVH Nodes: %d", (int)m_ActiveScene->m_BVH.GetTree().GetNodes().size());
+        }
+        else if(m_ActiveScene->GetSpatialIndex() == SpatialIndexType::Octree)
+        {
+            bool visibilityCache = m_ActiveScene->m_Octree.IsVisibilityCacheEnabled();
+            if(ImGui::Checkbox("Visibility Cache", &visibilityCache))
+            {
+                m_ActiveScene->m_Octree.SetVisibilityCache(visibilityCache);
+            }
+        }
+        bool occlusionCulling = m_ActiveScene->IsOcclusionCullingEnabled();
+        if(ImGui::Checkbox("Occlusion Culling", &occlusionCulling))
+        {
+            m_ActiveScene->SetOcclusionCulling(occlusionCulling);
+        }
+        if(occlusionCulling)
+        {
+            ImGui::Text("Occluders: %d (%d triangles)", (int)m_ActiveScene->m_OcclusionBuffer.GetOccluderCount(), (int)m_ActiveScene->m_OcclusionBuffer.GetTriangleCount());
+            ImGui::Text("Occluded Meshes: %d", (int)m_ActiveScene->m_OccludedCount);
+        }
+        const auto& spatialHash = m_ActiveScene->GetSpatialHash();
+        ImGui::Text("Spatial Hash: %d entities in %d cells", (int)spatialHash.Size(), (int)spatialHash.GetCellCount());
         if(ImGui::Button("Add Point"))
         {
             //m_ActiveScene->m_Octree.Insert({{rand() % 20 - 10, rand() % 20 - 10, rand() % 20 - 10}});
@@ -571,7 +629,9 @@ namespace Coffee {
 
                 if(meshComponent.drawAABB)
                 {
-                    const AABB& aabb = meshComponent.mesh->GetAABB().CalculateTransformedAABB(transform);
+                    const AABB& aabb = selectedEntity.HasComponent<WorldBoundsComponent>()
+                                           ? selectedEntity.GetComponent<WorldBoundsComponent>().Bounds
+                                           : meshComponent.mesh->GetAABB().CalculateTransformedAABB(transform);
                     DebugRenderer::DrawBox(aabb, {0.27f, 0.52f, 0.53f, 1.0f});
                 }
 
@@ -655,17 +715,9 @@ namespace Coffee {
 
     void EditorLayer::OnScenePlay()
     {
-        if(m_ActiveScene->m_FilePath.empty())
-        {
-            COFFEE_ERROR("Scene is not saved! Please save the scene before playing.");
-            return;
-        }
-
         m_SceneState = SceneState::Play;
 
-        Scene::Save(m_EditorScene->m_FilePath, m_EditorScene);
-
-        m_ActiveScene = Scene::Load(m_ActiveScene->m_FilePath);
+        m_ActiveScene = Scene::Copy(m_EditorScene);
         m_ActiveScene->OnInitRuntime();
 
         m_SceneTreePanel.SetContext(m_ActiveScene);
@@ -753,22 +805,47 @@ namespace Coffee {
 
         if (!path.empty() and path.extension() == ".TeaScene")
         {
-            m_EditorScene = Scene::Load(path);
-            m_ActiveScene = m_EditorScene;
-            m_ActiveScene->OnInitEditor();
-
-            m_SceneTreePanel = SceneTreePanel();
-
-            m_SceneTreePanel.SetContext(m_ActiveScene);
-            m_ContentBrowserPanel.SetContext(m_ActiveScene);
-            m_ImportPanel.SetContext(m_ActiveScene);
+            // The scene is parsed on a worker thread and swapped in by UpdateSceneLoad once it is ready
+            m_SceneLoader = SceneLoader::LoadAsync(path);
         }
         else
         {
             COFFEE_CORE_WARN("Open Scene: No file selected");
         }
     }
-    void EditorLayer::SaveScene()
+    void EditorLayer::UpdateSceneLoad()
+    {
+        // The scene is only swapped while editing, a running scene is never replaced
+        if(!m_SceneLoader || m_SceneState != SceneState::Edit)
+            return;
+
+        // Keep the editor responsive, the entities are created over several frames
+        constexpr double timeBudget = 0.004;
+        if(!m_SceneLoader->Instantiate(timeBudget))
+            return;
+
+        // The loader already logged why, the open scene is kept
+        if(m_SceneLoader->GetState() == SceneLoader::State::Failed)
+        {
+            COFFEE_CORE_ERROR("Open Scene: {0} could not be loaded", m_SceneLoader->GetFilePath().filename().string());
+            m_SceneLoader.reset();
+            return;
+        }
+
+        m_EditorScene = m_SceneLoader->GetScene();
+        m_SceneLoader.reset();
+
+        m_ActiveScene = m_EditorScene;
+        m_ActiveScene->OnInitEditor();
+
+        m_SceneTreePanel = SceneTreePanel();
+
+        m_SceneTreePanel.SetContext(m_ActiveScene);
+        m_ContentBrowserPanel.SetContext(m_ActiveScene);
+        m_ImportPanel.SetContext(m_ActiveScene);
+    }
+
+    void EditorLayer::SaveScene(ResourceFormat format)
     {
         FileDialogArgs args;
         args.Filters = {{"Coffee Scene", "TeaScene"}};
@@ -776,7 +853,7 @@ namespace Coffee {
 
         if (!path.empty())
         {
-            Scene::Save(path, m_ActiveScene);
+            Scene::Save(path, m_ActiveScene, format);
         }
         else
         {
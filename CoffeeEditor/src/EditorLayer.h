@@ -6,6 +6,7 @@
 #include "CoffeeEngine/Events/KeyEvent.h"
 #include "CoffeeEngine/Renderer/EditorCamera.h"
 #include "CoffeeEngine/Scene/Scene.h"
+#include "CoffeeEngine/Scene/SceneLoader.h"
 #include "Panels/ContentBrowserPanel.h"
 #include "Panels/MonitorPanel.h"
 #include "Panels/SceneTreePanel.h"
@@ -51,12 +52,15 @@ namespace Coffee {
         //Scene Management
         void NewScene();
         void OpenScene();
-        void SaveScene();
+        void SaveScene(ResourceFormat format = ResourceFormat::JSON);
         void SaveSceneAs();
+        void UpdateSceneLoad();
     private:
         Ref<Scene> m_EditorScene;
         Ref<Scene> m_ActiveScene;
 
+        Ref<SceneLoader> m_SceneLoader; ///< The scene being opened, replaces the editor scene once it is loaded.
+
         EditorCamera m_EditorCamera;
 
         enum class SceneState
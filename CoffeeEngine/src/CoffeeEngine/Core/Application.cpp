@@ -1,4 +1,5 @@
 #include "CoffeeEngine/Core/Application.h"
+#include "CoffeeEngine/Core/JobSystem.h"
 #include "CoffeeEngine/Core/Layer.h"
 #include "CoffeeEngine/Core/Stopwatch.h"
 #include "CoffeeEngine/Events/KeyEvent.h"
@@ -22,6 +23,8 @@ namespace Coffee
         m_Window = Window::Create(WindowProps("Coffee Engine"));
         SetEventCallback(COFFEE_BIND_EVENT_FN(OnEvent));
 
+        JobSystem::Init();
+
         Renderer::Init();
 
         m_ImGuiLayer = new ImGuiLayer();
@@ -30,6 +33,7 @@ namespace Coffee
 
     Application::~Application()
     {
+        JobSystem::Shutdown();
     }
 
     void Application::PushLayer(Layer* layer)
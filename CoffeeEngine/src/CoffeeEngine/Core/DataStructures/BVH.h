@@ -0,0 +1,205 @@
+#pragma once
+
+#include "CoffeeEngine/Core/DataStructures/Octree.h"
+#include "CoffeeEngine/Core/DataStructures/PrimitiveBVH.h"
+#include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Math/Frustum.h"
+#include "CoffeeEngine/Renderer/DebugRenderer.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    /**
+     * @brief Bounding volume hierarchy of objects, an alternative to the octree for scenes with uneven density.
+     *
+     * It has the same interface as Octree<T>. The tree is built with the surface area heuristic, so it adapts to
+     * where the objects are instead of splitting fixed world bounds. Moving an object only refits the node bounds on
+     * the next query; adding or removing objects, or refits that degrade the tree too much, trigger a full rebuild.
+     */
+    template <typename T>
+    class BVH
+    {
+    public:
+        BVH() = default;
+
+        void Insert(const ObjectContainer<T>& object);
+
+        /**
+         * @brief Update the transform and bounds of an object, inserting it if it is not in the hierarchy.
+         * @param object The object with its new transform and bounds.
+         */
+        void Update(const ObjectContainer<T>& object);
+
+        /**
+         * @brief Remove an object.
+         * @param object The object to remove.
+         * @return True if the object was in the hierarchy.
+         */
+        bool Remove(const T& object);
+
+        bool Contains(const T& object) const { return objectIndices.contains(object); }
+        size_t Size() const { return objects.size(); }
+
+        /**
+         * @brief Apply the pending changes, rebuilding or refitting the tree. Called by Query.
+         *
+         * The tree is a cache of the object bounds, so this is const like the queries that need it up to date.
+         */
+        void Commit() const;
+
+        std::vector<ObjectContainer<T>> Query(const Frustum& frustum) const;
+
+        void DebugDraw() const;
+        void Clear();
+
+        const PrimitiveBVH& GetTree() const { return tree; }
+
+    private:
+        void Rebuild() const;
+
+        mutable PrimitiveBVH tree;
+        std::vector<ObjectContainer<T>> objects;
+        std::vector<AABB> worldBounds; ///< The world bounds of each object, the primitives of the tree.
+        std::unordered_map<T, uint32_t> objectIndices; ///< The index of each object in the arrays.
+
+        mutable bool needsRebuild = false;
+        mutable bool needsRefit = false;
+        mutable float builtSurfaceArea = 0.0f; ///< The surface area of the root right after the last build.
+
+        static constexpr float s_MaxRefitGrowth = 2.0f; ///< Rebuild when the refitted root grows more than this.
+    };
+
+    template <typename T>
+    void BVH<T>::Insert(const ObjectContainer<T>& object)
+    {
+        if (objectIndices.contains(object.object))
+        {
+            Update(object);
+            return;
+        }
+
+        objectIndices[object.object] = static_cast<uint32_t>(objects.size());
+        objects.push_back(object);
+        worldBounds.push_back(object.worldAABB);
+
+        needsRebuild = true;
+    }
+
+    template <typename T>
+    void BVH<T>::Update(const ObjectContainer<T>& object)
+    {
+        auto it = objectIndices.find(object.object);
+        if (it == objectIndices.end())
+        {
+            Insert(object);
+            return;
+        }
+
+        objects[it->second] = object;
+        worldBounds[it->second] = object.worldAABB;
+
+        needsRefit = true;
+    }
+
+    template <typename T>
+    bool BVH<T>::Remove(const T& object)
+    {
+        auto it = objectIndices.find(object);
+        if (it == objectIndices.end())
+            return false;
+
+        uint32_t index = it->second;
+        objectIndices.erase(it);
+
+        if (index != objects.size() - 1)
+        {
+            objects[index] = std::move(objects.back());
+            worldBounds[index] = worldBounds.back();
+            objectIndices[objects[index].object] = index;
+        }
+
+        objects.pop_back();
+        worldBounds.pop_back();
+
+        needsRebuild = true;
+        return true;
+    }
+
+    template <typename T>
+    void BVH<T>::Commit() const
+    {
+        if (needsRebuild)
+        {
+            Rebuild();
+            return;
+        }
+
+        if (!needsRefit)
+            return;
+
+        ZoneScoped;
+
+        tree.Refit(worldBounds);
+        needsRefit = false;
+
+        // Objects that moved apart make the nodes overlap, the queries visit more of the tree
+        if (!tree.IsEmpty() && PrimitiveBVH::GetSurfaceArea(tree.GetNodes()[0].Bounds) > builtSurfaceArea * s_MaxRefitGrowth)
+        {
+            Rebuild();
+        }
+    }
+
+    template <typename T>
+    void BVH<T>::Rebuild() const
+    {
+        ZoneScoped;
+
+        tree.Build(worldBounds);
+        builtSurfaceArea = tree.IsEmpty() ? 0.0f : PrimitiveBVH::GetSurfaceArea(tree.GetNodes()[0].Bounds);
+
+        needsRebuild = false;
+        needsRefit = false;
+    }
+
+    template <typename T>
+    std::vector<ObjectContainer<T>> BVH<T>::Query(const Frustum& frustum) const
+    {
+        ZoneScoped;
+
+        Commit();
+
+        std::vector<ObjectContainer<T>> results;
+        tree.Query(frustum, [&](uint32_t index, bool isInside) {
+            if (isInside || frustum.Contains(worldBounds[index]))
+                results.push_back(objects[index]);
+        });
+
+        return results;
+    }
+
+    template <typename T>
+    void BVH<T>::DebugDraw() const
+    {
+        for (const auto& node : tree.GetNodes())
+        {
+            glm::vec4 color = node.IsLeaf() ? glm::vec4(0.0f, 1.0f, 0.0f, 1.0f) : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+            DebugRenderer::DrawBox(node.Bounds.min, node.Bounds.max, color);
+        }
+    }
+
+    template <typename T>
+    void BVH<T>::Clear()
+    {
+        tree.Build({});
+        objects.clear();
+        worldBounds.clear();
+        objectIndices.clear();
+        needsRebuild = false;
+        needsRefit = false;
+        builtSurfaceArea = 0.0f;
+    }
+
+} // namespace Coffee
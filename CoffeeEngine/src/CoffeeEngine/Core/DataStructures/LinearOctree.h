@@ -0,0 +1,277 @@
+#pragma once
+
+#include "CoffeeEngine/Core/DataStructures/Octree.h"
+#include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Math/Frustum.h"
+#include "CoffeeEngine/Math/FrustumCulling.h"
+#include "CoffeeEngine/Math/Morton.h"
+#include "CoffeeEngine/Renderer/DebugRenderer.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    /**
+     * @brief Pointerless octree stored in flat arrays, built in bulk from Morton codes.
+     *
+     * The objects are sorted by the Morton code of their center, so the objects of any node form a contiguous range.
+     * Nodes are stored breadth first in a single array and the children of a node are adjacent, no node is allocated
+     * on its own. The bounds of each node are the union of the bounds of its objects, which keeps the culling exact
+     * even for objects larger than their cell. There are no incremental updates, the tree is rebuilt when the objects
+     * change.
+     */
+    template <typename T>
+    class LinearOctree
+    {
+    public:
+        struct Node
+        {
+            AABB aabb; ///< The union of the bounds of the objects of the subtree.
+            uint32_t locationalCode = 1; ///< The octants from the root, three bits per level after a leading 1.
+            uint32_t firstObject = 0; ///< The first object of the subtree in the sorted object array.
+            uint32_t objectCount = 0; ///< The number of objects of the subtree.
+            uint32_t firstChild = 0; ///< The index of the first child in the node array.
+            uint32_t childCount = 0; ///< The number of non empty children.
+
+            bool IsLeaf() const { return childCount == 0; }
+        };
+
+        /**
+         * @brief Constructs an empty linear octree.
+         * @param maxObjectsPerNode The number of objects a node can hold before it is subdivided.
+         * @param maxDepth The maximum depth of the nodes, at most 10 (30 bit Morton codes).
+         */
+        LinearOctree(int maxObjectsPerNode = 8, int maxDepth = 10)
+            : maxObjectsPerNode(maxObjectsPerNode), maxDepth(std::clamp(maxDepth, 0, s_MaxDepth)) {}
+
+        /**
+         * @brief Rebuild the tree from a set of objects, the root bounds are fitted to them.
+         * @param sourceObjects The objects, with their world bounds.
+         */
+        void Build(const std::vector<ObjectContainer<T>>& sourceObjects);
+
+        std::vector<ObjectContainer<T>> Query(const Frustum& frustum) const;
+
+        void DebugDraw() const;
+        void Clear();
+
+        size_t Size() const { return objects.size(); }
+        const std::vector<Node>& GetNodes() const { return nodes; }
+
+    private:
+        uint32_t GetMortonCode(const glm::vec3& point) const;
+        static uint32_t GetDepth(uint32_t locationalCode);
+
+        std::vector<Node> nodes;
+        std::vector<ObjectContainer<T>> objects; ///< The objects sorted by Morton code.
+        std::vector<uint32_t> mortonCodes; ///< The Morton code of each sorted object.
+        AABBSoA objectBounds; ///< The world bounds of each sorted object, for the SIMD culling of the leaves.
+        AABB bounds;
+        int maxObjectsPerNode;
+        int maxDepth;
+
+        static constexpr int s_MaxDepth = 10;
+    };
+
+    template <typename T>
+    void LinearOctree<T>::Build(const std::vector<ObjectContainer<T>>& sourceObjects)
+    {
+        ZoneScoped;
+
+        Clear();
+
+        if (sourceObjects.empty())
+            return;
+
+        bounds = sourceObjects[0].worldAABB;
+        for (const auto& object : sourceObjects)
+        {
+            bounds.min = glm::min(bounds.min, object.worldAABB.min);
+            bounds.max = glm::max(bounds.max, object.worldAABB.max);
+        }
+
+        std::vector<std::pair<uint32_t, uint32_t>> keys(sourceObjects.size());
+        for (size_t i = 0; i < sourceObjects.size(); i++)
+        {
+            keys[i] = {GetMortonCode(sourceObjects[i].worldAABB.GetCenter()), static_cast<uint32_t>(i)};
+        }
+
+        RadixSortMortonCodes(keys);
+
+        objects.reserve(keys.size());
+        mortonCodes.reserve(keys.size());
+        objectBounds.Resize(keys.size());
+        for (const auto& [code, index] : keys)
+        {
+            objectBounds.Set(objects.size(), sourceObjects[index].worldAABB);
+            objects.push_back(sourceObjects[index]);
+            mortonCodes.push_back(code);
+        }
+
+        nodes.reserve(objects.size() / std::max(maxObjectsPerNode, 1) * 2 + 1);
+        nodes.push_back({AABB(), 1, 0, static_cast<uint32_t>(objects.size()), 0, 0});
+
+        // Breadth first, the children of each node are appended together after it
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            const Node node = nodes[i];
+            int depth = static_cast<int>(GetDepth(node.locationalCode));
+
+            if (node.objectCount <= static_cast<uint32_t>(maxObjectsPerNode) || depth >= maxDepth)
+                continue;
+
+            // The codes of the node share the same prefix, so the octant of the next level is sorted too
+            uint32_t shift = 3 * (maxDepth - depth - 1);
+            uint32_t first = node.firstObject;
+            uint32_t end = node.firstObject + node.objectCount;
+
+            nodes[i].firstChild = static_cast<uint32_t>(nodes.size());
+
+            for (uint32_t octant = 0; octant < 8 && first < end; octant++)
+            {
+                auto last = std::partition_point(mortonCodes.begin() + first, mortonCodes.begin() + end, [&](uint32_t code) {
+                    return ((code >> shift) & 7) <= octant;
+                });
+                uint32_t lastIndex = static_cast<uint32_t>(last - mortonCodes.begin());
+
+                if (lastIndex > first)
+                {
+                    nodes.push_back({AABB(), (node.locationalCode << 3) | octant, first, lastIndex - first, 0, 0});
+                    nodes[i].childCount++;
+                }
+
+                first = lastIndex;
+            }
+        }
+
+        // The children are always after their parent, so a reverse sweep fits the bounds bottom up
+        for (size_t i = nodes.size(); i-- > 0;)
+        {
+            Node& node = nodes[i];
+
+            if (node.IsLeaf())
+            {
+                node.aabb = objects[node.firstObject].worldAABB;
+                for (uint32_t j = node.firstObject + 1; j < node.firstObject + node.objectCount; j++)
+                {
+                    node.aabb.min = glm::min(node.aabb.min, objects[j].worldAABB.min);
+                    node.aabb.max = glm::max(node.aabb.max, objects[j].worldAABB.max);
+                }
+            }
+            else
+            {
+                node.aabb = nodes[node.firstChild].aabb;
+                for (uint32_t j = node.firstChild + 1; j < node.firstChild + node.childCount; j++)
+                {
+                    node.aabb.min = glm::min(node.aabb.min, nodes[j].aabb.min);
+                    node.aabb.max = glm::max(node.aabb.max, nodes[j].aabb.max);
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    std::vector<ObjectContainer<T>> LinearOctree<T>::Query(const Frustum& frustum) const
+    {
+        ZoneScoped;
+
+        std::vector<ObjectContainer<T>> results;
+
+        if (nodes.empty())
+            return results;
+
+        FrustumPlanes planes(frustum);
+        std::vector<uint8_t> visible;
+
+        // Each level pushes at most 8 children and pops its parent, with the planes the parent crosses
+        std::array<std::pair<uint32_t, uint8_t>, 7 * s_MaxDepth + 1> stack;
+        uint32_t stackSize = 0;
+        stack[stackSize++] = {0, Frustum::AllPlanesMask};
+
+        while (stackSize > 0)
+        {
+            auto [nodeIndex, planeMask] = stack[--stackSize];
+            const Node& node = nodes[nodeIndex];
+
+            IntersectionType intersection = frustum.Intersect(node.aabb, planeMask);
+            if (intersection == IntersectionType::Outside)
+                continue;
+
+            // The objects of a subtree are contiguous, a node fully inside adds them all without any test
+            if (intersection == IntersectionType::Inside)
+            {
+                results.insert(results.end(), objects.begin() + node.firstObject, objects.begin() + node.firstObject + node.objectCount);
+                continue;
+            }
+
+            if (node.IsLeaf())
+            {
+                visible.resize(node.objectCount);
+                CullAABBs(planes, objectBounds, node.firstObject, node.objectCount, visible.data(), planeMask);
+
+                for (uint32_t i = 0; i < node.objectCount; i++)
+                {
+                    if (visible[i])
+                        results.push_back(objects[node.firstObject + i]);
+                }
+                continue;
+            }
+
+            for (uint32_t i = 0; i < node.childCount; i++)
+            {
+                stack[stackSize++] = {node.firstChild + i, planeMask};
+            }
+        }
+
+        return results;
+    }
+
+    template <typename T>
+    void LinearOctree<T>::DebugDraw() const
+    {
+        for (const auto& node : nodes)
+        {
+            float fill = glm::clamp(node.objectCount / 10.0f, 0.0f, 1.0f);
+            DebugRenderer::DrawBox(node.aabb.min, node.aabb.max, glm::vec4(1.0f - fill, fill, 0.0f, 1.0f));
+        }
+    }
+
+    template <typename T>
+    void LinearOctree<T>::Clear()
+    {
+        nodes.clear();
+        objects.clear();
+        mortonCodes.clear();
+        objectBounds.Clear();
+        bounds = AABB();
+    }
+
+    template <typename T>
+    uint32_t LinearOctree<T>::GetMortonCode(const glm::vec3& point) const
+    {
+        uint32_t cellCount = 1u << maxDepth;
+
+        glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(1e-6f));
+        glm::vec3 normalized = glm::clamp((point - bounds.min) / size, 0.0f, 1.0f);
+        glm::uvec3 cell = glm::min(glm::uvec3(normalized * static_cast<float>(cellCount)), glm::uvec3(cellCount - 1));
+
+        return MortonEncode(cell.x, cell.y, cell.z);
+    }
+
+    template <typename T>
+    uint32_t LinearOctree<T>::GetDepth(uint32_t locationalCode)
+    {
+        uint32_t depth = 0;
+        while (locationalCode > 1)
+        {
+            locationalCode >>= 3;
+            depth++;
+        }
+        return depth;
+    }
+
+} // namespace Coffee
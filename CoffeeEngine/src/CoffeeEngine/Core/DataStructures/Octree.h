@@ -1,21 +1,77 @@
 #pragma once
 
 #include "CoffeeEngine/Core/Base.h"
+#include "CoffeeEngine/Core/JobSystem.h"
 #include "CoffeeEngine/Math/BoundingBox.h"
 #include "CoffeeEngine/Math/Frustum.h"
+#include "CoffeeEngine/Math/FrustumCulling.h"
+#include "CoffeeEngine/Math/Morton.h"
 #include "CoffeeEngine/Renderer/Mesh.h"
 #include "CoffeeEngine/Renderer/DebugRenderer.h"
+#include <algorithm>
 #include <vector>
 #include <memory>
+#include <unordered_map>
+#include <tracy/Tracy.hpp>
 
 namespace Coffee {
 
+    /**
+     * @brief An object stored in the octree, by value.
+     *
+     * The object itself is used as the key for Update and Remove, so it must be unique and hashable
+     * (e.g. an entity handle).
+     */
     template <typename T>
     struct ObjectContainer
     {
-        const glm::mat4& transform;
-        const AABB& aabb;
-        const T& object;
+        glm::mat4 transform; ///< The world transform of the object.
+        AABB aabb; ///< The bounds of the object, in local space.
+        T object; ///< The object or a handle to it.
+        AABB worldAABB; ///< The bounds in world space.
+
+        ObjectContainer() = default;
+
+        /**
+         * @brief Constructs a container, the world bounds are calculated from the transform.
+         * @param transform The world transform of the object.
+         * @param aabb The bounds of the object, in local space.
+         * @param object The object or a handle to it.
+         */
+        ObjectContainer(const glm::mat4& transform, const AABB& aabb, const T& object)
+            : transform(transform), aabb(aabb), object(object), worldAABB(aabb.CalculateTransformedAABB(transform)) {}
+
+        /**
+         * @brief Constructs a container with world bounds already calculated by the caller (e.g. cached in a component).
+         * @param transform The world transform of the object.
+         * @param aabb The bounds of the object, in local space.
+         * @param object The object or a handle to it.
+         * @param worldAABB The bounds of the object, in world space.
+         */
+        ObjectContainer(const glm::mat4& transform, const AABB& aabb, const T& object, const AABB& worldAABB)
+            : transform(transform), aabb(aabb), object(object), worldAABB(worldAABB) {}
+    };
+
+    /**
+     * @brief The classification of an octree node in the frustum of the last query.
+     *
+     * The next query reuses it without testing the planes while the frustum moved less than the margin.
+     */
+    struct NodeVisibility
+    {
+        uint32_t query = 0; ///< The query that classified the node, 0 if it was never classified.
+        IntersectionType type = IntersectionType::Intersect;
+        uint8_t planeMask = 0; ///< Inside: the planes the node was tested against. Outside: the plane that rejected it, 0 if none.
+        float margin = 0.0f; ///< How far the planes can move before the classification changes.
+    };
+
+    /**
+     * @brief The hits and misses of the visibility cache of an octree in its last query.
+     */
+    struct VisibilityCacheStats
+    {
+        uint32_t hits = 0; ///< Nodes classified from the previous query.
+        uint32_t misses = 0; ///< Nodes tested against the planes.
     };
 
     template <typename T>
@@ -23,9 +79,13 @@ namespace Coffee {
     {
     public:
         AABB aabb;
+        AABB looseAABB; ///< The bounds used for culling, the cell bounds scaled by the looseness.
         bool isLeaf = true;
+        int depth = 0;
+        OctreeNode* parent = nullptr;
         std::vector<ObjectContainer<T>> objectList;
         std::array<Scope<OctreeNode>, 8> children;
+        mutable NodeVisibility visibility; ///< The classification of the node in the last query.
 
         void DebugDrawAABB();
         int GetChildIndex(const AABB& bounds, const glm::vec3& point) const;
@@ -36,15 +96,78 @@ namespace Coffee {
     {
     public:
         Octree();
-        Octree(const AABB& bounds, int maxObjectsPerNode = 8, int maxDepth = 5);
+        /**
+         * @brief Constructs an octree.
+         * @param bounds The bounds of the root node.
+         * @param maxObjectsPerNode The number of objects a leaf can hold before it is subdivided.
+         * @param maxDepth The maximum depth of the nodes.
+         * @param looseness 0 places the objects in the leaf that contains their origin. 1 or more enables the loose
+         * mode, each object is placed in the smallest node whose bounds scaled by this factor fully contain it
+         * (2 is the classic loose octree).
+         */
+        Octree(const AABB& bounds, int maxObjectsPerNode = 8, int maxDepth = 5, float looseness = 0.0f);
         ~Octree();
 
         void Insert(const ObjectContainer<T>& object);
+
+        /**
+         * @brief Replace the contents of the octree with a set of objects, building all the nodes at once.
+         *
+         * The Morton codes of the objects are calculated across the JobSystem workers and radix sorted, then the
+         * nodes are built top-down, each one splitting its sorted range by octant, without moving the objects again
+         * every time a node is subdivided. The tree can differ from inserting the objects one by one: in classic mode
+         * an object always goes to the octant of its origin, where Insert drops an object whose bounds do not
+         * intersect that octant.
+         *
+         * @param objects The objects, each one must be unique.
+         */
+        void Build(const std::vector<ObjectContainer<T>>& objects);
+
+        /**
+         * @brief Update the transform and bounds of an object, inserting it if it is not in the octree.
+         *
+         * The object is only reinserted when it leaves its node, otherwise it is updated in place.
+         *
+         * @param object The object with its new transform and bounds.
+         */
+        void Update(const ObjectContainer<T>& object);
+
+        /**
+         * @brief Remove an object, the empty nodes left behind are merged back into their parent.
+         * @param object The object to remove.
+         * @return True if the object was in the octree.
+         */
+        bool Remove(const T& object);
+
+        bool Contains(const T& object) const { return objectNodes.contains(object); }
+        size_t Size() const { return objectNodes.size(); }
+
+        /**
+         * @brief Change the placement mode and reinsert all the objects.
+         * @param looseness The looseness factor, see the constructor.
+         */
+        void SetLooseness(float looseness);
+        float GetLooseness() const { return looseness; }
+        bool IsLoose() const { return looseness > 0.0f; }
+
         void DebugDraw();
         void Clear();
 
         std::vector<ObjectContainer<T>> Query(const Frustum& frustum) const;
 
+        /**
+         * @brief Enable the temporal visibility cache of the queries.
+         *
+         * Each node remembers whether it was inside or outside the frustum of the last query, and how far it was from
+         * the planes. The next query measures how much the planes moved and reuses the classification of the nodes
+         * that could not have changed, so only the nodes crossing the frustum and the regions entering it are tested.
+         *
+         * @param enabled True to enable it.
+         */
+        void SetVisibilityCache(bool enabled) { visibilityCacheEnabled = enabled; }
+        bool IsVisibilityCacheEnabled() const { return visibilityCacheEnabled; }
+        const VisibilityCacheStats& GetVisibilityCacheStats() const { return visibilityCacheStats; }
+
     private:
         void Insert(OctreeNode<T>& node, const ObjectContainer<T>& object);
         void InsertIntoLeaf(OctreeNode<T>& node, const ObjectContainer<T>& object);
@@ -52,20 +175,43 @@ namespace Coffee {
         void RedistributeObjects(OctreeNode<T>& node);
         void Subdivide(OctreeNode<T>& node);
         void CreateChildren(OctreeNode<T>& node, const glm::vec3& center);
+        void RemoveFromNode(OctreeNode<T>& node, const T& object);
+        void Collapse(OctreeNode<T>* node);
 
-        void Query(const OctreeNode<T>& node, const Frustum& frustum, std::vector<ObjectContainer<T>>& results) const;
+        void InsertLoose(OctreeNode<T>& node, const ObjectContainer<T>& object);
+        void Build(OctreeNode<T>& node, std::vector<ObjectContainer<T>>& objects,
+                   std::vector<std::pair<uint32_t, uint32_t>>& keys, uint32_t first, uint32_t end, int keyDepth);
+        AABB GetLooseBounds(const AABB& bounds) const;
+        static bool Fits(const AABB& bounds, const AABB& object);
+
+        void Query(const OctreeNode<T>& node, const Frustum& frustum, const FrustumPlanes& planes, uint8_t planeMask,
+                   std::vector<uint8_t>& visible, std::vector<ObjectContainer<T>>& results) const;
+        void CollectAll(const OctreeNode<T>& node, std::vector<ObjectContainer<T>>& results) const;
+        IntersectionType Classify(const OctreeNode<T>& node, const Frustum& frustum, uint8_t& planeMask) const;
 
         OctreeNode<T> rootNode;
         int maxObjectsPerNode;
         int maxDepth;
+        float looseness;
+
+        std::unordered_map<T, OctreeNode<T>*> objectNodes; ///< The leaf that holds each object.
+
+        bool visibilityCacheEnabled = true;
+        mutable uint32_t queryCount = 0;
+        mutable glm::vec4 previousPlanes[6]; ///< The planes of the last query.
+        mutable glm::vec3 planeReference = glm::vec3(0.0f); ///< The point the plane changes are measured around.
+        mutable float planeOffsetShift = 0.0f; ///< The largest change of a plane offset since the last query.
+        mutable float planeNormalShift = 0.0f; ///< The largest change of a plane normal since the last query.
+        mutable VisibilityCacheStats visibilityCacheStats;
+
+        static constexpr int s_MaxMortonDepth = 10; ///< The levels of a 30 bit Morton code.
+        static constexpr uint32_t s_OutsideKey = UINT32_MAX; ///< Sorts the objects left out of the build last.
     };
 
     template <typename T>
     void Octree<T>::Insert(OctreeNode<T>& node, const ObjectContainer<T>& object)
     {
-        AABB objectTransformedAABB = object.aabb.CalculateTransformedAABB(object.transform);
-
-        switch (node.aabb.Intersect(objectTransformedAABB))
+        switch (node.aabb.Intersect(object.worldAABB))
         {
             using enum IntersectionType;
             case Outside:
@@ -86,7 +232,8 @@ namespace Coffee {
     template <typename T>
     void Octree<T>::InsertIntoLeaf(OctreeNode<T>& node, const ObjectContainer<T>& object) {
         node.objectList.push_back(object);
-        if (node.objectList.size() > maxObjectsPerNode && maxDepth > 0) {
+        objectNodes[object.object] = &node;
+        if (node.objectList.size() > maxObjectsPerNode && node.depth < maxDepth) {
             Subdivide(node);
             RedistributeObjects(node);
         }
@@ -101,6 +248,7 @@ namespace Coffee {
     template <typename T>
     void Octree<T>::RedistributeObjects(OctreeNode<T>& node) {
         for (const auto& obj : node.objectList) {
+            objectNodes.erase(obj.object);
             int childIndex = node.GetChildIndex(node.aabb, obj.transform[3]);
             Insert(*node.children[childIndex], obj);
         }
@@ -109,7 +257,332 @@ namespace Coffee {
 
     template <typename T>
     void Octree<T>::Insert(const ObjectContainer<T>& object) {
-        Insert(rootNode, object);
+        if (objectNodes.contains(object.object)) {
+            Update(object);
+            return;
+        }
+
+        if (IsLoose())
+        {
+            InsertLoose(rootNode, object);
+        }
+        else
+        {
+            Insert(rootNode, object);
+        }
+    }
+
+    template <typename T>
+    void Octree<T>::Build(const std::vector<ObjectContainer<T>>& objects)
+    {
+        ZoneScoped;
+
+        Clear();
+
+        if (objects.empty())
+            return;
+
+        // The objects are placed by their origin in the classic mode and by their center in the loose mode
+        int keyDepth = std::min(maxDepth, s_MaxMortonDepth);
+        uint32_t cellCount = 1u << keyDepth;
+        glm::vec3 size = glm::max(rootNode.aabb.max - rootNode.aabb.min, glm::vec3(1e-6f));
+
+        std::vector<std::pair<uint32_t, uint32_t>> keys(objects.size());
+        JobSystem::ParallelFor(static_cast<uint32_t>(objects.size()), 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                const ObjectContainer<T>& object = objects[i];
+
+                // Like Insert, the classic mode leaves out the objects outside the root
+                if (!IsLoose() && rootNode.aabb.Intersect(object.worldAABB) == IntersectionType::Outside)
+                {
+                    keys[i] = {s_OutsideKey, i};
+                    continue;
+                }
+
+                glm::vec3 point = IsLoose() ? object.worldAABB.GetCenter() : glm::vec3(object.transform[3]);
+                glm::vec3 normalized = glm::clamp((point - rootNode.aabb.min) / size, 0.0f, 1.0f);
+                glm::uvec3 cell = glm::min(glm::uvec3(normalized * static_cast<float>(cellCount)), glm::uvec3(cellCount - 1));
+
+                keys[i] = {MortonEncode(cell.x, cell.y, cell.z), i};
+            }
+        });
+
+        RadixSortMortonCodes(keys);
+
+        uint32_t count = static_cast<uint32_t>(keys.size());
+        while (count > 0 && keys[count - 1].first == s_OutsideKey)
+        {
+            count--;
+        }
+
+        // Gathered in Morton order, the nodes read the objects front to back
+        std::vector<ObjectContainer<T>> sortedObjects(count);
+        JobSystem::ParallelFor(count, 1024, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                sortedObjects[i] = objects[keys[i].second];
+                keys[i].second = i;
+            }
+        });
+
+        objectNodes.reserve(count);
+        Build(rootNode, sortedObjects, keys, 0, count, keyDepth);
+    }
+
+    template <typename T>
+    void Octree<T>::Build(OctreeNode<T>& node, std::vector<ObjectContainer<T>>& objects,
+                          std::vector<std::pair<uint32_t, uint32_t>>& keys, uint32_t first, uint32_t end, int keyDepth)
+    {
+        // A node is split when more objects reach it than it can hold, as it would be when inserting them
+        if (end - first <= static_cast<uint32_t>(maxObjectsPerNode) || node.depth >= maxDepth)
+        {
+            node.objectList.reserve(node.objectList.size() + end - first);
+            for (uint32_t i = first; i < end; i++)
+            {
+                objectNodes[objects[keys[i].second].object] = &node;
+                node.objectList.push_back(std::move(objects[keys[i].second]));
+            }
+            return;
+        }
+
+        // Deeper than the Morton codes, the rest of the subtree is built by inserting the objects
+        if (node.depth >= keyDepth)
+        {
+            for (uint32_t i = first; i < end; i++)
+            {
+                if (IsLoose())
+                {
+                    InsertLoose(node, objects[keys[i].second]);
+                }
+                else
+                {
+                    Insert(node, objects[keys[i].second]);
+                }
+            }
+            return;
+        }
+
+        Subdivide(node);
+
+        // The codes of the node share the same prefix, so the octant of the next level is sorted too
+        uint32_t shift = 3 * (keyDepth - node.depth - 1);
+        for (uint32_t octant = 0; octant < 8 && first < end; octant++)
+        {
+            auto last = std::partition_point(keys.begin() + first, keys.begin() + end, [&](const auto& key) {
+                return ((key.first >> shift) & 7) <= octant;
+            });
+            uint32_t octantEnd = static_cast<uint32_t>(last - keys.begin());
+
+            OctreeNode<T>& child = *node.children[octant];
+            uint32_t childEnd = octantEnd;
+
+            // In the loose mode the objects that do not fit in the child stay in this node, the others are packed
+            // at the start of the range in the same order
+            if (IsLoose())
+            {
+                childEnd = first;
+                for (uint32_t i = first; i < octantEnd; i++)
+                {
+                    ObjectContainer<T>& object = objects[keys[i].second];
+                    if (Fits(child.looseAABB, object.worldAABB))
+                    {
+                        keys[childEnd++] = keys[i];
+                    }
+                    else
+                    {
+                        objectNodes[object.object] = &node;
+                        node.objectList.push_back(std::move(object));
+                    }
+                }
+            }
+
+            Build(child, objects, keys, first, childEnd, keyDepth);
+            first = octantEnd;
+        }
+    }
+
+    template <typename T>
+    void Octree<T>::InsertLoose(OctreeNode<T>& start, const ObjectContainer<T>& object)
+    {
+        // Go down while the child around the center of the object fully contains it.
+        // The root also keeps the objects that do not fit in the world bounds
+        OctreeNode<T>* node = &start;
+        while (!node->isLeaf)
+        {
+            OctreeNode<T>& child = *node->children[node->GetChildIndex(node->aabb, object.worldAABB.GetCenter())];
+            if (!Fits(child.looseAABB, object.worldAABB))
+                break;
+            node = &child;
+        }
+
+        node->objectList.push_back(object);
+        objectNodes[object.object] = node;
+
+        if (node->isLeaf && node->objectList.size() > maxObjectsPerNode && node->depth < maxDepth)
+        {
+            Subdivide(*node);
+
+            std::vector<ObjectContainer<T>> objects = std::move(node->objectList);
+            node->objectList.clear();
+            for (const auto& obj : objects)
+            {
+                InsertLoose(*node, obj);
+            }
+        }
+    }
+
+    template <typename T>
+    AABB Octree<T>::GetLooseBounds(const AABB& bounds) const
+    {
+        if (looseness <= 1.0f)
+            return bounds;
+
+        glm::vec3 center = bounds.GetCenter();
+        glm::vec3 halfSize = bounds.GetHalfSize() * looseness;
+        return AABB(center - halfSize, center + halfSize);
+    }
+
+    template <typename T>
+    bool Octree<T>::Fits(const AABB& bounds, const AABB& object)
+    {
+        return glm::all(glm::lessThanEqual(bounds.min, object.min)) && glm::all(glm::lessThanEqual(object.max, bounds.max));
+    }
+
+    template <typename T>
+    void Octree<T>::SetLooseness(float newLooseness)
+    {
+        ZoneScoped;
+
+        std::vector<ObjectContainer<T>> objects;
+        objects.reserve(objectNodes.size());
+        for (const auto& [object, node] : objectNodes)
+        {
+            for (const auto& stored : node->objectList)
+            {
+                if (stored.object == object)
+                {
+                    objects.push_back(stored);
+                    break;
+                }
+            }
+        }
+
+        looseness = newLooseness > 0.0f ? std::max(newLooseness, 1.0f) : 0.0f;
+        rootNode.looseAABB = GetLooseBounds(rootNode.aabb);
+
+        Build(objects);
+    }
+
+    template <typename T>
+    void Octree<T>::Update(const ObjectContainer<T>& object)
+    {
+        auto it = objectNodes.find(object.object);
+        if (it == objectNodes.end())
+        {
+            Insert(object);
+            return;
+        }
+
+        OctreeNode<T>& node = *it->second;
+        bool staysInNode;
+        if (IsLoose())
+        {
+            // The node stays valid while it contains the object and the object does not fit in a smaller child
+            bool fitsInNode = !node.parent || Fits(node.looseAABB, object.worldAABB);
+            bool fitsInChild = !node.isLeaf &&
+                               Fits(node.children[node.GetChildIndex(node.aabb, object.worldAABB.GetCenter())]->looseAABB, object.worldAABB);
+            staysInNode = fitsInNode && !fitsInChild;
+        }
+        else
+        {
+            // The leaf was chosen by the origin of the object, it stays valid while the origin does not leave it
+            staysInNode = node.aabb.Intersect(glm::vec3(object.transform[3])) != IntersectionType::Outside &&
+                          node.aabb.Intersect(object.worldAABB) != IntersectionType::Outside;
+        }
+
+        if (staysInNode)
+        {
+            for (auto& stored : node.objectList)
+            {
+                if (stored.object == object.object)
+                {
+                    stored = object;
+                    return;
+                }
+            }
+        }
+
+        Remove(object.object);
+        Insert(object);
+    }
+
+    template <typename T>
+    bool Octree<T>::Remove(const T& object)
+    {
+        auto it = objectNodes.find(object);
+        if (it == objectNodes.end())
+            return false;
+
+        OctreeNode<T>* node = it->second;
+        objectNodes.erase(it);
+
+        RemoveFromNode(*node, object);
+        Collapse(node);
+
+        return true;
+    }
+
+    template <typename T>
+    void Octree<T>::RemoveFromNode(OctreeNode<T>& node, const T& object)
+    {
+        for (size_t i = 0; i < node.objectList.size(); i++)
+        {
+            if (node.objectList[i].object == object)
+            {
+                node.objectList[i] = std::move(node.objectList.back());
+                node.objectList.pop_back();
+                return;
+            }
+        }
+    }
+
+    template <typename T>
+    void Octree<T>::Collapse(OctreeNode<T>* node)
+    {
+        // Merge the children back while they are leaves that fit in their parent. A loose node keeps objects above its
+        // children, so the node that lost an object is tried first, a leaf has nothing to merge and goes to its parent
+        if (node && node->isLeaf)
+        {
+            node = node->parent;
+        }
+
+        while (node)
+        {
+            size_t objectCount = node->objectList.size();
+            for (const auto& child : node->children)
+            {
+                if (!child || !child->isLeaf)
+                    return;
+                objectCount += child->objectList.size();
+            }
+
+            if (objectCount > maxObjectsPerNode)
+                return;
+
+            for (auto& child : node->children)
+            {
+                for (auto& obj : child->objectList)
+                {
+                    objectNodes[obj.object] = node;
+                    node->objectList.push_back(std::move(obj));
+                }
+                child.reset();
+            }
+            node->isLeaf = true;
+
+            node = node->parent;
+        }
     }
 
     template <typename T>
@@ -117,6 +590,12 @@ namespace Coffee {
     {
         glm::vec3 center = (node.aabb.min + node.aabb.max) * 0.5f;
         CreateChildren(node, center);
+        for (auto& child : node.children)
+        {
+            child->parent = &node;
+            child->depth = node.depth + 1;
+            child->looseAABB = GetLooseBounds(child->aabb);
+        }
         node.isLeaf = false;
     }
 
@@ -139,15 +618,41 @@ namespace Coffee {
     }
 
     template <typename T>
-    void Octree<T>::Query(const OctreeNode<T>& node, const Frustum& frustum, std::vector<ObjectContainer<T>>& results) const
+    void Octree<T>::Query(const OctreeNode<T>& node, const Frustum& frustum, const FrustumPlanes& planes, uint8_t planeMask,
+                          std::vector<uint8_t>& visible, std::vector<ObjectContainer<T>>& results) const
     {
-        if (!frustum.Contains(node.aabb))
-            return;
+        // In loose mode the root can hold objects outside the world bounds, so it is never culled
+        bool isLooseRoot = IsLoose() && !node.parent;
+        if (!isLooseRoot)
+        {
+            switch (Classify(node, frustum, planeMask))
+            {
+                using enum IntersectionType;
+                case Outside:
+                    return;
+                case Inside:
+                    // The objects of the subtree fit in these bounds (or have their origin in them in the classic
+                    // mode), they are accepted without any test
+                    CollectAll(node, results);
+                    return;
+                case Intersect:
+                    break;
+            }
+        }
 
-        for (const auto& object : node.objectList)
+        // The objects of the node are tested in SIMD batches, straight from the containers, against the planes the
+        // node crosses. A loose node bounds its objects so the result is the same as with all the planes, in the
+        // classic mode an object sticking out of its node can only be kept, never culled by mistake.
+        if (!node.objectList.empty())
         {
-            if (frustum.Contains(object.aabb.CalculateTransformedAABB(object.transform)))
-                results.push_back(object);
+            visible.resize(node.objectList.size());
+            CullAABBs(planes, &node.objectList[0].worldAABB, node.objectList.size(), sizeof(ObjectContainer<T>), visible.data(), planeMask);
+
+            for (size_t i = 0; i < node.objectList.size(); i++)
+            {
+                if (visible[i])
+                    results.push_back(node.objectList[i]);
+            }
         }
     
         if (node.isLeaf)
@@ -157,11 +662,81 @@ namespace Coffee {
         {
             if (child)
             {
-                Query(*child, frustum, results);
+                Query(*child, frustum, planes, planeMask, visible, results);
+            }
+        }
+    }
+
+    template <typename T>
+    void Octree<T>::CollectAll(const OctreeNode<T>& node, std::vector<ObjectContainer<T>>& results) const
+    {
+        results.insert(results.end(), node.objectList.begin(), node.objectList.end());
+
+        if (node.isLeaf)
+            return;
+
+        for (const auto& child : node.children)
+        {
+            if (child)
+            {
+                CollectAll(*child, results);
             }
         }
     }
 
+    template <typename T>
+    IntersectionType Octree<T>::Classify(const OctreeNode<T>& node, const Frustum& frustum, uint8_t& planeMask) const
+    {
+        NodeVisibility& visibility = node.visibility;
+
+        // Relative to a plane (n, d), a point p of the node moves by dn . (p - r) + dn . r + dd, which is at most
+        // |dn| |p - r| + |dn . r + dd| for the reference point r. A classification farther than that from the planes
+        // still holds
+        if (visibilityCacheEnabled && queryCount > 1 && visibility.query == queryCount - 1)
+        {
+            float distance = glm::length(node.looseAABB.GetCenter() - planeReference) + glm::length(node.looseAABB.GetHalfSize());
+            float shift = planeOffsetShift + planeNormalShift * distance;
+
+            if (visibility.margin > shift)
+            {
+                // The planes can keep moving the same way, the margin left is what the next query can use
+                float margin = visibility.margin - shift;
+
+                // An Inside node is only reused when it was tested against all the planes it has to be tested now
+                if (visibility.type == IntersectionType::Outside && visibility.planeMask != 0)
+                {
+                    visibility.query = queryCount;
+                    visibility.margin = margin;
+                    visibilityCacheStats.hits++;
+                    return IntersectionType::Outside;
+                }
+
+                if (visibility.type == IntersectionType::Inside && (planeMask & ~visibility.planeMask) == 0)
+                {
+                    visibility.query = queryCount;
+                    visibility.margin = margin;
+                    visibilityCacheStats.hits++;
+                    planeMask = 0;
+                    return IntersectionType::Inside;
+                }
+            }
+        }
+
+        visibilityCacheStats.misses++;
+
+        uint8_t testedPlanes = planeMask;
+        float margin;
+        int plane;
+        IntersectionType type = frustum.Intersect(node.looseAABB, planeMask, margin, plane);
+
+        visibility.query = queryCount;
+        visibility.type = type;
+        visibility.planeMask = type == IntersectionType::Outside ? (plane >= 0 ? 1 << plane : 0) : testedPlanes;
+        visibility.margin = margin;
+
+        return type;
+    }
+
     template <typename T>
     void OctreeNode<T>::DebugDrawAABB()
     {
@@ -188,8 +763,7 @@ namespace Coffee {
 
         for (auto& obj : objectList)
         {
-            AABB aabb = obj.aabb.CalculateTransformedAABB(obj.transform);
-            DebugRenderer::DrawBox(aabb.min, aabb.max, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+            DebugRenderer::DrawBox(obj.worldAABB.min, obj.worldAABB.max, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
         }
     }
 
@@ -205,9 +779,11 @@ namespace Coffee {
     }
 
     template <typename T>
-    Octree<T>::Octree(const AABB& bounds, int maxObjectsPerNode, int maxDepth) : maxObjectsPerNode(maxObjectsPerNode), maxDepth(maxDepth)
+    Octree<T>::Octree(const AABB& bounds, int maxObjectsPerNode, int maxDepth, float looseness)
+        : maxObjectsPerNode(maxObjectsPerNode), maxDepth(maxDepth), looseness(looseness > 0.0f ? std::max(looseness, 1.0f) : 0.0f)
     {
         rootNode.aabb = bounds;
+        rootNode.looseAABB = GetLooseBounds(bounds);
     }
 
     template <typename T>
@@ -233,13 +809,37 @@ namespace Coffee {
             }
         }
         rootNode.isLeaf = true;
+        rootNode.visibility = {};
+        objectNodes.clear();
     }
 
     template <typename T>
     std::vector<ObjectContainer<T>> Octree<T>::Query(const Frustum& frustum) const
     {
+        ZoneScoped;
+
+        FrustumPlanes planes(frustum);
+        std::vector<uint8_t> visible;
+
+        // How much the planes moved since the last query, to revalidate the classifications of the nodes. The
+        // changes are measured around the center of the near plane, which the side planes pass close to
+        const glm::vec3* points = frustum.GetPoints();
+        planeReference = (points[0] + points[1] + points[2] + points[3]) * 0.25f;
+
+        queryCount++;
+        planeOffsetShift = 0.0f;
+        planeNormalShift = 0.0f;
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec4 change = frustum.GetPlanes()[i] - previousPlanes[i];
+            planeOffsetShift = std::max(planeOffsetShift, std::abs(glm::dot(glm::vec3(change), planeReference) + change.w));
+            planeNormalShift = std::max(planeNormalShift, glm::length(glm::vec3(change)));
+            previousPlanes[i] = frustum.GetPlanes()[i];
+        }
+        visibilityCacheStats = {};
+
         std::vector<ObjectContainer<T>> results;
-        Query(rootNode, frustum, results);
+        Query(rootNode, frustum, planes, Frustum::AllPlanesMask, visible, results);
         return results;
     }
 
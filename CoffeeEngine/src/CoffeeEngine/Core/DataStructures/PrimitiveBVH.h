@@ -0,0 +1,412 @@
+#pragma once
+
+#include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Math/Frustum.h"
+#include "CoffeeEngine/Math/Ray.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @brief Bounding volume hierarchy over a set of primitives given by their bounds.
+     *
+     * The tree only stores primitive indices, so the same structure is used for the triangles of a mesh and for the
+     * entities of a scene. Nodes are stored in a flat array, the two children of a node are always adjacent and
+     * always after their parent. The splits are chosen with the binned surface area heuristic.
+     */
+    class PrimitiveBVH
+    {
+    public:
+        struct Node
+        {
+            AABB Bounds;
+            uint32_t LeftFirst = 0; ///< Index of the left child, or of the first primitive for leaves.
+            uint32_t Count = 0;     ///< Number of primitives, 0 for inner nodes.
+
+            bool IsLeaf() const { return Count > 0; }
+        };
+
+        PrimitiveBVH() = default;
+
+        /**
+         * @brief Builds the hierarchy with the surface area heuristic.
+         * @param primitiveBounds The bounds of each primitive.
+         */
+        void Build(const std::vector<AABB>& primitiveBounds)
+        {
+            m_Nodes.clear();
+            m_PrimitiveIndices.resize(primitiveBounds.size());
+
+            if (primitiveBounds.empty())
+                return;
+
+            for (uint32_t i = 0; i < primitiveBounds.size(); i++)
+            {
+                m_PrimitiveIndices[i] = i;
+            }
+
+            std::vector<glm::vec3> centroids(primitiveBounds.size());
+            for (size_t i = 0; i < primitiveBounds.size(); i++)
+            {
+                centroids[i] = primitiveBounds[i].GetCenter();
+            }
+
+            m_Nodes.reserve(primitiveBounds.size() * 2);
+            m_Nodes.push_back({});
+            m_Nodes[0].LeftFirst = 0;
+            m_Nodes[0].Count = static_cast<uint32_t>(primitiveBounds.size());
+
+            Subdivide(0, 0, primitiveBounds, centroids);
+        }
+
+        /**
+         * @brief Recalculates the node bounds after the primitives moved, keeping the same topology.
+         *
+         * Much faster than a build, but the tree quality degrades as the primitives move away from their build
+         * positions.
+         *
+         * @param primitiveBounds The new bounds of each primitive, in the same order as in the build.
+         */
+        void Refit(const std::vector<AABB>& primitiveBounds)
+        {
+            // Children are always after their parent, a reverse sweep visits them first
+            for (size_t i = m_Nodes.size(); i-- > 0;)
+            {
+                Node& node = m_Nodes[i];
+
+                if (node.IsLeaf())
+                {
+                    node.Bounds = primitiveBounds[m_PrimitiveIndices[node.LeftFirst]];
+                    for (uint32_t j = 1; j < node.Count; j++)
+                    {
+                        Grow(node.Bounds, primitiveBounds[m_PrimitiveIndices[node.LeftFirst + j]]);
+                    }
+                }
+                else
+                {
+                    node.Bounds = m_Nodes[node.LeftFirst].Bounds;
+                    Grow(node.Bounds, m_Nodes[node.LeftFirst + 1].Bounds);
+                }
+            }
+        }
+
+        /**
+         * @brief Visits the primitives whose bounds are hit by a ray, closest nodes first.
+         *
+         * The visitor is called as visitor(primitiveIndex, maxDistance) and can shorten maxDistance when it finds a hit,
+         * which prunes the nodes behind it.
+         *
+         * @param ray The ray.
+         * @param maxDistance Hits further than this distance are ignored, it ends as the distance to the closest hit.
+         * @param visitor The function called for each candidate primitive.
+         */
+        template<typename Visitor>
+        void Raycast(const Ray& ray, float& maxDistance, Visitor&& visitor) const
+        {
+            if (m_Nodes.empty())
+                return;
+
+            float distance;
+            if (!ray.IntersectAABB(m_Nodes[0].Bounds, maxDistance, distance))
+                return;
+
+            std::array<uint32_t, s_MaxDepth + 2> stack;
+            uint32_t stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize > 0)
+            {
+                const Node& node = m_Nodes[stack[--stackSize]];
+
+                if (node.IsLeaf())
+                {
+                    for (uint32_t i = 0; i < node.Count; i++)
+                    {
+                        visitor(m_PrimitiveIndices[node.LeftFirst + i], maxDistance);
+                    }
+                    continue;
+                }
+
+                uint32_t nearChild = node.LeftFirst;
+                uint32_t farChild = node.LeftFirst + 1;
+
+                float nearDistance, farDistance;
+                bool hitNear = ray.IntersectAABB(m_Nodes[nearChild].Bounds, maxDistance, nearDistance);
+                bool hitFar = ray.IntersectAABB(m_Nodes[farChild].Bounds, maxDistance, farDistance);
+
+                if (hitNear && hitFar && farDistance < nearDistance)
+                {
+                    std::swap(nearChild, farChild);
+                }
+
+                // The nearest child is pushed last so it is visited first
+                if (hitNear && hitFar)
+                {
+                    stack[stackSize++] = farChild;
+                    stack[stackSize++] = nearChild;
+                }
+                else if (hitNear)
+                {
+                    stack[stackSize++] = node.LeftFirst;
+                }
+                else if (hitFar)
+                {
+                    stack[stackSize++] = node.LeftFirst + 1;
+                }
+            }
+        }
+
+        /**
+         * @brief Visits the primitives of the leaves that intersect a frustum.
+         *
+         * The primitives themselves are not tested, the visitor is called as visitor(primitiveIndex, isInside).
+         * isInside is true when a node above the primitive is fully inside the frustum, so the primitive is too.
+         * The planes a node is fully in front of are not tested again for its children.
+         *
+         * @param frustum The frustum.
+         * @param visitor The function called for each candidate primitive.
+         */
+        template<typename Visitor>
+        void Query(const Frustum& frustum, Visitor&& visitor) const
+        {
+            if (m_Nodes.empty())
+                return;
+
+            std::array<std::pair<uint32_t, uint8_t>, s_MaxDepth + 2> stack;
+            uint32_t stackSize = 0;
+            stack[stackSize++] = {0, Frustum::AllPlanesMask};
+
+            while (stackSize > 0)
+            {
+                auto [nodeIndex, planeMask] = stack[--stackSize];
+                const Node& node = m_Nodes[nodeIndex];
+
+                IntersectionType intersection = frustum.Intersect(node.Bounds, planeMask);
+                if (intersection == IntersectionType::Outside)
+                    continue;
+
+                if (intersection == IntersectionType::Inside)
+                {
+                    VisitSubtree(nodeIndex, visitor);
+                    continue;
+                }
+
+                if (node.IsLeaf())
+                {
+                    for (uint32_t i = 0; i < node.Count; i++)
+                    {
+                        visitor(m_PrimitiveIndices[node.LeftFirst + i], false);
+                    }
+                    continue;
+                }
+
+                stack[stackSize++] = {node.LeftFirst + 1, planeMask};
+                stack[stackSize++] = {node.LeftFirst, planeMask};
+            }
+        }
+
+        /**
+         * @brief Checks if the hierarchy has no primitives.
+         * @return True if there is nothing to query.
+         */
+        bool IsEmpty() const { return m_Nodes.empty(); }
+
+        const std::vector<Node>& GetNodes() const { return m_Nodes; }
+
+        /**
+         * @brief Gets the surface area of an AABB, the cost metric of the heuristic.
+         * @param aabb The AABB.
+         * @return The surface area.
+         */
+        static float GetSurfaceArea(const AABB& aabb)
+        {
+            glm::vec3 size = aabb.max - aabb.min;
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+    private:
+        struct Bin
+        {
+            AABB Bounds;
+            uint32_t Count = 0;
+        };
+
+        template<typename Visitor>
+        void VisitSubtree(uint32_t rootIndex, Visitor& visitor) const
+        {
+            std::array<uint32_t, s_MaxDepth + 2> stack;
+            uint32_t stackSize = 0;
+            stack[stackSize++] = rootIndex;
+
+            while (stackSize > 0)
+            {
+                const Node& node = m_Nodes[stack[--stackSize]];
+
+                if (node.IsLeaf())
+                {
+                    for (uint32_t i = 0; i < node.Count; i++)
+                    {
+                        visitor(m_PrimitiveIndices[node.LeftFirst + i], true);
+                    }
+                    continue;
+                }
+
+                stack[stackSize++] = node.LeftFirst + 1;
+                stack[stackSize++] = node.LeftFirst;
+            }
+        }
+
+        static void Grow(AABB& bounds, const AABB& other)
+        {
+            bounds.min = glm::min(bounds.min, other.min);
+            bounds.max = glm::max(bounds.max, other.max);
+        }
+
+        void Subdivide(uint32_t nodeIndex, uint32_t depth, const std::vector<AABB>& primitiveBounds, const std::vector<glm::vec3>& centroids)
+        {
+            Node& node = m_Nodes[nodeIndex];
+
+            node.Bounds = primitiveBounds[m_PrimitiveIndices[node.LeftFirst]];
+            glm::vec3 centroidMin = centroids[m_PrimitiveIndices[node.LeftFirst]];
+            glm::vec3 centroidMax = centroidMin;
+
+            for (uint32_t i = 0; i < node.Count; i++)
+            {
+                uint32_t primitive = m_PrimitiveIndices[node.LeftFirst + i];
+                Grow(node.Bounds, primitiveBounds[primitive]);
+                centroidMin = glm::min(centroidMin, centroids[primitive]);
+                centroidMax = glm::max(centroidMax, centroids[primitive]);
+            }
+
+            if (node.Count <= s_MinLeafPrimitives || depth >= s_MaxDepth)
+                return;
+
+            // Find the cheapest split among the bin boundaries of the three axes
+            glm::vec3 extent = centroidMax - centroidMin;
+            float bestCost = std::numeric_limits<float>::max();
+            int bestAxis = -1;
+            uint32_t bestSplit = 0;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                // All the centroids are in the same plane, there is no way to split them on this axis
+                if (extent[axis] <= 0.0f)
+                    continue;
+
+                std::array<Bin, s_BinCount> bins;
+                float binScale = s_BinCount / extent[axis];
+
+                for (uint32_t i = 0; i < node.Count; i++)
+                {
+                    uint32_t primitive = m_PrimitiveIndices[node.LeftFirst + i];
+                    uint32_t binIndex = std::min(s_BinCount - 1, static_cast<uint32_t>((centroids[primitive][axis] - centroidMin[axis]) * binScale));
+
+                    Bin& bin = bins[binIndex];
+                    if (bin.Count++ == 0)
+                        bin.Bounds = primitiveBounds[primitive];
+                    else
+                        Grow(bin.Bounds, primitiveBounds[primitive]);
+                }
+
+                // Sweep from both sides to get the cost of every split in linear time
+                std::array<float, s_BinCount - 1> leftCosts;
+                AABB leftBounds;
+                uint32_t leftCount = 0;
+                for (uint32_t i = 0; i < s_BinCount - 1; i++)
+                {
+                    if (bins[i].Count > 0)
+                    {
+                        if (leftCount == 0)
+                            leftBounds = bins[i].Bounds;
+                        else
+                            Grow(leftBounds, bins[i].Bounds);
+                        leftCount += bins[i].Count;
+                    }
+                    leftCosts[i] = leftCount > 0 ? leftCount * GetSurfaceArea(leftBounds) : 0.0f;
+                }
+
+                AABB rightBounds;
+                uint32_t rightCount = 0;
+                for (uint32_t i = s_BinCount - 1; i > 0; i--)
+                {
+                    if (bins[i].Count > 0)
+                    {
+                        if (rightCount == 0)
+                            rightBounds = bins[i].Bounds;
+                        else
+                            Grow(rightBounds, bins[i].Bounds);
+                        rightCount += bins[i].Count;
+                    }
+
+                    uint32_t splitLeftCount = node.Count - rightCount;
+                    if (rightCount == 0 || splitLeftCount == 0)
+                        continue;
+
+                    float cost = leftCosts[i - 1] + rightCount * GetSurfaceArea(rightBounds);
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                }
+            }
+
+            if (bestAxis == -1)
+                return;
+
+            // Splitting costs one traversal step, keep the leaf when it is cheaper to test all its primitives
+            float leafCost = node.Count * GetSurfaceArea(node.Bounds);
+            float splitCost = s_TraversalCost * GetSurfaceArea(node.Bounds) + bestCost;
+            if (splitCost >= leafCost && node.Count <= s_MaxLeafPrimitives)
+                return;
+
+            float binScale = s_BinCount / extent[bestAxis];
+            auto first = m_PrimitiveIndices.begin() + node.LeftFirst;
+            auto last = first + node.Count;
+            auto middle = std::partition(first, last, [&](uint32_t primitive) {
+                uint32_t binIndex = std::min(s_BinCount - 1, static_cast<uint32_t>((centroids[primitive][bestAxis] - centroidMin[bestAxis]) * binScale));
+                return binIndex < bestSplit;
+            });
+
+            uint32_t leftCount = static_cast<uint32_t>(middle - first);
+            if (leftCount == 0 || leftCount == node.Count)
+                return;
+
+            uint32_t leftChild = static_cast<uint32_t>(m_Nodes.size());
+
+            m_Nodes.push_back({});
+            m_Nodes.push_back({});
+
+            // The push_back can reallocate, the node reference is not valid anymore
+            Node& parent = m_Nodes[nodeIndex];
+            m_Nodes[leftChild].LeftFirst = parent.LeftFirst;
+            m_Nodes[leftChild].Count = leftCount;
+            m_Nodes[leftChild + 1].LeftFirst = parent.LeftFirst + leftCount;
+            m_Nodes[leftChild + 1].Count = parent.Count - leftCount;
+
+            parent.LeftFirst = leftChild;
+            parent.Count = 0;
+
+            Subdivide(leftChild, depth + 1, primitiveBounds, centroids);
+            Subdivide(leftChild + 1, depth + 1, primitiveBounds, centroids);
+        }
+
+    private:
+        std::vector<Node> m_Nodes;
+        std::vector<uint32_t> m_PrimitiveIndices;
+
+        static constexpr uint32_t s_BinCount = 16;
+        static constexpr uint32_t s_MinLeafPrimitives = 2;  ///< Nodes with this many primitives are never split.
+        static constexpr uint32_t s_MaxLeafPrimitives = 16; ///< Nodes with more primitives are split even if the heuristic prefers a leaf.
+        static constexpr uint32_t s_MaxDepth = 62; ///< Bounds the traversal stacks.
+        static constexpr float s_TraversalCost = 1.0f; ///< Cost of visiting an inner node, relative to testing a primitive.
+    };
+
+}
@@ -0,0 +1,454 @@
+#pragma once
+
+#include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Renderer/DebugRenderer.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    /**
+     * @brief Uniform grid of points hashed by cell coordinate, for radius, box and nearest neighbour queries.
+     *
+     * Only the occupied cells are stored, so the grid has no bounds. Inserting, moving and removing a point are O(1):
+     * each cell keeps the indices of its points and each point the slot it has in its cell, so it can be swapped out.
+     * The queries only visit the cells that overlap the searched region. The object itself is used as the key, so it
+     * must be unique and hashable (e.g. an entity handle).
+     */
+    template <typename T>
+    class SpatialHash
+    {
+    public:
+        /**
+         * @brief Constructs a spatial hash.
+         * @param cellSize The size of the cells, close to the usual query radius works best.
+         */
+        SpatialHash(float cellSize = 4.0f);
+
+        /**
+         * @brief Change the size of the cells, all the points are hashed again.
+         * @param cellSize The new size of the cells.
+         */
+        void SetCellSize(float cellSize);
+        float GetCellSize() const { return cellSize; }
+
+        void Insert(const T& object, const glm::vec3& position);
+
+        /**
+         * @brief Move an object, inserting it if it is not in the grid.
+         * @param object The object.
+         * @param position The new position.
+         */
+        void Update(const T& object, const glm::vec3& position);
+
+        /**
+         * @brief Remove an object.
+         * @param object The object to remove.
+         * @return True if the object was in the grid.
+         */
+        bool Remove(const T& object);
+
+        bool Contains(const T& object) const { return entryIndices.contains(object); }
+        size_t Size() const { return entries.size(); }
+        size_t GetCellCount() const { return cells.size(); }
+
+        /**
+         * @brief Find the objects within a distance of a point.
+         * @param center The center of the sphere.
+         * @param radius The radius of the sphere.
+         * @param results The vector the objects are appended to, in no particular order.
+         */
+        void QueryRadius(const glm::vec3& center, float radius, std::vector<T>& results) const;
+
+        /**
+         * @brief Find the objects inside a box.
+         * @param box The box.
+         * @param results The vector the objects are appended to, in no particular order.
+         */
+        void QueryBox(const AABB& box, std::vector<T>& results) const;
+
+        /**
+         * @brief Find the objects closest to a point.
+         *
+         * The cells are visited in growing shells around the point until no unvisited cell can hold a closer object.
+         *
+         * @param point The point.
+         * @param count The maximum number of objects to find.
+         * @param results The vector the objects are appended to, nearest first.
+         */
+        void QueryNearest(const glm::vec3& point, size_t count, std::vector<T>& results) const;
+
+        void DebugDraw() const;
+        void Clear();
+
+    private:
+        using CellKey = uint64_t;
+
+        struct Entry
+        {
+            T object;
+            glm::vec3 position;
+            CellKey cell; ///< The key of the cell the object is in.
+            uint32_t slot; ///< The index of the object in its cell.
+        };
+
+        glm::ivec3 GetCellCoordinates(const glm::vec3& position) const;
+        static CellKey GetCellKey(const glm::ivec3& coordinates);
+        static glm::ivec3 DecodeCellKey(CellKey key);
+
+        /**
+         * @brief Call a visitor with the points of every occupied cell in a range of cell coordinates.
+         *
+         * When the range has more cells than the grid has occupied cells, the occupied cells are scanned instead.
+         *
+         * @param min The first cell of the range.
+         * @param max The last cell of the range, inclusive.
+         * @param visitor Called with the index of each entry.
+         */
+        template <typename Visitor>
+        void ForEachEntry(glm::ivec3 min, glm::ivec3 max, Visitor&& visitor) const;
+
+        void AddToCell(uint32_t index);
+        void RemoveFromCell(uint32_t index);
+
+        float cellSize;
+        float inverseCellSize;
+        std::vector<Entry> entries;
+        std::unordered_map<T, uint32_t> entryIndices; ///< The index of each object in the entries.
+        std::unordered_map<CellKey, std::vector<uint32_t>> cells; ///< The entries of each occupied cell.
+
+        static constexpr int32_t s_CoordinateBits = 21; ///< Bits of each cell coordinate in the key.
+        static constexpr int32_t s_MaxCoordinate = (1 << (s_CoordinateBits - 1)) - 1;
+        static constexpr int32_t s_MinCoordinate = -(1 << (s_CoordinateBits - 1));
+    };
+
+    template <typename T>
+    SpatialHash<T>::SpatialHash(float cellSize)
+        : cellSize(cellSize), inverseCellSize(1.0f / cellSize)
+    {
+    }
+
+    template <typename T>
+    void SpatialHash<T>::SetCellSize(float newCellSize)
+    {
+        ZoneScoped;
+
+        cellSize = newCellSize;
+        inverseCellSize = 1.0f / newCellSize;
+
+        cells.clear();
+        for (uint32_t i = 0; i < entries.size(); i++)
+        {
+            entries[i].cell = GetCellKey(GetCellCoordinates(entries[i].position));
+            AddToCell(i);
+        }
+    }
+
+    template <typename T>
+    void SpatialHash<T>::Insert(const T& object, const glm::vec3& position)
+    {
+        if (entryIndices.contains(object))
+        {
+            Update(object, position);
+            return;
+        }
+
+        uint32_t index = static_cast<uint32_t>(entries.size());
+        entryIndices[object] = index;
+        entries.push_back({object, position, GetCellKey(GetCellCoordinates(position)), 0});
+        AddToCell(index);
+    }
+
+    template <typename T>
+    void SpatialHash<T>::Update(const T& object, const glm::vec3& position)
+    {
+        auto it = entryIndices.find(object);
+        if (it == entryIndices.end())
+        {
+            Insert(object, position);
+            return;
+        }
+
+        uint32_t index = it->second;
+        Entry& entry = entries[index];
+        entry.position = position;
+
+        CellKey cell = GetCellKey(GetCellCoordinates(position));
+        if (cell == entry.cell)
+            return;
+
+        RemoveFromCell(index);
+        entry.cell = cell;
+        AddToCell(index);
+    }
+
+    template <typename T>
+    bool SpatialHash<T>::Remove(const T& object)
+    {
+        auto it = entryIndices.find(object);
+        if (it == entryIndices.end())
+            return false;
+
+        uint32_t index = it->second;
+        entryIndices.erase(it);
+        RemoveFromCell(index);
+
+        // The last entry takes the place of the removed one, its cell has to point to the new index
+        uint32_t last = static_cast<uint32_t>(entries.size() - 1);
+        if (index != last)
+        {
+            entries[index] = std::move(entries[last]);
+            cells[entries[index].cell][entries[index].slot] = index;
+            entryIndices[entries[index].object] = index;
+        }
+
+        entries.pop_back();
+        return true;
+    }
+
+    template <typename T>
+    void SpatialHash<T>::QueryRadius(const glm::vec3& center, float radius, std::vector<T>& results) const
+    {
+        ZoneScoped;
+
+        float radiusSquared = radius * radius;
+        ForEachEntry(GetCellCoordinates(center - radius), GetCellCoordinates(center + radius), [&](uint32_t index) {
+            glm::vec3 offset = entries[index].position - center;
+            if (glm::dot(offset, offset) <= radiusSquared)
+                results.push_back(entries[index].object);
+        });
+    }
+
+    template <typename T>
+    void SpatialHash<T>::QueryBox(const AABB& box, std::vector<T>& results) const
+    {
+        ZoneScoped;
+
+        ForEachEntry(GetCellCoordinates(box.min), GetCellCoordinates(box.max), [&](uint32_t index) {
+            const glm::vec3& position = entries[index].position;
+            if (glm::all(glm::greaterThanEqual(position, box.min)) && glm::all(glm::lessThanEqual(position, box.max)))
+                results.push_back(entries[index].object);
+        });
+    }
+
+    template <typename T>
+    void SpatialHash<T>::QueryNearest(const glm::vec3& point, size_t count, std::vector<T>& results) const
+    {
+        ZoneScoped;
+
+        if (count == 0 || entries.empty())
+            return;
+
+        // Max heap of the closest entries found so far, the farthest one on top
+        std::vector<std::pair<float, uint32_t>> closest;
+        closest.reserve(std::min(count, entries.size()));
+
+        auto visit = [&](uint32_t index) {
+            glm::vec3 offset = entries[index].position - point;
+            float distanceSquared = glm::dot(offset, offset);
+
+            if (closest.size() < count)
+            {
+                closest.emplace_back(distanceSquared, index);
+                std::push_heap(closest.begin(), closest.end());
+            }
+            else if (distanceSquared < closest.front().first)
+            {
+                std::pop_heap(closest.begin(), closest.end());
+                closest.back() = {distanceSquared, index};
+                std::push_heap(closest.begin(), closest.end());
+            }
+        };
+
+        glm::ivec3 center = GetCellCoordinates(point);
+        size_t visitedCount = 0;
+
+        for (int32_t shell = 0;; shell++)
+        {
+            // Stop when the farthest of the closest objects is nearer than any cell outside the visited shells
+            if (closest.size() == count)
+            {
+                glm::vec3 visitedMin = glm::vec3(center - (shell - 1)) * cellSize;
+                glm::vec3 visitedMax = glm::vec3(center + shell) * cellSize;
+                glm::vec3 reach = glm::min(point - visitedMin, visitedMax - point);
+                float minReach = std::max(std::min({reach.x, reach.y, reach.z}), 0.0f);
+                if (closest.front().first <= minReach * minReach)
+                    break;
+            }
+
+            if (visitedCount == entries.size())
+                break;
+
+            // A sparse grid would need many empty shells, past this point scanning every entry is cheaper
+            int64_t side = 2 * static_cast<int64_t>(shell) + 1;
+            int64_t shellCellCount = shell == 0 ? 1 : side * side * side - (side - 2) * (side - 2) * (side - 2);
+            if (shellCellCount > static_cast<int64_t>(cells.size()))
+            {
+                closest.clear();
+                for (uint32_t i = 0; i < entries.size(); i++)
+                {
+                    visit(i);
+                }
+                break;
+            }
+
+            auto visitCell = [&](int32_t x, int32_t y, int32_t z) {
+                glm::ivec3 coordinates = center + glm::ivec3(x, y, z);
+                if (glm::any(glm::lessThan(coordinates, glm::ivec3(s_MinCoordinate))) ||
+                    glm::any(glm::greaterThan(coordinates, glm::ivec3(s_MaxCoordinate))))
+                    return;
+
+                auto it = cells.find(GetCellKey(coordinates));
+                if (it == cells.end())
+                    return;
+
+                for (uint32_t index : it->second)
+                {
+                    visit(index);
+                }
+                visitedCount += it->second.size();
+            };
+
+            // Only the surface of the cube of cells, the inside was visited by the previous shells
+            for (int32_t x = -shell; x <= shell; x++)
+            {
+                for (int32_t y = -shell; y <= shell; y++)
+                {
+                    bool isOnSurface = x == -shell || x == shell || y == -shell || y == shell;
+                    int32_t zStep = isOnSurface ? 1 : std::max(2 * shell, 1);
+                    for (int32_t z = -shell; z <= shell; z += zStep)
+                    {
+                        visitCell(x, y, z);
+                    }
+                }
+            }
+        }
+
+        std::sort_heap(closest.begin(), closest.end());
+        for (const auto& [distanceSquared, index] : closest)
+        {
+            results.push_back(entries[index].object);
+        }
+    }
+
+    template <typename T>
+    void SpatialHash<T>::DebugDraw() const
+    {
+        for (const auto& [key, cell] : cells)
+        {
+            glm::vec3 min = glm::vec3(DecodeCellKey(key)) * cellSize;
+            DebugRenderer::DrawBox(min, min + cellSize, glm::vec4(0.0f, 0.5f, 1.0f, 1.0f));
+        }
+    }
+
+    template <typename T>
+    void SpatialHash<T>::Clear()
+    {
+        entries.clear();
+        entryIndices.clear();
+        cells.clear();
+    }
+
+    template <typename T>
+    glm::ivec3 SpatialHash<T>::GetCellCoordinates(const glm::vec3& position) const
+    {
+        // Clamped in floating point, far away or invalid positions end up in the border cells
+        glm::vec3 coordinates = glm::floor(position * inverseCellSize);
+        coordinates = glm::clamp(coordinates, glm::vec3(static_cast<float>(s_MinCoordinate)), glm::vec3(static_cast<float>(s_MaxCoordinate)));
+        return glm::ivec3(coordinates);
+    }
+
+    template <typename T>
+    typename SpatialHash<T>::CellKey SpatialHash<T>::GetCellKey(const glm::ivec3& coordinates)
+    {
+        constexpr CellKey mask = (CellKey(1) << s_CoordinateBits) - 1;
+        CellKey x = static_cast<CellKey>(coordinates.x - s_MinCoordinate) & mask;
+        CellKey y = static_cast<CellKey>(coordinates.y - s_MinCoordinate) & mask;
+        CellKey z = static_cast<CellKey>(coordinates.z - s_MinCoordinate) & mask;
+        return x | (y << s_CoordinateBits) | (z << (2 * s_CoordinateBits));
+    }
+
+    template <typename T>
+    glm::ivec3 SpatialHash<T>::DecodeCellKey(CellKey key)
+    {
+        constexpr CellKey mask = (CellKey(1) << s_CoordinateBits) - 1;
+        return glm::ivec3(static_cast<int32_t>(key & mask) + s_MinCoordinate,
+                          static_cast<int32_t>((key >> s_CoordinateBits) & mask) + s_MinCoordinate,
+                          static_cast<int32_t>((key >> (2 * s_CoordinateBits)) & mask) + s_MinCoordinate);
+    }
+
+    template <typename T>
+    template <typename Visitor>
+    void SpatialHash<T>::ForEachEntry(glm::ivec3 min, glm::ivec3 max, Visitor&& visitor) const
+    {
+        int64_t rangeCellCount = (static_cast<int64_t>(max.x) - min.x + 1) * (static_cast<int64_t>(max.y) - min.y + 1) *
+                                 (static_cast<int64_t>(max.z) - min.z + 1);
+
+        if (rangeCellCount > static_cast<int64_t>(cells.size()))
+        {
+            for (const auto& [key, cell] : cells)
+            {
+                glm::ivec3 coordinates = DecodeCellKey(key);
+                if (glm::any(glm::lessThan(coordinates, min)) || glm::any(glm::greaterThan(coordinates, max)))
+                    continue;
+
+                for (uint32_t index : cell)
+                {
+                    visitor(index);
+                }
+            }
+            return;
+        }
+
+        for (int32_t z = min.z; z <= max.z; z++)
+        {
+            for (int32_t y = min.y; y <= max.y; y++)
+            {
+                for (int32_t x = min.x; x <= max.x; x++)
+                {
+                    auto it = cells.find(GetCellKey({x, y, z}));
+                    if (it == cells.end())
+                        continue;
+
+                    for (uint32_t index : it->second)
+                    {
+                        visitor(index);
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    void SpatialHash<T>::AddToCell(uint32_t index)
+    {
+        std::vector<uint32_t>& cell = cells[entries[index].cell];
+        entries[index].slot = static_cast<uint32_t>(cell.size());
+        cell.push_back(index);
+    }
+
+    template <typename T>
+    void SpatialHash<T>::RemoveFromCell(uint32_t index)
+    {
+        auto it = cells.find(entries[index].cell);
+        std::vector<uint32_t>& cell = it->second;
+
+        uint32_t slot = entries[index].slot;
+        cell[slot] = cell.back();
+        entries[cell[slot]].slot = slot;
+        cell.pop_back();
+
+        // Empty cells are dropped so the scans of the occupied cells stay short
+        if (cell.empty())
+        {
+            cells.erase(it);
+        }
+    }
+
+} // namespace Coffee
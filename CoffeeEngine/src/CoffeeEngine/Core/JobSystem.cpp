@@ -0,0 +1,167 @@
+#include "JobSystem.h"
+#include "CoffeeEngine/Core/Log.h"
+#include "CoffeeEngine/Core/SystemInfo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tracy/Tracy.hpp>
+#include <vector>
+
+namespace Coffee {
+
+    static std::vector<std::thread> s_Workers;
+    static std::deque<std::function<void()>> s_JobQueue;
+    static std::mutex s_QueueMutex;
+    static std::condition_variable s_JobAvailable;
+    static std::condition_variable s_JobsFinished;
+    static std::atomic<uint32_t> s_PendingJobs = 0;
+    static bool s_Running = false;
+
+    static void WorkerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(s_QueueMutex);
+                s_JobAvailable.wait(lock, [] { return !s_JobQueue.empty() || !s_Running; });
+
+                if (!s_Running && s_JobQueue.empty())
+                    return;
+
+                job = std::move(s_JobQueue.front());
+                s_JobQueue.pop_front();
+            }
+
+            job();
+
+            if (--s_PendingJobs == 0)
+            {
+                std::lock_guard<std::mutex> lock(s_QueueMutex);
+                s_JobsFinished.notify_all();
+            }
+        }
+    }
+
+    void JobSystem::Init()
+    {
+        ZoneScoped;
+
+        uint32_t processorCount = std::max(SystemInfo::GetLogicalProcessorCount(), 1u);
+
+        s_Running = true;
+
+        // The main thread also runs jobs inside ParallelFor
+        for (uint32_t i = 0; i < processorCount - 1; i++)
+        {
+            s_Workers.emplace_back(WorkerLoop);
+        }
+
+        COFFEE_CORE_INFO("JobSystem initialized with {0} worker threads", s_Workers.size());
+    }
+
+    void JobSystem::Shutdown()
+    {
+        Wait();
+
+        {
+            std::lock_guard<std::mutex> lock(s_QueueMutex);
+            s_Running = false;
+        }
+        s_JobAvailable.notify_all();
+
+        for (auto& worker : s_Workers)
+        {
+            worker.join();
+        }
+        s_Workers.clear();
+    }
+
+    uint32_t JobSystem::GetThreadCount()
+    {
+        return static_cast<uint32_t>(s_Workers.size()) + 1;
+    }
+
+    void JobSystem::Execute(const std::function<void()>& job)
+    {
+        if (s_Workers.empty())
+        {
+            job();
+            return;
+        }
+
+        s_PendingJobs++;
+        {
+            std::lock_guard<std::mutex> lock(s_QueueMutex);
+            s_JobQueue.push_back(job);
+        }
+        s_JobAvailable.notify_one();
+    }
+
+    void JobSystem::ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& job)
+    {
+        if (count == 0)
+            return;
+
+        batchSize = std::max(batchSize, 1u);
+        uint32_t batchCount = (count + batchSize - 1) / batchSize;
+
+        if (s_Workers.empty() || batchCount == 1)
+        {
+            job(0, count);
+            return;
+        }
+
+        // Shared with the helpers, a helper that starts late finds no batch left and may outlive this call
+        struct ParallelForState
+        {
+            std::atomic<uint32_t> nextBatch = 0;
+            std::atomic<uint32_t> finishedBatches = 0;
+            std::function<void(uint32_t, uint32_t)> job;
+        };
+
+        auto state = std::make_shared<ParallelForState>();
+        state->job = job;
+
+        auto runBatches = [state, count, batchSize, batchCount]() {
+            uint32_t batch;
+            while ((batch = state->nextBatch++) < batchCount)
+            {
+                uint32_t begin = batch * batchSize;
+                uint32_t end = std::min(begin + batchSize, count);
+                state->job(begin, end);
+                state->finishedBatches++;
+            }
+        };
+
+        uint32_t helperCount = std::min(static_cast<uint32_t>(s_Workers.size()), batchCount - 1);
+        for (uint32_t i = 0; i < helperCount; i++)
+        {
+            Execute(runBatches);
+        }
+
+        runBatches();
+
+        while (state->finishedBatches.load() < batchCount)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    bool JobSystem::IsBusy()
+    {
+        return s_PendingJobs.load() > 0;
+    }
+
+    void JobSystem::Wait()
+    {
+        std::unique_lock<std::mutex> lock(s_QueueMutex);
+        s_JobsFinished.wait(lock, [] { return s_PendingJobs.load() == 0; });
+    }
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace Coffee {
+
+    /**
+     * @defgroup core Core
+     * @brief Core components of the CoffeeEngine.
+     * @{
+     */
+
+    /**
+     * @brief Pool of worker threads used to split CPU work across the available cores.
+     *
+     * The pool is sized with SystemInfo::GetLogicalProcessorCount(), the calling thread counts as one of them.
+     * If the job system is not initialized every job runs immediately on the calling thread.
+     */
+    class JobSystem
+    {
+    public:
+        /**
+         * @brief Creates the worker threads.
+         */
+        static void Init();
+
+        /**
+         * @brief Waits for the pending jobs and joins the worker threads.
+         */
+        static void Shutdown();
+
+        /**
+         * @brief Gets the number of threads that can run jobs, including the calling thread.
+         * @return The number of threads.
+         */
+        static uint32_t GetThreadCount();
+
+        /**
+         * @brief Queues a job to run asynchronously on a worker thread.
+         * @param job The job to run.
+         */
+        static void Execute(const std::function<void()>& job);
+
+        /**
+         * @brief Splits a range in batches and runs them across the worker threads.
+         *
+         * The calling thread also processes batches and the function returns once the whole range is done.
+         *
+         * @param count The number of elements of the range.
+         * @param batchSize The minimum number of elements processed by a single job.
+         * @param job The function called with the [begin, end) range of each batch.
+         */
+        static void ParallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t begin, uint32_t end)>& job);
+
+        /**
+         * @brief Checks if any job queued with Execute is still pending or running.
+         * @return True if there is work in flight.
+         */
+        static bool IsBusy();
+
+        /**
+         * @brief Blocks until all the jobs queued with Execute have finished.
+         */
+        static void Wait();
+    };
+
+    /** @} */
+}
@@ -101,7 +101,7 @@ struct Material
 
 uniform Material material;
 
-#define MAX_LIGHTS 32
+#define MAX_DIRECTIONAL_LIGHTS 8
 
 struct Light
 {
@@ -118,10 +118,35 @@ struct Light
     int type;
 };
 
+layout (std140, binding = 0) uniform camera
+{
+    mat4 projection;
+    mat4 view;
+    vec3 cameraPos;
+};
+
 layout (std140, binding = 1) uniform RenderData
 {
-    Light lights[MAX_LIGHTS];
-    int lightCount;
+    Light directionalLights[MAX_DIRECTIONAL_LIGHTS];
+    int directionalLightCount;
+    uvec4 clusterGrid; // Clusters along x, y and z, w is 1 for logarithmic depth slices
+    vec4 clusterDepth; // Scale and bias from view depth to depth slice (xy), viewport size (zw)
+};
+
+// Point and spot lights, every cluster of the view frustum has the offset and size of its list of light indices
+layout (std430, binding = 2) readonly buffer LightBuffer
+{
+    Light lights[];
+};
+
+layout (std430, binding = 3) readonly buffer ClusterBuffer
+{
+    uvec2 clusters[];
+};
+
+layout (std430, binding = 4) readonly buffer LightIndexBuffer
+{
+    uint lightIndices[];
 };
 
 uniform bool showNormals;
@@ -169,6 +194,70 @@ float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
 }
 
 
+uint GetClusterIndex(vec3 worldPos)
+{
+    float viewDepth = -(view * vec4(worldPos, 1.0)).z;
+    float depth = clusterGrid.w != 0u ? log(max(viewDepth, 0.000001)) : viewDepth;
+    uint slice = uint(clamp(depth * clusterDepth.x + clusterDepth.y, 0.0, float(clusterGrid.z - 1u)));
+    uvec2 tile = uvec2(clamp(gl_FragCoord.xy / clusterDepth.zw * vec2(clusterGrid.xy), vec2(0.0), vec2(clusterGrid.xy - 1u)));
+
+    return tile.x + (tile.y + slice * clusterGrid.y) * clusterGrid.x;
+}
+
+vec3 CalculateLight(Light light, vec3 worldPos, vec3 N, vec3 V, vec3 albedo, float metallic, float roughness, vec3 F0)
+{
+    vec3 L = vec3(0.0);
+
+    vec3 radiance = vec3(0.0);
+
+    if(light.type == 0)
+    {
+        /*====Directional Light====*/
+
+        L = normalize(-light.direction);
+        radiance = light.color * light.intensity;
+    }
+    else
+    {
+        /*====Point and Spot Light====*/
+
+        L = normalize(light.position - worldPos);
+        float distance = length(light.position - worldPos);
+
+        // Fades out to zero at the range, the clusters only list the light inside it
+        float window = clamp(1.0 - pow(distance / light.range, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance);
+
+        if(light.type == 2)
+        {
+            /*====Spot Light====*/
+
+            float outerCos = cos(radians(light.angle));
+            float innerCos = cos(radians(light.angle) * 0.8);
+            attenuation *= smoothstep(outerCos, innerCos, dot(-L, normalize(light.direction)));
+        }
+
+        radiance = light.color * attenuation * light.intensity;
+    }
+
+    vec3 H = normalize(V + L);
+
+    float NDF = DistributionGGX(N, H, roughness);
+    float G = GeometrySmith(N, V, L, roughness);
+    vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;
+
+    vec3 numerator = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
+    vec3 specular = numerator / denominator;
+
+    float NdotL = max(dot(N, L), 0.0);
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
 void main()
 {
     vec3 albedo = material.hasAlbedo * (texture(material.albedoMap, VertexInput.TexCoords).rgb * material.color.rgb) + (1 - material.hasAlbedo) * material.color.rgb;
@@ -192,50 +281,16 @@ void main()
     F0 = mix(F0, albedo, metallic);
 
     vec3 Lo = vec3(0.0);
-    for(int i = 0; i < lightCount; i++)
+    for(int i = 0; i < directionalLightCount; i++)
     {
-        vec3 L = vec3(0.0);
-
-        vec3 radiance = vec3(0.0);
-
-        if(lights[i].type == 0)
-        {
-            /*====Directional Light====*/
-
-            L = normalize(-lights[i].direction);
-            radiance = lights[i].color * lights[i].intensity;
-        }
-        else if(lights[i].type == 1)
-        {
-            /*====Point Light====*/
-
-            L = normalize(lights[i].position - VertexInput.WorldPos);
-            float distance = length(lights[i].position - VertexInput.WorldPos);
-            float attenuation = 1.0 / (distance * distance);
-            radiance = lights[i].color * attenuation * lights[i].intensity;
-        }
-        else if(lights[i].type == 2)
-        {
-            /*====Spot Light====*/
-
-        }
-
-        vec3 H = normalize(V + L);
-
-        float NDF = DistributionGGX(N, H, roughness);
-        float G = GeometrySmith(N, V, L, roughness);
-        vec3 F = fresnelSchlick(max(dot(H, V), 0.0), F0);
-
-        vec3 kS = F;
-        vec3 kD = vec3(1.0) - kS;
-        kD *= 1.0 - metallic;
-
-        vec3 numerator = NDF * G * F;
-        float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.0001;
-        vec3 specular = numerator / denominator;
+        Lo += CalculateLight(directionalLights[i], VertexInput.WorldPos, N, V, albedo, metallic, roughness, F0);
+    }
 
-        float NdotL = max(dot(N, L), 0.0);
-        Lo += (kD * albedo / PI + specular) * radiance * NdotL;
+    // Only the point and spot lights that reach the cluster of the fragment
+    uvec2 cluster = clusters[GetClusterIndex(VertexInput.WorldPos)];
+    for(uint i = 0u; i < cluster.y; i++)
+    {
+        Lo += CalculateLight(lights[lightIndices[cluster.x + i]], VertexInput.WorldPos, N, V, albedo, metallic, roughness, F0);
     }
 
     vec3 ambient = vec3(0.03) * albedo * ao;
@@ -0,0 +1,115 @@
+#include "MappedFile.h"
+#include "CoffeeEngine/Core/Log.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Coffee {
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    bool MappedFile::Open(const std::filesystem::path& path)
+    {
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            COFFEE_CORE_ERROR("MappedFile: Could not open {0}", path.string());
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            COFFEE_CORE_ERROR("MappedFile: Could not map {0}", path.string());
+            CloseHandle(file);
+            return false;
+        }
+
+        m_Data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_Data == nullptr)
+        {
+            COFFEE_CORE_ERROR("MappedFile: Could not map {0}", path.string());
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        m_Size = static_cast<size_t>(size.QuadPart);
+        m_FileHandle = file;
+        m_MappingHandle = mapping;
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file == -1)
+        {
+            COFFEE_CORE_ERROR("MappedFile: Could not open {0}", path.string());
+            return false;
+        }
+
+        struct stat fileStat;
+        if (fstat(file, &fileStat) == -1 || fileStat.st_size == 0)
+        {
+            close(file);
+            return false;
+        }
+
+        void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        // The mapping keeps its own reference to the file
+        close(file);
+
+        if (data == MAP_FAILED)
+        {
+            COFFEE_CORE_ERROR("MappedFile: Could not map {0}", path.string());
+            return false;
+        }
+
+        madvise(data, fileStat.st_size, MADV_SEQUENTIAL);
+
+        m_Data = static_cast<const uint8_t*>(data);
+        m_Size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_Data == nullptr)
+            return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(m_Data);
+        CloseHandle(m_MappingHandle);
+        CloseHandle(m_FileHandle);
+        m_FileHandle = nullptr;
+        m_MappingHandle = nullptr;
+#else
+        munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+}
@@ -0,0 +1,70 @@
+/**
+ * @defgroup io IO
+ * @brief IO components of the CoffeeEngine.
+ * @{
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace Coffee {
+
+    /**
+     * @class MappedFile
+     * @brief Read-only memory mapping of a file, the OS pages the contents in on demand.
+     */
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /**
+         * @brief Maps a whole file in memory.
+         * @param path The path of the file.
+         * @return True if the file was mapped.
+         */
+        bool Open(const std::filesystem::path& path);
+
+        /**
+         * @brief Unmaps the file, the pointers returned by GetData are no longer valid.
+         */
+        void Close();
+
+        /**
+         * @brief Gets the contents of the file.
+         * @return A pointer to the first byte of the file, or nullptr if it is not mapped.
+         */
+        const uint8_t* GetData() const { return m_Data; }
+
+        /**
+         * @brief Gets the size of the file.
+         * @return The size of the file in bytes.
+         */
+        size_t GetSize() const { return m_Size; }
+
+        /**
+         * @brief Checks if a file is mapped.
+         * @return True if a file is mapped.
+         */
+        bool IsOpen() const { return m_Data != nullptr; }
+
+    private:
+        const uint8_t* m_Data = nullptr;
+        size_t m_Size = 0;
+
+#ifdef _WIN32
+        void* m_FileHandle = nullptr;
+        void* m_MappingHandle = nullptr;
+#endif
+    };
+
+}
+
+/** @} */
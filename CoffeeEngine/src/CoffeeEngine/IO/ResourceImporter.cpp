@@ -7,6 +7,7 @@
 #include "CoffeeEngine/Renderer/Mesh.h"
 #include "CoffeeEngine/Renderer/Material.h"
 
+#include <cereal/cereal.hpp>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
@@ -101,16 +102,25 @@ namespace Coffee {
 
         if (std::filesystem::exists(cachedFilePath))
         {
-            const Ref<Resource>& resource = LoadFromCache(cachedFilePath, ResourceFormat::Binary);
-            return std::static_pointer_cast<Model>(resource);
+            // A model whose meshes have an outdated cache is imported again from its file, which recreates them
+            try
+            {
+                const Ref<Resource>& resource = LoadFromCache(cachedFilePath, ResourceFormat::Binary);
+                return std::static_pointer_cast<Model>(resource);
+            }
+            catch (const cereal::Exception& e)
+            {
+                COFFEE_WARN("ResourceImporter::ImportModel: Model {0} has an outdated cache ({1}). Creating new model.", path.string(), e.what());
+            }
         }
         else
         {
             COFFEE_WARN("ResourceImporter::ImportModel: Model {0} not found in cache. Creating new model.", path.string());
-            Ref<Model> model = CreateRef<Model>(path);
-            ResourceSaver::SaveToCache(model->GetName(), model);
-            return model;
         }
+
+        Ref<Model> model = CreateRef<Model>(path);
+        ResourceSaver::SaveToCache(model->GetName(), model);
+        return model;
     }
 
     Ref<Mesh> ResourceImporter::ImportMesh(const std::string& name, const UUID& uuid, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Ref<Material>& material, const AABB& aabb)
@@ -123,20 +133,30 @@ namespace Coffee {
 
         if(std::filesystem::exists(cachedFilePath))
         {
-            const Ref<Resource>& resource = LoadFromCache(cachedFilePath, ResourceFormat::Binary);
-            return std::static_pointer_cast<Mesh>(resource);
+            // Meshes cached with another version of the mesh layout can not be read, they are imported again
+            try
+            {
+                const Ref<Resource>& resource = LoadFromCache(cachedFilePath, ResourceFormat::Binary);
+                return std::static_pointer_cast<Mesh>(resource);
+            }
+            catch (const cereal::Exception& e)
+            {
+                COFFEE_WARN("ResourceImporter::ImportMesh: Mesh {0} has an outdated cache ({1}). Creating new mesh.", (uint64_t)uuid, e.what());
+            }
         }
         else
         {
             COFFEE_WARN("ResourceImporter::ImportMesh: Mesh {0} not found in cache. Creating new mesh.", (uint64_t)uuid);
-            Ref<Mesh> mesh = CreateRef<Mesh>(vertices, indices);
-            mesh->SetUUID(uuid);
-            mesh->SetName(name);
-            mesh->SetMaterial(material);
-            mesh->SetAABB(aabb);
-            ResourceSaver::SaveToCache(uuidString, mesh);
-            return mesh;
         }
+
+        Ref<Mesh> mesh = CreateRef<Mesh>(vertices, indices);
+        mesh->SetUUID(uuid);
+        mesh->SetName(name);
+        mesh->SetMaterial(material);
+        mesh->SetAABB(aabb);
+        mesh->GenerateLODs();
+        ResourceSaver::SaveToCache(uuidString, mesh);
+        return mesh;
     }
 
     Ref<Mesh> ResourceImporter::ImportMesh(const UUID& uuid)
@@ -147,8 +167,17 @@ namespace Coffee {
 
         if(std::filesystem::exists(cachedFilePath))
         {
-            const Ref<Resource>& resource = LoadFromCache(cachedFilePath, ResourceFormat::Binary);
-            return std::static_pointer_cast<Mesh>(resource);
+            // Without the source data an outdated mesh can not be created again here, the model that owns it is
+            try
+            {
+                const Ref<Resource>& resource = LoadFromCache(cachedFilePath, ResourceFormat::Binary);
+                return std::static_pointer_cast<Mesh>(resource);
+            }
+            catch (const cereal::Exception& e)
+            {
+                COFFEE_WARN("ResourceImporter::ImportMesh: Mesh {0} has an outdated cache ({1}).", (uint64_t)uuid, e.what());
+                return nullptr;
+            }
         }
         else
         {
@@ -209,6 +209,10 @@ namespace Coffee {
         }
 
         const Ref<Mesh>& mesh = s_Importer.ImportMesh(uuid);
+        if(!mesh)
+        {
+            return nullptr;
+        }
 
         ResourceRegistry::Add(uuid, mesh);
         return mesh;
@@ -5,5 +5,6 @@ namespace Coffee {
 
     std::unordered_map<UUID, Ref<Resource>> ResourceRegistry::m_Resources;
     std::unordered_map<std::string, UUID> ResourceRegistry::m_NameToUUID;
+    std::shared_mutex ResourceRegistry::m_Mutex;
 
 } // namespace Coffee
\ No newline at end of file
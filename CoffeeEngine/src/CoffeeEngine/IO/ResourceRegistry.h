@@ -9,6 +9,8 @@
 #include "CoffeeEngine/Core/Base.h"
 #include "CoffeeEngine/Core/UUID.h"
 #include "CoffeeEngine/IO/Resource.h"
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 
 namespace Coffee {
@@ -18,6 +20,8 @@ namespace Coffee {
     /**
      * @class ResourceRegistry
      * @brief Manages the registration and retrieval of resources.
+     *
+     * The lookups can be done from worker threads (e.g. while loading a scene), the registry is guarded by a reader/writer lock.
      */
     class ResourceRegistry
     {
@@ -29,6 +33,8 @@ namespace Coffee {
          */
         static void Add(UUID uuid, Ref<Resource> resource)
         { 
+            std::unique_lock lock(m_Mutex);
+
             m_Resources[uuid] = resource;
 
             const std::string& name = resource->GetName();
@@ -44,12 +50,15 @@ namespace Coffee {
         template<typename T>
         static Ref<T> Get(UUID uuid)
         {
-            if (!Exists(uuid))
+            std::shared_lock lock(m_Mutex);
+
+            auto it = m_Resources.find(uuid);
+            if (it == m_Resources.end())
             {
                 COFFEE_CORE_ERROR("Resource {0} not found!", (uint64_t)uuid);
                 return nullptr;
             }
-            return std::static_pointer_cast<T>(m_Resources[uuid]);
+            return std::static_pointer_cast<T>(it->second);
         }
 
         /**
@@ -60,12 +69,16 @@ namespace Coffee {
          template<typename T>
         static Ref<T> Get(const std::string& name)
         {
-            if (!Exists(name))
+            std::shared_lock lock(m_Mutex);
+
+            auto it = m_NameToUUID.find(name);
+            auto resource = (it != m_NameToUUID.end()) ? m_Resources.find(it->second) : m_Resources.end();
+            if (resource == m_Resources.end())
             {
                 COFFEE_CORE_ERROR("Resource {0} not found!", name);
                 return nullptr;
             }
-            return std::static_pointer_cast<T>(m_Resources[m_NameToUUID[name]]);
+            return std::static_pointer_cast<T>(resource->second);
         }
 
         /**
@@ -73,21 +86,32 @@ namespace Coffee {
          * @param name The name of the resource.
          * @return True if the resource exists, false otherwise.
          */
-        static bool Exists(UUID uuid) { return m_Resources.find(uuid) != m_Resources.end(); }
+        static bool Exists(UUID uuid)
+        {
+            std::shared_lock lock(m_Mutex);
+            return m_Resources.find(uuid) != m_Resources.end();
+        }
 
         /**
          * @brief Checks if a resource exists in the registry.
          * @param name The name of the resource.
          * @return True if the resource exists, false otherwise.
          */
-        static bool Exists(const std::string& name) { return m_NameToUUID.find(name) != m_NameToUUID.end(); }
+        static bool Exists(const std::string& name)
+        {
+            std::shared_lock lock(m_Mutex);
+            return m_NameToUUID.find(name) != m_NameToUUID.end();
+        }
 
         static void Remove(UUID uuid)
         {
-            if (Exists(uuid))
+            std::unique_lock lock(m_Mutex);
+
+            auto it = m_Resources.find(uuid);
+            if (it != m_Resources.end())
             {
-                m_NameToUUID.erase(m_Resources[uuid]->GetName());
-                m_Resources.erase(uuid);
+                m_NameToUUID.erase(it->second->GetName());
+                m_Resources.erase(it);
             }
         }
 
@@ -96,11 +120,17 @@ namespace Coffee {
          */
         static void Clear() 
         {
+            std::unique_lock lock(m_Mutex);
+
             m_Resources.clear();
             m_NameToUUID.clear();
         }
 
-        static UUID GetUUIDByName(const std::string& name) { return m_NameToUUID[name]; }
+        static UUID GetUUIDByName(const std::string& name)
+        {
+            std::unique_lock lock(m_Mutex);
+            return m_NameToUUID[name];
+        }
 
         /**
          * @brief Gets the entire resource registry.
@@ -111,6 +141,7 @@ namespace Coffee {
     private:
         static std::unordered_map<UUID, Ref<Resource>> m_Resources; ///< The resource registry.
         static std::unordered_map<std::string, UUID> m_NameToUUID; ///< The mapping of resource names to UUIDs.
+        static std::shared_mutex m_Mutex; ///< Guards the maps, lookups take a shared lock.
     };
 
 }
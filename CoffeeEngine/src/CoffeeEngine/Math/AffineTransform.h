@@ -0,0 +1,174 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+
+#if defined(__AVX__)
+    #define COFFEE_AFFINE_TRANSFORM_AVX 1
+    #include <immintrin.h>
+#else
+    #define COFFEE_AFFINE_TRANSFORM_AVX 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define COFFEE_AFFINE_TRANSFORM_SSE 1
+    #include <xmmintrin.h>
+    #include <emmintrin.h>
+#else
+    #define COFFEE_AFFINE_TRANSFORM_SSE 0
+#endif
+
+namespace Coffee {
+
+    /**
+     * @brief Compact affine transformation stored as the first three rows of a 4x4 matrix.
+     *
+     * The last row of an affine matrix is always (0, 0, 0, 1), so it is not stored. Each row is 16 byte aligned
+     * so the composition can be done with SSE without any shuffling of the operands.
+     */
+    struct alignas(16) Affine3x4
+    {
+        glm::vec4 Rows[3] = {
+            {1.0f, 0.0f, 0.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f, 0.0f}
+        }; ///< The rows of the matrix, the fourth column is the translation.
+
+        Affine3x4() = default;
+
+        /**
+         * @brief Builds the transform from a translation, a rotation and a scale (T * R * S).
+         * @param position The translation.
+         * @param orientation The rotation.
+         * @param scale The scale.
+         * @return The affine transform.
+         */
+        static Affine3x4 FromTRS(const glm::vec3& position, const glm::quat& orientation, const glm::vec3& scale)
+        {
+            glm::mat3 rotation = glm::mat3_cast(orientation);
+
+            Affine3x4 result;
+            for (int row = 0; row < 3; row++)
+            {
+                result.Rows[row] = {rotation[0][row] * scale.x, rotation[1][row] * scale.y, rotation[2][row] * scale.z, position[row]};
+            }
+            return result;
+        }
+
+        /**
+         * @brief Converts a 4x4 matrix, the last row is assumed to be (0, 0, 0, 1).
+         * @param matrix The matrix to convert.
+         * @return The affine transform.
+         */
+        static Affine3x4 FromMat4(const glm::mat4& matrix)
+        {
+            Affine3x4 result;
+            for (int row = 0; row < 3; row++)
+            {
+                result.Rows[row] = {matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]};
+            }
+            return result;
+        }
+
+        /**
+         * @brief Expands the transform to a 4x4 matrix.
+         * @return The 4x4 matrix.
+         */
+        glm::mat4 ToMat4() const
+        {
+            return glm::mat4(
+                Rows[0].x, Rows[1].x, Rows[2].x, 0.0f,
+                Rows[0].y, Rows[1].y, Rows[2].y, 0.0f,
+                Rows[0].z, Rows[1].z, Rows[2].z, 0.0f,
+                Rows[0].w, Rows[1].w, Rows[2].w, 1.0f);
+        }
+
+        /**
+         * @brief Composes two transforms (lhs * rhs).
+         * @param lhs The transform applied last (e.g. the parent world transform).
+         * @param rhs The transform applied first (e.g. the local transform).
+         * @param result The composed transform, it can not alias the operands.
+         */
+        static void Multiply(const Affine3x4& lhs, const Affine3x4& rhs, Affine3x4& result)
+        {
+#if COFFEE_AFFINE_TRANSFORM_SSE
+            const __m128 translationMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+            __m128 rhs0 = _mm_load_ps(&rhs.Rows[0].x);
+            __m128 rhs1 = _mm_load_ps(&rhs.Rows[1].x);
+            __m128 rhs2 = _mm_load_ps(&rhs.Rows[2].x);
+
+            for (int row = 0; row < 3; row++)
+            {
+                __m128 l = _mm_load_ps(&lhs.Rows[row].x);
+
+                __m128 r = _mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)), rhs0);
+                r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)), rhs1));
+                r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2)), rhs2));
+                // The implicit last row of rhs only contributes the translation of lhs
+                r = _mm_add_ps(r, _mm_and_ps(l, translationMask));
+
+                _mm_store_ps(&result.Rows[row].x, r);
+            }
+#else
+            for (int row = 0; row < 3; row++)
+            {
+                const glm::vec4& l = lhs.Rows[row];
+                result.Rows[row] = l.x * rhs.Rows[0] + l.y * rhs.Rows[1] + l.z * rhs.Rows[2] + glm::vec4(0.0f, 0.0f, 0.0f, l.w);
+            }
+#endif
+        }
+
+        /**
+         * @brief Composes a batch of transforms (parents[i] * locals[i]).
+         *
+         * With AVX two transforms are composed per iteration: the same row of both transforms shares a 256 bit
+         * register, one per 128 bit lane, so the in-lane broadcasts of Multiply work on both at once. Without AVX each
+         * transform goes through the SSE kernel of Multiply. The operands are passed by pointer because they usually
+         * live scattered in component storage.
+         *
+         * @param parents The transforms applied last.
+         * @param locals The transforms applied first.
+         * @param results The composed transforms, they can not alias the operands.
+         * @param count The number of transforms in the batch.
+         */
+        static void MultiplyBatch(const Affine3x4* const* parents, const Affine3x4* const* locals, Affine3x4* const* results, uint32_t count)
+        {
+            uint32_t i = 0;
+#if COFFEE_AFFINE_TRANSFORM_AVX
+            const __m256 translationMask = _mm256_castsi256_ps(_mm256_set_epi32(-1, 0, 0, 0, -1, 0, 0, 0));
+
+            auto loadRows = [](const Affine3x4& first, const Affine3x4& second, int row) {
+                return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(&first.Rows[row].x)), _mm_load_ps(&second.Rows[row].x), 1);
+            };
+
+            for (; i + 2 <= count; i += 2)
+            {
+                __m256 rhs0 = loadRows(*locals[i], *locals[i + 1], 0);
+                __m256 rhs1 = loadRows(*locals[i], *locals[i + 1], 1);
+                __m256 rhs2 = loadRows(*locals[i], *locals[i + 1], 2);
+
+                for (int row = 0; row < 3; row++)
+                {
+                    __m256 l = loadRows(*parents[i], *parents[i + 1], row);
+
+                    __m256 r = _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(0, 0, 0, 0)), rhs0);
+                    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(1, 1, 1, 1)), rhs1));
+                    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(l, _MM_SHUFFLE(2, 2, 2, 2)), rhs2));
+                    r = _mm256_add_ps(r, _mm256_and_ps(l, translationMask));
+
+                    _mm_store_ps(&results[i]->Rows[row].x, _mm256_castps256_ps128(r));
+                    _mm_store_ps(&results[i + 1]->Rows[row].x, _mm256_extractf128_ps(r, 1));
+                }
+            }
+#endif
+            for (; i < count; i++)
+            {
+                Multiply(*parents[i], *locals[i], *results[i]);
+            }
+        }
+    };
+
+}
@@ -46,41 +46,24 @@ namespace Coffee {
             return min.x < max.x && min.y < max.y && min.z < max.z;
         }
 
+        /**
+         * @brief Calculates the bounds of the box after an affine transformation (Arvo's method).
+         *
+         * The center is transformed as a point and the half size by the absolute value of the rotation and scale
+         * part of the matrix, instead of transforming the 8 corners. The result is the same tight box.
+         * @param transform The affine transformation matrix.
+         * @return The transformed AABB.
+         */
         AABB CalculateTransformedAABB(const glm::mat4& transform) const
         {
-            AABB aabb = *this;
-
-            // Compute the 8 corners of the AABB
-            glm::vec3 corners[8] = {
-                aabb.min,
-                glm::vec3(aabb.min.x, aabb.min.y, aabb.max.z),
-                glm::vec3(aabb.min.x, aabb.max.y, aabb.min.z),
-                glm::vec3(aabb.min.x, aabb.max.y, aabb.max.z),
-                glm::vec3(aabb.max.x, aabb.min.y, aabb.min.z),
-                glm::vec3(aabb.max.x, aabb.min.y, aabb.max.z),
-                glm::vec3(aabb.max.x, aabb.max.y, aabb.min.z),
-                aabb.max
-            };
-
-            // Transform the corners
-            glm::vec3 transformedCorners[8];
-            for (int i = 0; i < 8; ++i) {
-                transformedCorners[i] = glm::vec3(transform * glm::vec4(corners[i], 1.0f));
-            }
-
-            // Find the new min and max points
-            glm::vec3 newMin = transformedCorners[0];
-            glm::vec3 newMax = transformedCorners[0];
-
-            for (int i = 1; i < 8; ++i) {
-                newMin = glm::min(newMin, transformedCorners[i]);
-                newMax = glm::max(newMax, transformedCorners[i]);
-            }
+            glm::vec3 center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
 
-            // Create the transformed AABB
-            AABB transformedAABB(newMin, newMax);
+            glm::mat3 absoluteBasis(glm::abs(glm::vec3(transform[0])),
+                                    glm::abs(glm::vec3(transform[1])),
+                                    glm::abs(glm::vec3(transform[2])));
+            glm::vec3 halfSize = absoluteBasis * GetHalfSize();
 
-            return transformedAABB;
+            return AABB(center - halfSize, center + halfSize);
         }
 
         // Used when the AABB's min and max points are in local space of the object
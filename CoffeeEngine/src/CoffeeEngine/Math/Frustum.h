@@ -26,6 +26,9 @@
 
 #include "CoffeeEngine/Math/BoundingBox.h"
 #include <glm/matrix.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 
 namespace Coffee
 {
@@ -40,9 +43,25 @@ namespace Coffee
         // http://iquilezles.org/www/articles/frustumcorrect/frustumcorrect.htm
         bool Contains(const AABB& aabb) const;
 
+        // Classify a box against the planes set in planeMask (bit i for plane i). The planes the box is fully in front
+        // of are cleared from the mask, so the boxes inside it (e.g. the children of a tree node) only test the planes
+        // it crosses. Inside means the box is in front of all the planes of the original mask
+        IntersectionType Intersect(const AABB& aabb, uint8_t& planeMask) const;
+
+        // Same as Intersect, also measures how far the planes can move before the result changes. For Outside it is the
+        // distance to the plane that rejected the box, whose index is returned in plane (-1 when the box was rejected by
+        // the corners of the frustum). For Inside it is the smallest distance to the planes of the mask. The distances
+        // are in the units of the planes, which are not normalized
+        IntersectionType Intersect(const AABB& aabb, uint8_t& planeMask, float& margin, int& plane) const;
+
+        static constexpr uint8_t AllPlanesMask = 0x3F;
+
         // Get the 8 points of the frustum
         const glm::vec3* GetPoints() const { return m_points; }
 
+        // Get the 6 planes of the frustum (left, right, bottom, top, near, far), the normals point inside
+        const glm::vec4* GetPlanes() const { return m_planes; }
+
     private:
         enum Planes
         {
@@ -142,6 +161,68 @@ namespace Coffee
         return true;
     }
 
+    inline IntersectionType Frustum::Intersect(const AABB& aabb, uint8_t& planeMask) const
+    {
+        float margin;
+        int plane;
+        return Intersect(aabb, planeMask, margin, plane);
+    }
+
+    inline IntersectionType Frustum::Intersect(const AABB& aabb, uint8_t& planeMask, float& margin, int& plane) const
+    {
+        glm::vec3 center = aabb.GetCenter();
+        glm::vec3 halfSize = aabb.GetHalfSize();
+
+        margin = std::numeric_limits<float>::max();
+        plane = -1;
+
+        for (int i = 0; i < Count; i++)
+        {
+            if (!(planeMask & (1 << i)))
+                continue;
+
+            // Signed distance of the center and projected radius of the box, the planes are not normalized
+            glm::vec3 normal = glm::vec3(m_planes[i]);
+            float distance = glm::dot(normal, center) + m_planes[i].w;
+            float radius = glm::dot(glm::abs(normal), halfSize);
+
+            if (distance + radius < 0.0f)
+            {
+                margin = -(distance + radius);
+                plane = i;
+                return IntersectionType::Outside;
+            }
+
+            if (distance - radius >= 0.0f)
+            {
+                planeMask &= ~(1 << i);
+                margin = std::min(margin, distance - radius);
+            }
+        }
+
+        if (planeMask == 0)
+            return IntersectionType::Inside;
+
+        // Same as Contains, a box crossing the planes can still be outside near the edges of the frustum
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int above = 0, below = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                above += (m_points[i][axis] > aabb.max[axis]) ? 1 : 0;
+                below += (m_points[i][axis] < aabb.min[axis]) ? 1 : 0;
+            }
+
+            if (above == 8 || below == 8)
+            {
+                margin = 0.0f;
+                return IntersectionType::Outside;
+            }
+        }
+
+        return IntersectionType::Intersect;
+    }
+
     template<Frustum::Planes a, Frustum::Planes b, Frustum::Planes c>
     inline glm::vec3 Frustum::intersection(const glm::vec3* crosses) const
     {
@@ -0,0 +1,170 @@
+#include "FrustumCulling.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <tracy/Tracy.hpp>
+
+#if defined(__AVX__)
+    #define COFFEE_FRUSTUM_CULLING_AVX 1
+    #include <immintrin.h>
+#else
+    #define COFFEE_FRUSTUM_CULLING_AVX 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define COFFEE_FRUSTUM_CULLING_SSE 1
+    #include <xmmintrin.h>
+#else
+    #define COFFEE_FRUSTUM_CULLING_SSE 0
+#endif
+
+namespace Coffee {
+
+    namespace
+    {
+#if COFFEE_FRUSTUM_CULLING_AVX
+        constexpr size_t s_BatchWidth = 8;
+
+        // Returns one bit per box of the batch, set when the box is behind one of the planes
+        inline uint32_t CullBatch(const FrustumPlanes& planes, uint8_t planeMask, const float* cx, const float* cy, const float* cz,
+                                  const float* ex, const float* ey, const float* ez)
+        {
+            __m256 centerX = _mm256_loadu_ps(cx);
+            __m256 centerY = _mm256_loadu_ps(cy);
+            __m256 centerZ = _mm256_loadu_ps(cz);
+            __m256 extentX = _mm256_loadu_ps(ex);
+            __m256 extentY = _mm256_loadu_ps(ey);
+            __m256 extentZ = _mm256_loadu_ps(ez);
+
+            __m256 outside = _mm256_setzero_ps();
+            for (uint32_t mask = planeMask; mask != 0; mask &= mask - 1)
+            {
+                int i = std::countr_zero(mask);
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(planes.NormalX[i])),
+                                                              _mm256_mul_ps(centerY, _mm256_set1_ps(planes.NormalY[i]))),
+                                                _mm256_add_ps(_mm256_mul_ps(centerZ, _mm256_set1_ps(planes.NormalZ[i])),
+                                                              _mm256_set1_ps(planes.Distance[i])));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extentX, _mm256_set1_ps(std::abs(planes.NormalX[i]))),
+                                                            _mm256_mul_ps(extentY, _mm256_set1_ps(std::abs(planes.NormalY[i])))),
+                                              _mm256_mul_ps(extentZ, _mm256_set1_ps(std::abs(planes.NormalZ[i]))));
+
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+
+            return static_cast<uint32_t>(_mm256_movemask_ps(outside));
+        }
+#elif COFFEE_FRUSTUM_CULLING_SSE
+        constexpr size_t s_BatchWidth = 4;
+
+        // Returns one bit per box of the batch, set when the box is behind one of the planes
+        inline uint32_t CullBatch(const FrustumPlanes& planes, uint8_t planeMask, const float* cx, const float* cy, const float* cz,
+                                  const float* ex, const float* ey, const float* ez)
+        {
+            __m128 centerX = _mm_loadu_ps(cx);
+            __m128 centerY = _mm_loadu_ps(cy);
+            __m128 centerZ = _mm_loadu_ps(cz);
+            __m128 extentX = _mm_loadu_ps(ex);
+            __m128 extentY = _mm_loadu_ps(ey);
+            __m128 extentZ = _mm_loadu_ps(ez);
+
+            __m128 outside = _mm_setzero_ps();
+            for (uint32_t mask = planeMask; mask != 0; mask &= mask - 1)
+            {
+                int i = std::countr_zero(mask);
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(planes.NormalX[i])),
+                                                        _mm_mul_ps(centerY, _mm_set1_ps(planes.NormalY[i]))),
+                                             _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(planes.NormalZ[i])),
+                                                        _mm_set1_ps(planes.Distance[i])));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(std::abs(planes.NormalX[i]))),
+                                                      _mm_mul_ps(extentY, _mm_set1_ps(std::abs(planes.NormalY[i])))),
+                                           _mm_mul_ps(extentZ, _mm_set1_ps(std::abs(planes.NormalZ[i]))));
+
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+
+            return static_cast<uint32_t>(_mm_movemask_ps(outside));
+        }
+#else
+        constexpr size_t s_BatchWidth = 4;
+
+        // Returns one bit per box of the batch, set when the box is behind one of the planes
+        inline uint32_t CullBatch(const FrustumPlanes& planes, uint8_t planeMask, const float* cx, const float* cy, const float* cz,
+                                  const float* ex, const float* ey, const float* ez)
+        {
+            uint32_t outside = 0;
+            for (size_t box = 0; box < s_BatchWidth; box++)
+            {
+                for (uint32_t mask = planeMask; mask != 0; mask &= mask - 1)
+                {
+                    int i = std::countr_zero(mask);
+                    float distance = cx[box] * planes.NormalX[i] + cy[box] * planes.NormalY[i] + cz[box] * planes.NormalZ[i] + planes.Distance[i];
+                    float radius = ex[box] * std::abs(planes.NormalX[i]) + ey[box] * std::abs(planes.NormalY[i]) + ez[box] * std::abs(planes.NormalZ[i]);
+                    if (distance + radius < 0.0f)
+                    {
+                        outside |= 1u << box;
+                        break;
+                    }
+                }
+            }
+            return outside;
+        }
+#endif
+
+        inline void WriteBatch(uint32_t outside, size_t count, uint8_t* visible)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                visible[i] = ((outside >> i) & 1) ? 0 : 1;
+            }
+        }
+    }
+
+    void CullAABBs(const FrustumPlanes& planes, const AABBSoA& boxes, size_t first, size_t count, uint8_t* visible, uint8_t planeMask)
+    {
+        ZoneScoped;
+
+        // The padding of the arrays covers the loads of the last batch
+        for (size_t i = 0; i < count; i += s_BatchWidth)
+        {
+            size_t index = first + i;
+            uint32_t outside = CullBatch(planes, planeMask, boxes.GetCenterX() + index, boxes.GetCenterY() + index, boxes.GetCenterZ() + index,
+                                         boxes.GetExtentX() + index, boxes.GetExtentY() + index, boxes.GetExtentZ() + index);
+
+            WriteBatch(outside, std::min(s_BatchWidth, count - i), visible + i);
+        }
+    }
+
+    void CullAABBs(const FrustumPlanes& planes, const AABB* boxes, size_t count, size_t stride, uint8_t* visible, uint8_t planeMask)
+    {
+        ZoneScoped;
+
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(boxes);
+
+        alignas(32) float cx[s_BatchWidth], cy[s_BatchWidth], cz[s_BatchWidth];
+        alignas(32) float ex[s_BatchWidth], ey[s_BatchWidth], ez[s_BatchWidth];
+
+        for (size_t i = 0; i < count; i += s_BatchWidth)
+        {
+            size_t batchSize = std::min(s_BatchWidth, count - i);
+
+            for (size_t j = 0; j < s_BatchWidth; j++)
+            {
+                if (j >= batchSize)
+                {
+                    cx[j] = cy[j] = cz[j] = ex[j] = ey[j] = ez[j] = 0.0f;
+                    continue;
+                }
+
+                const AABB& box = *reinterpret_cast<const AABB*>(data + (i + j) * stride);
+                glm::vec3 center = box.GetCenter();
+                glm::vec3 extent = box.GetHalfSize();
+                cx[j] = center.x; cy[j] = center.y; cz[j] = center.z;
+                ex[j] = extent.x; ey[j] = extent.y; ez[j] = extent.z;
+            }
+
+            WriteBatch(CullBatch(planes, planeMask, cx, cy, cz, ex, ey, ez), batchSize, visible + i);
+        }
+    }
+
+}
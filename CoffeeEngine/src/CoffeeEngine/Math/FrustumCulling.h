@@ -0,0 +1,140 @@
+#pragma once
+
+#include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Math/Frustum.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @brief The planes of a frustum split by component, so each one can be broadcast to a SIMD register.
+     */
+    struct FrustumPlanes
+    {
+        static constexpr int Count = 6;
+
+        float NormalX[Count] = {};
+        float NormalY[Count] = {};
+        float NormalZ[Count] = {};
+        float Distance[Count] = {};
+
+        FrustumPlanes() = default;
+
+        /**
+         * @brief Extracts the planes of a frustum.
+         * @param frustum The frustum.
+         */
+        explicit FrustumPlanes(const Frustum& frustum)
+        {
+            const glm::vec4* planes = frustum.GetPlanes();
+            for (int i = 0; i < Count; i++)
+            {
+                NormalX[i] = planes[i].x;
+                NormalY[i] = planes[i].y;
+                NormalZ[i] = planes[i].z;
+                Distance[i] = planes[i].w;
+            }
+        }
+    };
+
+    /**
+     * @brief Boxes stored as a structure of arrays of centers and half extents, the layout of the culling kernel.
+     *
+     * The arrays are padded past the last box so the kernel can always load full batches.
+     */
+    class AABBSoA
+    {
+    public:
+        void Clear() { Resize(0); }
+
+        void Reserve(size_t count)
+        {
+            for (std::vector<float>* component : GetComponents())
+                component->reserve(count + s_Padding);
+        }
+
+        void Resize(size_t count)
+        {
+            m_Size = count;
+            for (std::vector<float>* component : GetComponents())
+                component->resize(count + s_Padding, 0.0f);
+        }
+
+        void Add(const AABB& aabb)
+        {
+            Resize(m_Size + 1);
+            Set(m_Size - 1, aabb);
+        }
+
+        void Set(size_t index, const AABB& aabb)
+        {
+            glm::vec3 center = aabb.GetCenter();
+            glm::vec3 extent = aabb.GetHalfSize();
+            m_CenterX[index] = center.x;
+            m_CenterY[index] = center.y;
+            m_CenterZ[index] = center.z;
+            m_ExtentX[index] = extent.x;
+            m_ExtentY[index] = extent.y;
+            m_ExtentZ[index] = extent.z;
+        }
+
+        size_t Size() const { return m_Size; }
+
+        const float* GetCenterX() const { return m_CenterX.data(); }
+        const float* GetCenterY() const { return m_CenterY.data(); }
+        const float* GetCenterZ() const { return m_CenterZ.data(); }
+        const float* GetExtentX() const { return m_ExtentX.data(); }
+        const float* GetExtentY() const { return m_ExtentY.data(); }
+        const float* GetExtentZ() const { return m_ExtentZ.data(); }
+
+    private:
+        std::array<std::vector<float>*, 6> GetComponents()
+        {
+            return {&m_CenterX, &m_CenterY, &m_CenterZ, &m_ExtentX, &m_ExtentY, &m_ExtentZ};
+        }
+
+    private:
+        std::vector<float> m_CenterX, m_CenterY, m_CenterZ;
+        std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+        size_t m_Size = 0;
+
+        static constexpr size_t s_Padding = 8; ///< The widest batch of the kernel.
+    };
+
+    /**
+     * @brief Tests a range of boxes against the planes of a frustum, 8 (AVX) or 4 (SSE) boxes per iteration.
+     *
+     * A box is culled when it is fully behind one of the planes, which is checked with its p-vertex: the center
+     * distance plus the extents projected on the plane normal. This matches the plane pass of Frustum::Contains but
+     * skips its corner pass, so a few boxes near the frustum edges are kept. It never culls a visible box.
+     *
+     * Only the planes set in planeMask are tested. The spatial indices pass the planes their node crosses: the boxes
+     * inside the node are in front of the other planes already.
+     *
+     * @param planes The frustum planes.
+     * @param boxes The boxes.
+     * @param first The first box of the range.
+     * @param count The number of boxes of the range.
+     * @param visible Output, one value per box of the range, 1 if the box may be visible and 0 if it is culled.
+     * @param planeMask The planes to test, bit i for plane i.
+     */
+    void CullAABBs(const FrustumPlanes& planes, const AABBSoA& boxes, size_t first, size_t count, uint8_t* visible,
+                   uint8_t planeMask = Frustum::AllPlanesMask);
+
+    /**
+     * @brief Tests boxes stored as an array of structures, they are transposed batch by batch for the kernel.
+     * @param planes The frustum planes.
+     * @param boxes The first box.
+     * @param count The number of boxes.
+     * @param stride The distance in bytes between two boxes, to read them straight from larger structures.
+     * @param visible Output, one value per box, 1 if the box may be visible and 0 if it is culled.
+     * @param planeMask The planes to test, bit i for plane i.
+     */
+    void CullAABBs(const FrustumPlanes& planes, const AABB* boxes, size_t count, size_t stride, uint8_t* visible,
+                   uint8_t planeMask = Frustum::AllPlanesMask);
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @brief Spreads the lower 10 bits of a value, leaving two zero bits between each of them.
+     * @param value The value to spread.
+     * @return The spread bits.
+     */
+    inline uint32_t MortonExpandBits(uint32_t value)
+    {
+        value &= 0x000003FFu;
+        value = (value * 0x00010001u) & 0xFF0000FFu;
+        value = (value * 0x00000101u) & 0x0F00F00Fu;
+        value = (value * 0x00000011u) & 0xC30C30C3u;
+        value = (value * 0x00000005u) & 0x49249249u;
+        return value;
+    }
+
+    /**
+     * @brief Interleaves three 10 bit coordinates into a 30 bit Morton code.
+     *
+     * The x coordinate takes the lowest bit of each group of three, so the group at each level is the octant index
+     * used by the octrees (x = 1, y = 2, z = 4).
+     *
+     * @param x The x coordinate.
+     * @param y The y coordinate.
+     * @param z The z coordinate.
+     * @return The Morton code.
+     */
+    inline uint32_t MortonEncode(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return MortonExpandBits(x) | (MortonExpandBits(y) << 1) | (MortonExpandBits(z) << 2);
+    }
+
+    /**
+     * @brief Sorts Morton codes with a least significant digit radix sort, 8 bits per pass.
+     *
+     * The sort is stable, the keys with the same code keep their order.
+     *
+     * @param keys Pairs of a code and a value, usually the index of the object the code was calculated for.
+     */
+    inline void RadixSortMortonCodes(std::vector<std::pair<uint32_t, uint32_t>>& keys)
+    {
+        if (keys.size() < 2)
+            return;
+
+        std::vector<std::pair<uint32_t, uint32_t>> buffer(keys.size());
+
+        for (uint32_t shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t offsets[257] = {};
+            for (const auto& key : keys)
+            {
+                offsets[((key.first >> shift) & 0xFF) + 1]++;
+            }
+
+            // All the codes have the same digit, the pass would not move anything
+            if (offsets[((keys[0].first >> shift) & 0xFF) + 1] == keys.size())
+                continue;
+
+            for (uint32_t digit = 1; digit < 257; digit++)
+            {
+                offsets[digit] += offsets[digit - 1];
+            }
+
+            for (const auto& key : keys)
+            {
+                buffer[offsets[(key.first >> shift) & 0xFF]++] = key;
+            }
+
+            keys.swap(buffer);
+        }
+    }
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "CoffeeEngine/Math/BoundingBox.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace Coffee {
+
+    /**
+     * @brief Structure representing a ray, used for picking and scene queries.
+     */
+    struct Ray {
+
+        glm::vec3 Origin = glm::vec3(0.0f); ///< The origin of the ray.
+        glm::vec3 Direction = glm::vec3(0.0f, 0.0f, -1.0f); ///< The direction of the ray, the distances are measured in its length.
+        glm::vec3 InverseDirection = glm::vec3(0.0f, 0.0f, -1.0f); ///< The inverse of each direction component, for the slab test.
+
+        Ray() = default;
+
+        /**
+         * @brief Constructs a ray.
+         * @param origin The origin of the ray.
+         * @param direction The direction of the ray, it is not normalized.
+         */
+        Ray(const glm::vec3& origin, const glm::vec3& direction)
+            : Origin(origin), Direction(direction), InverseDirection(1.0f / direction) {}
+
+        /**
+         * @brief Transforms the ray, the distances along the ray are kept.
+         * @param transform The transformation matrix.
+         * @return The transformed ray.
+         */
+        Ray Transform(const glm::mat4& transform) const
+        {
+            return Ray(glm::vec3(transform * glm::vec4(Origin, 1.0f)), glm::vec3(transform * glm::vec4(Direction, 0.0f)));
+        }
+
+        /**
+         * @brief Gets a point along the ray.
+         * @param distance The distance from the origin.
+         * @return The point.
+         */
+        glm::vec3 GetPoint(float distance) const { return Origin + Direction * distance; }
+
+        /**
+         * @brief Intersects the ray with an AABB (slab test).
+         * @param aabb The AABB.
+         * @param maxDistance Hits further than this distance are ignored.
+         * @param distance The distance to the entry point, 0 if the origin is inside.
+         * @return True if the ray hits the AABB.
+         */
+        bool IntersectAABB(const AABB& aabb, float maxDistance, float& distance) const
+        {
+            glm::vec3 t0 = (aabb.min - Origin) * InverseDirection;
+            glm::vec3 t1 = (aabb.max - Origin) * InverseDirection;
+
+            glm::vec3 tMin = glm::min(t0, t1);
+            glm::vec3 tMax = glm::max(t0, t1);
+
+            float entry = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+            float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+
+            distance = entry;
+            return entry <= exit;
+        }
+
+        /**
+         * @brief Intersects the ray with a triangle (Moller-Trumbore), both faces are hit.
+         * @param v0 The first vertex.
+         * @param v1 The second vertex.
+         * @param v2 The third vertex.
+         * @param distance The distance to the hit point.
+         * @return True if the ray hits the triangle in front of its origin.
+         */
+        bool IntersectTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& distance) const
+        {
+            constexpr float epsilon = 1e-8f;
+
+            glm::vec3 edge1 = v1 - v0;
+            glm::vec3 edge2 = v2 - v0;
+
+            glm::vec3 p = glm::cross(Direction, edge2);
+            float determinant = glm::dot(edge1, p);
+
+            if (std::abs(determinant) < epsilon)
+                return false;
+
+            float inverseDeterminant = 1.0f / determinant;
+
+            glm::vec3 s = Origin - v0;
+            float u = glm::dot(s, p) * inverseDeterminant;
+            if (u < 0.0f || u > 1.0f)
+                return false;
+
+            glm::vec3 q = glm::cross(s, edge1);
+            float v = glm::dot(Direction, q) * inverseDeterminant;
+            if (v < 0.0f || u + v > 1.0f)
+                return false;
+
+            distance = glm::dot(edge2, q) * inverseDeterminant;
+            return distance > 0.0f;
+        }
+    };
+
+}
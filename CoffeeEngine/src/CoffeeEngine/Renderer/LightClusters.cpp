@@ -0,0 +1,297 @@
+#include "LightClusters.h"
+#include "CoffeeEngine/Core/JobSystem.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <tracy/Tracy.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define COFFEE_LIGHT_CLUSTERS_SSE 1
+    #include <xmmintrin.h>
+#else
+    #define COFFEE_LIGHT_CLUSTERS_SSE 0
+#endif
+
+namespace Coffee {
+
+    namespace
+    {
+        constexpr uint32_t s_SimdWidth = 4;
+        constexpr float s_FallbackRange = 1000.0f; ///< Depth covered by the clusters when the far plane is at infinity.
+
+        // Returns one bit per box of the group, set when the sphere touches the box
+        inline uint32_t SphereOverlapsBoxes(const glm::vec3& center, float radius, const float* minX, const float* minY,
+                                            const float* minZ, const float* maxX, const float* maxY, const float* maxZ)
+        {
+#if COFFEE_LIGHT_CLUSTERS_SSE
+            __m128 zero = _mm_setzero_ps();
+            __m128 centerX = _mm_set1_ps(center.x);
+            __m128 centerY = _mm_set1_ps(center.y);
+            __m128 centerZ = _mm_set1_ps(center.z);
+
+            // The distance to the box along each axis, zero when the center is between the faces
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX), centerX), _mm_sub_ps(centerX, _mm_loadu_ps(maxX))), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY), centerY), _mm_sub_ps(centerY, _mm_loadu_ps(maxY))), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minZ), centerZ), _mm_sub_ps(centerZ, _mm_loadu_ps(maxZ))), zero);
+
+            __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_set1_ps(radius * radius))));
+#else
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < s_SimdWidth; i++)
+            {
+                float dx = std::max(std::max(minX[i] - center.x, center.x - maxX[i]), 0.0f);
+                float dy = std::max(std::max(minY[i] - center.y, center.y - maxY[i]), 0.0f);
+                float dz = std::max(std::max(minZ[i] - center.z, center.z - maxZ[i]), 0.0f);
+                if (dx * dx + dy * dy + dz * dz <= radius * radius)
+                {
+                    mask |= 1u << i;
+                }
+            }
+            return mask;
+#endif
+        }
+
+        // Conservative cone against sphere test, the sphere is culled only when it is fully outside the cone
+        inline bool IsSphereOutsideCone(const glm::vec4& sphere, const glm::vec3& apex, const glm::vec3& direction,
+                                        float cosAngle, float sinAngle, float range)
+        {
+            glm::vec3 offset = glm::vec3(sphere) - apex;
+            float lengthSquared = glm::dot(offset, offset);
+            float alongAxis = glm::dot(offset, direction);
+            float distanceToCone = cosAngle * std::sqrt(std::max(lengthSquared - alongAxis * alongAxis, 0.0f)) - alongAxis * sinAngle;
+
+            return distanceToCone > sphere.w || alongAxis > sphere.w + range || alongAxis < -sphere.w;
+        }
+
+        // Unprojects a point from normalized device coordinates to view space
+        inline glm::vec3 Unproject(const glm::mat4& inverseProjection, float x, float y, float z)
+        {
+            glm::vec4 point = inverseProjection * glm::vec4(x, y, z, 1.0f);
+            return glm::vec3(point) / point.w;
+        }
+    }
+
+    LightClusters::LightClusters(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
+    {
+        SetGridSize(sizeX, sizeY, sizeZ);
+    }
+
+    void LightClusters::SetGridSize(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ)
+    {
+        m_GridSize = glm::uvec3(std::max(sizeX, 1u), std::max(sizeY, 1u), std::max(sizeZ, 1u));
+        m_TileCount = m_GridSize.x * m_GridSize.y;
+        m_TileStride = (m_TileCount + s_SimdWidth - 1) / s_SimdWidth * s_SimdWidth;
+
+        m_ClusterLights.resize(m_TileCount * m_GridSize.z);
+        m_Clusters.assign(m_TileCount * m_GridSize.z, glm::uvec2(0));
+
+        // Forces the bounds to be recalculated
+        m_Projection = glm::mat4(0.0f);
+    }
+
+    void LightClusters::Build(const std::vector<LightComponent>& lights, const glm::mat4& view, const glm::mat4& projection)
+    {
+        ZoneScoped;
+
+        if (std::memcmp(&projection, &m_Projection, sizeof(glm::mat4)) != 0)
+        {
+            UpdateClusterBounds(projection);
+        }
+
+        // The lights are moved to view space once, and each one gets the range of slices its sphere crosses
+        m_Lights.clear();
+        for (uint32_t i = 0; i < lights.size(); i++)
+        {
+            const LightComponent& light = lights[i];
+            if (light.type != LightComponent::Type::PointLight && light.type != LightComponent::Type::SpotLight)
+                continue;
+
+            ClusterLight clusterLight;
+            clusterLight.Center = glm::vec3(view * glm::vec4(light.Position, 1.0f));
+            clusterLight.Radius = light.Range;
+            clusterLight.Index = i;
+
+            float depth = -clusterLight.Center.z;
+            if (light.Range <= 0.0f || depth + light.Range < m_Near || depth - light.Range > m_Far)
+                continue;
+
+            clusterLight.FirstSlice = GetSlice(depth - light.Range);
+            clusterLight.LastSlice = GetSlice(depth + light.Range);
+
+            // A cone of 90 degrees or more is not narrower than its sphere
+            float angle = glm::radians(light.Angle);
+            clusterLight.IsSpot = light.type == LightComponent::Type::SpotLight && angle < glm::radians(90.0f);
+            if (clusterLight.IsSpot)
+            {
+                clusterLight.Direction = glm::normalize(glm::vec3(view * glm::vec4(light.Direction, 0.0f)));
+                clusterLight.CosAngle = std::cos(angle);
+                clusterLight.SinAngle = std::sin(angle);
+            }
+
+            m_Lights.push_back(clusterLight);
+        }
+
+        // Every slice owns its clusters, so the jobs never write the same list
+        JobSystem::ParallelFor(m_GridSize.z, 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t slice = begin; slice < end; slice++)
+            {
+                FillSlice(slice);
+            }
+        });
+
+        m_LightIndices.clear();
+        m_MaxClusterLightCount = 0;
+        m_DroppedLightCount = 0;
+        for (size_t i = 0; i < m_ClusterLights.size(); i++)
+        {
+            const std::vector<uint32_t>& clusterLights = m_ClusterLights[i];
+            uint32_t count = std::min(static_cast<uint32_t>(clusterLights.size()), MaxLightsPerCluster);
+
+            m_Clusters[i] = glm::uvec2(static_cast<uint32_t>(m_LightIndices.size()), count);
+            m_LightIndices.insert(m_LightIndices.end(), clusterLights.begin(), clusterLights.begin() + count);
+
+            m_MaxClusterLightCount = std::max(m_MaxClusterLightCount, count);
+            m_DroppedLightCount += static_cast<uint32_t>(clusterLights.size()) - count;
+        }
+    }
+
+    void LightClusters::UpdateClusterBounds(const glm::mat4& projection)
+    {
+        ZoneScoped;
+
+        m_Projection = projection;
+        glm::mat4 inverseProjection = glm::inverse(projection);
+
+        m_Near = -Unproject(inverseProjection, 0.0f, 0.0f, -1.0f).z;
+        m_Far = -Unproject(inverseProjection, 0.0f, 0.0f, 1.0f).z;
+        if (!std::isfinite(m_Far) || m_Far <= m_Near)
+        {
+            m_Far = m_Near + s_FallbackRange;
+        }
+
+        // Logarithmic slices keep the clusters close to cubes, they need a near plane in front of the camera
+        float sliceCount = static_cast<float>(m_GridSize.z);
+        m_IsLogarithmic = m_Near > 0.0f;
+        if (m_IsLogarithmic)
+        {
+            float scale = sliceCount / std::log(m_Far / m_Near);
+            m_DepthScaleBias = glm::vec2(scale, -std::log(m_Near) * scale);
+        }
+        else
+        {
+            float scale = sliceCount / (m_Far - m_Near);
+            m_DepthScaleBias = glm::vec2(scale, -m_Near * scale);
+        }
+
+        std::vector<float> sliceDepths(m_GridSize.z + 1);
+        for (uint32_t slice = 0; slice <= m_GridSize.z; slice++)
+        {
+            float t = static_cast<float>(slice) / sliceCount;
+            sliceDepths[slice] = m_IsLogarithmic ? m_Near * std::pow(m_Far / m_Near, t) : m_Near + (m_Far - m_Near) * t;
+        }
+
+        // The padding boxes are empty, no sphere touches them
+        size_t boundsSize = static_cast<size_t>(m_TileStride) * m_GridSize.z;
+        m_MinX.assign(boundsSize, std::numeric_limits<float>::max());
+        m_MinY.assign(boundsSize, std::numeric_limits<float>::max());
+        m_MinZ.assign(boundsSize, std::numeric_limits<float>::max());
+        m_MaxX.assign(boundsSize, -std::numeric_limits<float>::max());
+        m_MaxY.assign(boundsSize, -std::numeric_limits<float>::max());
+        m_MaxZ.assign(boundsSize, -std::numeric_limits<float>::max());
+        m_BoundingSpheres.resize(static_cast<size_t>(m_TileCount) * m_GridSize.z);
+
+        for (uint32_t y = 0; y < m_GridSize.y; y++)
+        {
+            for (uint32_t x = 0; x < m_GridSize.x; x++)
+            {
+                // The edges of the tile, as lines from the near plane to the middle of the depth range
+                glm::vec3 nearCorners[4];
+                glm::vec3 farCorners[4];
+                for (int corner = 0; corner < 4; corner++)
+                {
+                    float ndcX = -1.0f + 2.0f * static_cast<float>(x + (corner & 1)) / static_cast<float>(m_GridSize.x);
+                    float ndcY = -1.0f + 2.0f * static_cast<float>(y + (corner >> 1)) / static_cast<float>(m_GridSize.y);
+                    nearCorners[corner] = Unproject(inverseProjection, ndcX, ndcY, -1.0f);
+                    farCorners[corner] = Unproject(inverseProjection, ndcX, ndcY, 0.0f);
+                }
+
+                uint32_t tile = x + y * m_GridSize.x;
+                for (uint32_t slice = 0; slice < m_GridSize.z; slice++)
+                {
+                    glm::vec3 min(std::numeric_limits<float>::max());
+                    glm::vec3 max(-std::numeric_limits<float>::max());
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        glm::vec3 edge = farCorners[corner] - nearCorners[corner];
+                        for (uint32_t side = 0; side < 2; side++)
+                        {
+                            float t = (-sliceDepths[slice + side] - nearCorners[corner].z) / edge.z;
+                            glm::vec3 point = nearCorners[corner] + edge * t;
+                            min = glm::min(min, point);
+                            max = glm::max(max, point);
+                        }
+                    }
+
+                    size_t index = static_cast<size_t>(slice) * m_TileStride + tile;
+                    m_MinX[index] = min.x;
+                    m_MinY[index] = min.y;
+                    m_MinZ[index] = min.z;
+                    m_MaxX[index] = max.x;
+                    m_MaxY[index] = max.y;
+                    m_MaxZ[index] = max.z;
+
+                    glm::vec3 center = (min + max) * 0.5f;
+                    m_BoundingSpheres[static_cast<size_t>(slice) * m_TileCount + tile] = glm::vec4(center, glm::length(max - center));
+                }
+            }
+        }
+    }
+
+    uint32_t LightClusters::GetSlice(float depth) const
+    {
+        float slice = m_IsLogarithmic ? std::log(std::max(depth, m_Near)) * m_DepthScaleBias.x + m_DepthScaleBias.y
+                                      : depth * m_DepthScaleBias.x + m_DepthScaleBias.y;
+
+        return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(m_GridSize.z - 1)));
+    }
+
+    void LightClusters::FillSlice(uint32_t slice)
+    {
+        ZoneScoped;
+
+        size_t firstCluster = static_cast<size_t>(slice) * m_TileCount;
+        for (uint32_t tile = 0; tile < m_TileCount; tile++)
+        {
+            m_ClusterLights[firstCluster + tile].clear();
+        }
+
+        size_t firstBounds = static_cast<size_t>(slice) * m_TileStride;
+        for (const ClusterLight& light : m_Lights)
+        {
+            if (slice < light.FirstSlice || slice > light.LastSlice)
+                continue;
+
+            for (uint32_t group = 0; group < m_TileStride; group += s_SimdWidth)
+            {
+                size_t bounds = firstBounds + group;
+                uint32_t mask = SphereOverlapsBoxes(light.Center, light.Radius, &m_MinX[bounds], &m_MinY[bounds], &m_MinZ[bounds],
+                                                    &m_MaxX[bounds], &m_MaxY[bounds], &m_MaxZ[bounds]);
+                while (mask)
+                {
+                    uint32_t tile = group + static_cast<uint32_t>(std::countr_zero(mask));
+                    mask &= mask - 1;
+
+                    if (light.IsSpot && IsSphereOutsideCone(m_BoundingSpheres[firstCluster + tile], light.Center, light.Direction,
+                                                            light.CosAngle, light.SinAngle, light.Radius))
+                        continue;
+
+                    m_ClusterLights[firstCluster + tile].push_back(light.Index);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "CoffeeEngine/Scene/Components.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @defgroup renderer Renderer
+     * @{
+     */
+
+    /**
+     * @brief Assigns the point and spot lights to the clusters of the view frustum, for clustered forward shading.
+     *
+     * The frustum is split in screen tiles and depth slices, logarithmic for perspective cameras. Each frame the
+     * lights are moved to view space and every depth slice is filled by its own JobSystem job, testing the light
+     * spheres against four cluster bounds at a time with SSE. Spot lights are also tested against the cone. The
+     * result is one compact list of light indices, and the offset and count of each cluster in it, so a fragment
+     * only loops over the lights of its cluster.
+     */
+    class LightClusters
+    {
+    public:
+        /**
+         * @brief Constructs the cluster grid.
+         * @param sizeX The number of clusters along the width of the screen.
+         * @param sizeY The number of clusters along the height of the screen.
+         * @param sizeZ The number of depth slices.
+         */
+        LightClusters(uint32_t sizeX = 16, uint32_t sizeY = 9, uint32_t sizeZ = 24);
+
+        /**
+         * @brief Changes the number of clusters, the bounds are recalculated on the next build.
+         * @param sizeX The number of clusters along the width of the screen.
+         * @param sizeY The number of clusters along the height of the screen.
+         * @param sizeZ The number of depth slices.
+         */
+        void SetGridSize(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ);
+
+        /**
+         * @brief Assigns the lights to the clusters.
+         * @param lights The lights, the directional ones are skipped since they reach every cluster.
+         * @param view The view matrix of the camera.
+         * @param projection The projection matrix of the camera (OpenGL clip space).
+         */
+        void Build(const std::vector<LightComponent>& lights, const glm::mat4& view, const glm::mat4& projection);
+
+        /**
+         * @brief Gets the light list of every cluster, indexed by x + y * sizeX + z * sizeX * sizeY.
+         * @return The offset of the list of each cluster in the light indices (x) and its size (y).
+         */
+        const std::vector<glm::uvec2>& GetClusters() const { return m_Clusters; }
+
+        /**
+         * @brief Gets the light lists of all the clusters, one after another.
+         * @return The indices of the lights passed to Build.
+         */
+        const std::vector<uint32_t>& GetLightIndices() const { return m_LightIndices; }
+
+        const glm::uvec3& GetGridSize() const { return m_GridSize; }
+
+        /**
+         * @brief Checks if the depth slices grow exponentially with the distance.
+         * @return True for a camera with a positive near plane, the slice of a view depth d is log(d) * scale + bias.
+         * False otherwise, the slice is d * scale + bias.
+         */
+        bool IsLogarithmic() const { return m_IsLogarithmic; }
+
+        /**
+         * @brief Gets the factors that map a view depth to its depth slice.
+         * @return The scale (x) and the bias (y).
+         */
+        const glm::vec2& GetDepthScaleBias() const { return m_DepthScaleBias; }
+
+        /**
+         * @brief Gets the largest number of lights a single cluster had in the last build.
+         * @return The number of lights.
+         */
+        uint32_t GetMaxClusterLightCount() const { return m_MaxClusterLightCount; }
+
+        /**
+         * @brief Gets the number of light assignments dropped because a cluster was full in the last build.
+         * @return The number of dropped assignments.
+         */
+        uint32_t GetDroppedLightCount() const { return m_DroppedLightCount; }
+
+        static constexpr uint32_t MaxLightsPerCluster = 128; ///< Bounds the lights a fragment has to shade.
+
+    private:
+        /**
+         * @brief A point or spot light in view space.
+         */
+        struct ClusterLight
+        {
+            glm::vec3 Center;
+            float Radius;
+            glm::vec3 Direction; ///< The direction of a spot light.
+            float CosAngle; ///< The cosine of the half angle of a spot light.
+            float SinAngle;
+            bool IsSpot;
+            uint32_t Index; ///< The index of the light passed to Build.
+            uint32_t FirstSlice;
+            uint32_t LastSlice;
+        };
+
+        void UpdateClusterBounds(const glm::mat4& projection);
+        uint32_t GetSlice(float depth) const;
+        void FillSlice(uint32_t slice);
+
+        glm::uvec3 m_GridSize;
+        uint32_t m_TileCount = 0; ///< The clusters of a depth slice.
+        uint32_t m_TileStride = 0; ///< The tile count rounded up to the SIMD width.
+
+        glm::mat4 m_Projection = glm::mat4(0.0f); ///< The projection the bounds were calculated for.
+        bool m_IsLogarithmic = true;
+        glm::vec2 m_DepthScaleBias = glm::vec2(0.0f);
+        float m_Near = 0.0f;
+        float m_Far = 0.0f;
+
+        // The view space bounds of the clusters, split by component and grouped by slice (m_TileStride per slice)
+        std::vector<float> m_MinX, m_MinY, m_MinZ;
+        std::vector<float> m_MaxX, m_MaxY, m_MaxZ;
+        std::vector<glm::vec4> m_BoundingSpheres; ///< The sphere around each cluster, for the spot light cones.
+
+        std::vector<ClusterLight> m_Lights;
+        std::vector<std::vector<uint32_t>> m_ClusterLights; ///< The lights of each cluster, filled by the slice jobs.
+
+        std::vector<glm::uvec2> m_Clusters;
+        std::vector<uint32_t> m_LightIndices;
+        uint32_t m_MaxClusterLightCount = 0;
+        uint32_t m_DroppedLightCount = 0;
+    };
+
+    /** @} */
+}
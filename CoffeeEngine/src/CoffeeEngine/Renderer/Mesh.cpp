@@ -1,10 +1,15 @@
 #include "CoffeeEngine/Renderer/Mesh.h"
 #include "CoffeeEngine/Core/Base.h"
+#include "CoffeeEngine/Renderer/MeshSimplifier.h"
 #include "CoffeeEngine/Renderer/VertexArray.h"
+#include <algorithm>
 #include <tracy/Tracy.hpp>
 
 namespace Coffee {
 
+    // Meshes with fewer triangles are cheap enough to always draw at full detail
+    static constexpr size_t s_MinLODTriangleCount = 256;
+
     Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
         : Resource(ResourceType::Mesh)
     {
@@ -31,4 +36,126 @@ namespace Coffee {
         m_VertexArray->SetIndexBuffer(m_IndexBuffer);
     }
 
+    const Ref<VertexArray>& Mesh::GetVertexArray(uint32_t lod) const
+    {
+        if (lod == 0 || m_LODVertexArrays.empty())
+            return m_VertexArray;
+
+        return m_LODVertexArrays[std::min<size_t>(lod, m_LODVertexArrays.size()) - 1];
+    }
+
+    uint32_t Mesh::GetIndexCount(uint32_t lod) const
+    {
+        if (lod == 0 || m_LODs.empty())
+            return static_cast<uint32_t>(m_Indices.size());
+
+        return static_cast<uint32_t>(m_LODs[std::min<size_t>(lod, m_LODs.size()) - 1].Indices.size());
+    }
+
+    void Mesh::GenerateLODs(uint32_t maxLevels)
+    {
+        ZoneScoped;
+
+        m_LODs.clear();
+
+        if (m_Indices.size() >= s_MinLODTriangleCount * 3 && !m_Vertices.empty())
+        {
+            glm::vec3 min = m_Vertices[0].Position, max = m_Vertices[0].Position;
+            for (const Vertex& vertex : m_Vertices)
+            {
+                min = glm::min(min, vertex.Position);
+                max = glm::max(max, vertex.Position);
+            }
+            float size = glm::length(max - min);
+
+            MeshSimplifier simplifier(m_Vertices.data(), m_Vertices.size(), sizeof(Vertex));
+
+            // Each level is simplified from the previous one, which is cheaper than starting from the full mesh
+            for (uint32_t level = 0; level < maxLevels; level++)
+            {
+                const std::vector<uint32_t>& previous = m_LODs.empty() ? m_Indices : m_LODs.back().Indices;
+                size_t previousCount = previous.size();
+
+                float error;
+                std::vector<uint32_t> indices = simplifier.Simplify(previous, previousCount / 2, error);
+
+                // The locked vertices (borders, seams) stop the simplification, a level this close to the previous
+                // one is not worth its memory
+                if (indices.size() * 10 > previousCount * 9)
+                    break;
+
+                m_LODs.push_back({std::move(indices), size > 0.0f ? error / size : 0.0f});
+            }
+        }
+
+        CreateLODBuffers();
+    }
+
+    void Mesh::CreateLODBuffers()
+    {
+        ZoneScoped;
+
+        m_LODVertexArrays.clear();
+
+        for (MeshLOD& lod : m_LODs)
+        {
+            Ref<VertexArray> vertexArray = VertexArray::Create();
+            vertexArray->AddVertexBuffer(m_VertexBuffer);
+            vertexArray->SetIndexBuffer(IndexBuffer::Create(lod.Indices.data(), lod.Indices.size()));
+
+            m_LODVertexArrays.push_back(vertexArray);
+        }
+    }
+
+    const PrimitiveBVH& Mesh::GetBVH()
+    {
+        if (m_BVH)
+            return *m_BVH;
+
+        ZoneScoped;
+
+        std::vector<AABB> triangleBounds;
+        triangleBounds.reserve(m_Indices.size() / 3);
+
+        for (size_t i = 0; i + 2 < m_Indices.size(); i += 3)
+        {
+            const glm::vec3& v0 = m_Vertices[m_Indices[i]].Position;
+            const glm::vec3& v1 = m_Vertices[m_Indices[i + 1]].Position;
+            const glm::vec3& v2 = m_Vertices[m_Indices[i + 2]].Position;
+
+            triangleBounds.emplace_back(glm::min(v0, glm::min(v1, v2)), glm::max(v0, glm::max(v1, v2)));
+        }
+
+        m_BVH = CreateRef<PrimitiveBVH>();
+        m_BVH->Build(triangleBounds);
+
+        return *m_BVH;
+    }
+
+    bool Mesh::Raycast(const Ray& ray, float maxDistance, float& distance, uint32_t& triangleIndex)
+    {
+        ZoneScoped;
+
+        bool hit = false;
+
+        GetBVH().Raycast(ray, maxDistance, [&](uint32_t triangle, float& closestDistance) {
+            uint32_t first = triangle * 3;
+
+            float triangleDistance;
+            if (ray.IntersectTriangle(m_Vertices[m_Indices[first]].Position,
+                                      m_Vertices[m_Indices[first + 1]].Position,
+                                      m_Vertices[m_Indices[first + 2]].Position,
+                                      triangleDistance) &&
+                triangleDistance < closestDistance)
+            {
+                closestDistance = triangleDistance;
+                triangleIndex = first;
+                hit = true;
+            }
+        });
+
+        distance = maxDistance;
+        return hit;
+    }
+
 }
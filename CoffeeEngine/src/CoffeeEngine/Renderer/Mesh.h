@@ -1,12 +1,14 @@
 #pragma once
 
 #include "CoffeeEngine/Core/Base.h"
+#include "CoffeeEngine/Core/DataStructures/PrimitiveBVH.h"
 #include "CoffeeEngine/IO/Resource.h"
 #include "CoffeeEngine/IO/ResourceLoader.h"
 #include "CoffeeEngine/Renderer/Buffer.h"
 #include "CoffeeEngine/Renderer/Material.h"
 #include "CoffeeEngine/Renderer/VertexArray.h"
 #include "CoffeeEngine/Math/BoundingBox.h"
+#include "CoffeeEngine/Math/Ray.h"
 #include "CoffeeEngine/IO/Serialization/GLMSerialization.h"
 
 #include <cstdint>
@@ -16,6 +18,7 @@
 #include <vector>
 #include <array>
 #include <cereal/access.hpp>
+#include <cereal/details/helpers.hpp>
 #include <cereal/types/vector.hpp>
 #include <cereal/types/polymorphic.hpp>
 
@@ -47,6 +50,24 @@ namespace Coffee {
             }
     };
 
+    /**
+     * @brief Structure representing a simplified level of detail of a mesh.
+     */
+    struct MeshLOD
+    {
+        std::vector<uint32_t> Indices; ///< The triangles of the level, they index the vertices of the mesh.
+        float Error = 0.0f; ///< The largest distance to the full detail surface, relative to the size of the mesh.
+
+        private:
+            friend class cereal::access;
+
+            template<class Archive>
+            void serialize(Archive& archive)
+            {
+                archive(Indices, Error);
+            }
+    };
+
     /**
      * @brief Class representing a mesh.
      */
@@ -66,6 +87,39 @@ namespace Coffee {
          */
         const Ref<VertexArray>& GetVertexArray() const { return m_VertexArray; }
 
+        /**
+         * @brief Gets the vertex array of a level of detail, all the levels share the vertex buffer.
+         * @param lod The level, 0 is the full detail mesh. Levels past the last one return the last one.
+         * @return A reference to the vertex array.
+         */
+        const Ref<VertexArray>& GetVertexArray(uint32_t lod) const;
+
+        /**
+         * @brief Gets the number of indices of a level of detail.
+         * @param lod The level, 0 is the full detail mesh. Levels past the last one return the last one.
+         * @return The number of indices.
+         */
+        uint32_t GetIndexCount(uint32_t lod) const;
+
+        /**
+         * @brief Gets the number of levels of detail, counting the full detail mesh.
+         * @return The number of levels.
+         */
+        uint32_t GetLODCount() const { return static_cast<uint32_t>(m_LODs.size()) + 1; }
+
+        /**
+         * @brief Gets the simplified levels of detail, the first one is level 1.
+         * @return A reference to the vector of levels.
+         */
+        const std::vector<MeshLOD>& GetLODs() const { return m_LODs; }
+
+        /**
+         * @brief Generates the simplified levels of detail of the mesh, each one with about half the triangles of
+         * the previous one. It stops early when the mesh can not be simplified further.
+         * @param maxLevels The maximum number of levels to generate, not counting the full detail mesh.
+         */
+        void GenerateLODs(uint32_t maxLevels = 4);
+
         /**
          * @brief Gets the vertex buffer of the mesh.
          * @return A reference to the vertex buffer.
@@ -121,28 +175,51 @@ namespace Coffee {
          */
         const std::vector<uint32_t>& GetIndices() const { return m_Indices; }
 
+        /**
+         * @brief Gets the bounding volume hierarchy of the triangles, it is built the first time it is requested.
+         * @return A reference to the BVH.
+         */
+        const PrimitiveBVH& GetBVH();
+
+        /**
+         * @brief Intersects a ray with the triangles of the mesh.
+         * @param ray The ray, in the local space of the mesh.
+         * @param maxDistance Hits further than this distance are ignored.
+         * @param distance The distance to the closest hit.
+         * @param triangleIndex The index of the first vertex index of the hit triangle.
+         * @return True if the ray hits the mesh.
+         */
+        bool Raycast(const Ray& ray, float maxDistance, float& distance, uint32_t& triangleIndex);
+
     private:
         friend class cereal::access;
 
         template<class Archive>
         void save(Archive& archive) const
         {
+            archive(s_CacheMagic, s_CacheVersion);
+
             UUID materialUUID = m_Material->GetUUID();
-            archive(m_Vertices, m_Indices, m_AABB, materialUUID, cereal::base_class<Resource>(this));
+            archive(m_Vertices, m_Indices, m_AABB, materialUUID, cereal::base_class<Resource>(this), m_LODs);
         }
 
         template<class Archive>
         void load(Archive& archive)
         {
+            CheckCacheVersion(archive);
+
             UUID materialUUID;
-            archive(m_Vertices, m_Indices, m_AABB, materialUUID, cereal::base_class<Resource>(this));
+            archive(m_Vertices, m_Indices, m_AABB, materialUUID, cereal::base_class<Resource>(this), m_LODs);
 
             m_Material = ResourceLoader::LoadMaterial(materialUUID);
+            CreateLODBuffers();
         }
 
         template<class Archive>
         static void load_and_construct(Archive& data, cereal::construct<Mesh>& construct)
         {
+            CheckCacheVersion(data);
+
             // Try to take this data as a reference
             std::vector<Vertex> vertices;
             std::vector<uint32_t> indices;
@@ -151,11 +228,39 @@ namespace Coffee {
 
             UUID materialUUID;
 
-            data(construct->m_AABB, materialUUID, cereal::base_class<Resource>(construct.ptr()));
+            data(construct->m_AABB, materialUUID, cereal::base_class<Resource>(construct.ptr()), construct->m_LODs);
             construct->m_Vertices = vertices;
             construct->m_Indices = indices;
             construct->m_Material = ResourceLoader::LoadMaterial(materialUUID);
+            construct->CreateLODBuffers();
+        }
+
+        /**
+         * @brief Reads the header of a serialized mesh.
+         *
+         * Caches written before the header, or with another version, throw a cereal::Exception before any of their
+         * data is read so the importer can create the mesh again.
+         */
+        template<class Archive>
+        static void CheckCacheVersion(Archive& archive)
+        {
+            uint64_t magic = 0;
+            uint32_t version = 0;
+            archive(magic, version);
+
+            if (magic != s_CacheMagic || version != s_CacheVersion)
+            {
+                throw cereal::Exception("Mesh cache version " + std::to_string(version) + " does not match version " + std::to_string(s_CacheVersion));
+            }
         }
+
+        /**
+         * @brief Creates the index buffer and vertex array of each level of detail.
+         */
+        void CreateLODBuffers();
+
+        static constexpr uint64_t s_CacheMagic = 0x48534D45'45464643; ///< "CFFEEMSH" in front of the serialized meshes.
+        static constexpr uint32_t s_CacheVersion = 1; ///< Increase it when the serialized layout of the mesh changes.
       private:
         Ref<VertexArray> m_VertexArray; ///< The vertex array of the mesh.
         Ref<VertexBuffer> m_VertexBuffer; ///< The vertex buffer of the mesh.
@@ -166,6 +271,11 @@ namespace Coffee {
 
         std::vector<uint32_t> m_Indices; ///< The indices of the mesh.
         std::vector<Vertex> m_Vertices; ///< The vertices of the mesh.
+
+        Ref<PrimitiveBVH> m_BVH; ///< The triangle hierarchy, built on the first raycast.
+
+        std::vector<MeshLOD> m_LODs; ///< The simplified levels of detail.
+        std::vector<Ref<VertexArray>> m_LODVertexArrays; ///< The vertex array of each level of detail.
     };
 
     /** @} */
@@ -0,0 +1,402 @@
+#include "CoffeeEngine/Renderer/MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    void MeshSimplifier::Quadric::AddPlane(const glm::vec3& normal, float distance, float weight)
+    {
+        A00 += weight * normal.x * normal.x;
+        A01 += weight * normal.x * normal.y;
+        A02 += weight * normal.x * normal.z;
+        A11 += weight * normal.y * normal.y;
+        A12 += weight * normal.y * normal.z;
+        A22 += weight * normal.z * normal.z;
+        B0 += weight * normal.x * distance;
+        B1 += weight * normal.y * distance;
+        B2 += weight * normal.z * distance;
+        C += weight * distance * distance;
+        Weight += weight;
+    }
+
+    void MeshSimplifier::Quadric::Add(const Quadric& other)
+    {
+        A00 += other.A00;
+        A01 += other.A01;
+        A02 += other.A02;
+        A11 += other.A11;
+        A12 += other.A12;
+        A22 += other.A22;
+        B0 += other.B0;
+        B1 += other.B1;
+        B2 += other.B2;
+        C += other.C;
+        Weight += other.Weight;
+    }
+
+    double MeshSimplifier::Quadric::Evaluate(const glm::vec3& point) const
+    {
+        double x = point.x, y = point.y, z = point.z;
+
+        double error = A00 * x * x + A11 * y * y + A22 * z * z +
+                       2.0 * (A01 * x * y + A02 * x * z + A12 * y * z) +
+                       2.0 * (B0 * x + B1 * y + B2 * z) + C;
+
+        // Rounding can make it slightly negative
+        return std::max(error, 0.0);
+    }
+
+    MeshSimplifier::MeshSimplifier(const void* vertices, size_t vertexCount, size_t vertexStride)
+    {
+        ZoneScoped;
+
+        const char* data = static_cast<const char*>(vertices);
+
+        // Sorting the vertices by their bytes puts the copies of a vertex next to each other, and since the position
+        // comes first, all the vertices at the same position too
+        std::vector<uint32_t> order(vertexCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            int comparison = std::memcmp(data + a * vertexStride, data + b * vertexStride, vertexStride);
+            return comparison < 0 || (comparison == 0 && a < b);
+        });
+
+        m_PositionIDs.resize(vertexCount);
+        m_Wedges.resize(vertexCount);
+
+        for (size_t i = 0; i < vertexCount;)
+        {
+            const char* position = data + order[i] * vertexStride;
+            uint32_t positionID = static_cast<uint32_t>(m_Positions.size());
+
+            glm::vec3 point;
+            std::memcpy(&point, position, sizeof(glm::vec3));
+            m_Positions.push_back(point);
+
+            bool isSeam = false;
+            uint32_t wedge = order[i];
+
+            size_t j = i;
+            for (; j < vertexCount && std::memcmp(data + order[j] * vertexStride, position, sizeof(glm::vec3)) == 0; j++)
+            {
+                if (std::memcmp(data + order[j] * vertexStride, data + wedge * vertexStride, vertexStride) != 0)
+                {
+                    wedge = order[j];
+                    isSeam = true;
+                }
+
+                m_PositionIDs[order[j]] = positionID;
+                m_Wedges[order[j]] = wedge;
+            }
+
+            m_IsSeam.push_back(isSeam);
+            i = j;
+        }
+    }
+
+    std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error) const
+    {
+        ZoneScoped;
+
+        const size_t positionCount = m_Positions.size();
+        double maxCost = 0.0;
+
+        // The triangles reference the first copy of each vertex, the degenerate ones are dropped
+        std::vector<uint32_t> triangles;
+        triangles.reserve(indices.size());
+
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            uint32_t a = m_Wedges[indices[i]], b = m_Wedges[indices[i + 1]], c = m_Wedges[indices[i + 2]];
+            uint32_t pa = m_PositionIDs[a], pb = m_PositionIDs[b], pc = m_PositionIDs[c];
+
+            if (pa != pb && pb != pc && pc != pa)
+            {
+                triangles.insert(triangles.end(), {a, b, c});
+            }
+        }
+
+        auto positionOf = [&](size_t corner) { return m_PositionIDs[triangles[corner]]; };
+
+        // The vertices of border and non manifold edges are locked, as are the seams
+        std::vector<bool> locked = m_IsSeam;
+        {
+            std::unordered_map<uint64_t, uint32_t> edgeUses;
+            edgeUses.reserve(triangles.size());
+
+            for (size_t corner = 0; corner < triangles.size(); corner++)
+            {
+                uint32_t a = positionOf(corner);
+                uint32_t b = positionOf(corner - corner % 3 + (corner + 1) % 3);
+                edgeUses[(uint64_t)std::min(a, b) << 32 | std::max(a, b)]++;
+            }
+
+            for (const auto& [edge, uses] : edgeUses)
+            {
+                if (uses != 2)
+                {
+                    locked[edge >> 32] = true;
+                    locked[edge & 0xFFFFFFFF] = true;
+                }
+            }
+        }
+
+        std::vector<Quadric> quadrics(positionCount);
+        for (size_t i = 0; i < triangles.size(); i += 3)
+        {
+            const glm::vec3& p0 = m_Positions[positionOf(i)];
+            const glm::vec3& p1 = m_Positions[positionOf(i + 1)];
+            const glm::vec3& p2 = m_Positions[positionOf(i + 2)];
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+
+            normal /= length;
+            float distance = -glm::dot(normal, p0);
+
+            // Weighted by the area, so the error of a vertex does not depend on how finely it is tessellated
+            for (size_t k = 0; k < 3; k++)
+            {
+                quadrics[positionOf(i + k)].AddPlane(normal, distance, length * 0.5f);
+            }
+        }
+
+        auto collapseCost = [&](uint32_t from, uint32_t to) {
+            Quadric quadric = quadrics[from];
+            quadric.Add(quadrics[to]);
+            return quadric.Weight > 0.0 ? quadric.Evaluate(m_Positions[to]) / quadric.Weight : 0.0;
+        };
+
+        struct Collapse
+        {
+            uint32_t From;
+            uint32_t To;
+            double Cost;
+        };
+
+        size_t triangleCount = triangles.size() / 3;
+        const size_t targetTriangleCount = targetIndexCount / 3;
+
+        std::vector<uint32_t> fanOffsets, fans, fanFill;
+        std::vector<Collapse> collapses;
+        std::vector<bool> dirty(positionCount);
+        std::vector<bool> removed;
+        std::vector<uint32_t> fromNeighbours, toNeighbours, opposite;
+
+        auto gatherNeighbours = [&](uint32_t position, std::vector<uint32_t>& neighbours) {
+            neighbours.clear();
+            for (uint32_t i = fanOffsets[position]; i < fanOffsets[position + 1]; i++)
+            {
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t neighbour = positionOf(fans[i] * 3 + k);
+                    if (neighbour != position)
+                        neighbours.push_back(neighbour);
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        };
+
+        auto containsPosition = [&](uint32_t triangle, uint32_t position) {
+            return positionOf(triangle * 3) == position || positionOf(triangle * 3 + 1) == position ||
+                   positionOf(triangle * 3 + 2) == position;
+        };
+
+        // A collapse must keep the edge manifold (the link condition) and not fold any triangle over
+        auto canCollapse = [&](uint32_t from, uint32_t to) {
+            gatherNeighbours(from, fromNeighbours);
+            gatherNeighbours(to, toNeighbours);
+
+            opposite.clear();
+            for (uint32_t i = fanOffsets[from]; i < fanOffsets[from + 1]; i++)
+            {
+                uint32_t triangle = fans[i];
+                if (!containsPosition(triangle, to))
+                    continue;
+
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t position = positionOf(triangle * 3 + k);
+                    if (position != from && position != to)
+                        opposite.push_back(position);
+                }
+            }
+
+            if (opposite.size() != 2 || opposite[0] == opposite[1])
+                return false;
+
+            size_t sharedNeighbours = 0;
+            for (uint32_t neighbour : fromNeighbours)
+            {
+                if (std::binary_search(toNeighbours.begin(), toNeighbours.end(), neighbour))
+                    sharedNeighbours++;
+            }
+
+            if (sharedNeighbours != 2)
+                return false;
+
+            for (uint32_t i = fanOffsets[from]; i < fanOffsets[from + 1]; i++)
+            {
+                uint32_t triangle = fans[i];
+                if (containsPosition(triangle, to))
+                    continue;
+
+                glm::vec3 before[3], after[3];
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t position = positionOf(triangle * 3 + k);
+                    before[k] = m_Positions[position];
+                    after[k] = position == from ? m_Positions[to] : before[k];
+                }
+
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+                float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+                if (lengths <= 0.0f || glm::dot(normalBefore, normalAfter) < 0.25f * lengths)
+                    return false;
+            }
+
+            return true;
+        };
+
+        while (triangleCount > targetTriangleCount)
+        {
+            // The triangles around each position
+            fanOffsets.assign(positionCount + 1, 0);
+            for (size_t corner = 0; corner < triangles.size(); corner++)
+            {
+                fanOffsets[positionOf(corner) + 1]++;
+            }
+            std::partial_sum(fanOffsets.begin(), fanOffsets.end(), fanOffsets.begin());
+
+            fans.resize(triangles.size());
+            fanFill.assign(fanOffsets.begin(), fanOffsets.end() - 1);
+            for (size_t corner = 0; corner < triangles.size(); corner++)
+            {
+                fans[fanFill[positionOf(corner)]++] = static_cast<uint32_t>(corner / 3);
+            }
+
+            // The cheapest collapse of each free vertex onto one of its neighbours
+            collapses.clear();
+            for (uint32_t position = 0; position < positionCount; position++)
+            {
+                if (locked[position])
+                    continue;
+
+                Collapse best = {position, position, 0.0};
+                for (uint32_t i = fanOffsets[position]; i < fanOffsets[position + 1]; i++)
+                {
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        uint32_t neighbour = positionOf(fans[i] * 3 + k);
+                        if (neighbour == position)
+                            continue;
+
+                        double cost = collapseCost(position, neighbour);
+                        if (best.To == position || cost < best.Cost)
+                            best = {position, neighbour, cost};
+                    }
+                }
+
+                if (best.To != position)
+                    collapses.push_back(best);
+            }
+
+            if (collapses.empty())
+                break;
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+            // Every collapse removes two triangles, the pass only considers a few more candidates than it needs so
+            // the expensive collapses wait for the next passes, where cheaper ones may have appeared
+            size_t neededCollapses = (triangleCount - targetTriangleCount + 1) / 2;
+            double costLimit = collapses[std::min(collapses.size() - 1, neededCollapses + neededCollapses / 2)].Cost;
+
+            std::fill(dirty.begin(), dirty.end(), false);
+            removed.assign(triangles.size() / 3, false);
+            size_t collapseCount = 0;
+
+            for (const Collapse& collapse : collapses)
+            {
+                if (collapse.Cost > costLimit || triangleCount <= targetTriangleCount)
+                    break;
+
+                // The fans around a collapse change, they are rebuilt before being used again
+                if (dirty[collapse.From] || dirty[collapse.To] || !canCollapse(collapse.From, collapse.To))
+                    continue;
+
+                uint32_t toWedge = 0;
+                for (uint32_t i = fanOffsets[collapse.From]; i < fanOffsets[collapse.From + 1]; i++)
+                {
+                    uint32_t triangle = fans[i];
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        if (positionOf(triangle * 3 + k) == collapse.To)
+                            toWedge = triangles[triangle * 3 + k];
+                    }
+                }
+
+                for (uint32_t i = fanOffsets[collapse.From]; i < fanOffsets[collapse.From + 1]; i++)
+                {
+                    uint32_t triangle = fans[i];
+                    if (containsPosition(triangle, collapse.To))
+                    {
+                        removed[triangle] = true;
+                        triangleCount--;
+                        continue;
+                    }
+
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        if (positionOf(triangle * 3 + k) == collapse.From)
+                            triangles[triangle * 3 + k] = toWedge;
+                    }
+                }
+
+                quadrics[collapse.To].Add(quadrics[collapse.From]);
+                locked[collapse.From] = true;
+                maxCost = std::max(maxCost, collapse.Cost);
+
+                dirty[collapse.From] = true;
+                dirty[collapse.To] = true;
+                for (uint32_t neighbour : fromNeighbours)
+                {
+                    dirty[neighbour] = true;
+                }
+
+                collapseCount++;
+            }
+
+            if (collapseCount == 0)
+                break;
+
+            size_t kept = 0;
+            for (size_t triangle = 0; triangle < removed.size(); triangle++)
+            {
+                if (removed[triangle])
+                    continue;
+
+                for (size_t k = 0; k < 3; k++)
+                {
+                    triangles[kept * 3 + k] = triangles[triangle * 3 + k];
+                }
+                kept++;
+            }
+            triangles.resize(kept * 3);
+        }
+
+        error = static_cast<float>(std::sqrt(maxCost));
+        return triangles;
+    }
+
+}
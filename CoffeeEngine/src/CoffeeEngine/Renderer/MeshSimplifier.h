@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @defgroup renderer Renderer
+     * @{
+     */
+
+    /**
+     * @brief Reduces the triangles of a mesh with quadric error edge collapses, to build its levels of detail.
+     *
+     * Only the indices are simplified: a vertex is collapsed onto one of its neighbours, so the result keeps indexing
+     * the original vertex buffer and every level can share it. The vertices are welded by position to find the
+     * topology, vertices on a border, on a UV or normal seam or on a non manifold edge never move, which keeps the
+     * silhouette and the texture mapping of the mesh. Each pass picks the cheapest collapses of the quadric error
+     * (Garland and Heckbert), skipping the ones that would flip a triangle or break the manifold.
+     */
+    class MeshSimplifier
+    {
+    public:
+        /**
+         * @brief Welds the vertices of a mesh.
+         * @param vertices The vertex data, each vertex starts with its position (three floats).
+         * @param vertexCount The number of vertices.
+         * @param vertexStride The size of a vertex, in bytes. Vertices with the same bytes are treated as one.
+         */
+        MeshSimplifier(const void* vertices, size_t vertexCount, size_t vertexStride);
+
+        /**
+         * @brief Simplifies the triangles of the mesh.
+         * @param indices The triangles to simplify, the original ones or a previous result.
+         * @param targetIndexCount The number of indices to reach, the result can have more if the mesh can not be
+         * simplified further without moving a locked vertex.
+         * @param error The largest distance between the result and the surface it replaces.
+         * @return The indices of the remaining triangles.
+         */
+        std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error) const;
+
+    private:
+        /**
+         * @brief The sum of the squared distances to a set of planes, weighted by the area of their triangles.
+         */
+        struct Quadric
+        {
+            double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+            double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+            double C = 0.0;
+            double Weight = 0.0;
+
+            void AddPlane(const glm::vec3& normal, float distance, float weight);
+            void Add(const Quadric& other);
+            double Evaluate(const glm::vec3& point) const;
+        };
+
+        std::vector<glm::vec3> m_Positions; ///< The position of each welded position.
+        std::vector<uint32_t> m_PositionIDs; ///< The welded position of each vertex.
+        std::vector<uint32_t> m_Wedges; ///< The first vertex with the same bytes as each vertex.
+        std::vector<bool> m_IsSeam; ///< True for the positions shared by vertices with different attributes.
+    };
+
+    /** @} */
+}
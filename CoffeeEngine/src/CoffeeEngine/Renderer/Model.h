@@ -132,7 +132,13 @@ namespace Coffee {
             archive(meshUUIDs, m_Parent, m_Children, m_Transform, m_NodeName, cereal::base_class<Resource>(this));
             for (const auto& meshUUID : meshUUIDs)
             {
-                m_Meshes.push_back(ResourceLoader::LoadMesh(meshUUID));
+                Ref<Mesh> mesh = ResourceLoader::LoadMesh(meshUUID);
+                if (!mesh)
+                {
+                    // The importer catches it and imports the model again from its file
+                    throw cereal::Exception("Mesh " + std::to_string(meshUUID) + " of the model could not be loaded from the cache");
+                }
+                m_Meshes.push_back(mesh);
             }
         }
 
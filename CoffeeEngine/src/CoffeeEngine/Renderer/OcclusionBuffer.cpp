@@ -0,0 +1,337 @@
+#include "OcclusionBuffer.h"
+#include "CoffeeEngine/Core/JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tracy/Tracy.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define COFFEE_OCCLUSION_BUFFER_SSE 1
+    #include <xmmintrin.h>
+#else
+    #define COFFEE_OCCLUSION_BUFFER_SSE 0
+#endif
+
+namespace Coffee {
+
+    namespace
+    {
+        constexpr uint32_t s_SimdWidth = 4;
+        constexpr uint32_t s_RowPadding = 8; ///< Extra floats after the last row, the tests load full groups.
+        constexpr float s_EmptyDepth = std::numeric_limits<float>::max();
+    }
+
+    OcclusionBuffer::OcclusionBuffer(uint32_t width, uint32_t height)
+    {
+        Resize(width, height);
+    }
+
+    void OcclusionBuffer::Resize(uint32_t width, uint32_t height)
+    {
+        m_Width = std::max(width, 1u);
+        m_Height = std::max(height, 1u);
+        m_Stride = (m_Width + s_SimdWidth - 1) / s_SimdWidth * s_SimdWidth;
+
+        m_Depth.assign(m_Stride * m_Height + s_RowPadding, s_EmptyDepth);
+    }
+
+    void OcclusionBuffer::Begin(const glm::mat4& viewProjection)
+    {
+        ZoneScoped;
+
+        m_ViewProjection = viewProjection;
+        m_Occluders.clear();
+        m_TriangleCount = 0;
+
+        std::fill(m_Depth.begin(), m_Depth.end(), s_EmptyDepth);
+    }
+
+    void OcclusionBuffer::AddOccluder(const glm::mat4& transform, const glm::vec3* positions, size_t stride, const uint32_t* indices, size_t indexCount)
+    {
+        if (indexCount < 3)
+            return;
+
+        m_Occluders.push_back({transform, positions, stride, indices, indexCount});
+    }
+
+    void OcclusionBuffer::Rasterize()
+    {
+        ZoneScoped;
+
+        m_Triangles.resize(m_Occluders.size());
+
+        // The occluders are transformed and clipped in parallel, each one into its own triangle list
+        JobSystem::ParallelFor(static_cast<uint32_t>(m_Occluders.size()), 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                m_Triangles[i].clear();
+                SetupOccluder(m_Occluders[i], m_Triangles[i]);
+            }
+        });
+
+        m_TriangleCount = 0;
+        for (const auto& triangles : m_Triangles)
+        {
+            m_TriangleCount += triangles.size();
+        }
+
+        // Every band owns its rows, so the jobs never write the same pixels
+        uint32_t bandCount = (m_Height + s_BandHeight - 1) / s_BandHeight;
+        JobSystem::ParallelFor(bandCount, 1, [this](uint32_t begin, uint32_t end) {
+            for (uint32_t band = begin; band < end; band++)
+            {
+                RasterizeBand(static_cast<int32_t>(band * s_BandHeight), static_cast<int32_t>(std::min(m_Height, (band + 1) * s_BandHeight)));
+            }
+        });
+    }
+
+    void OcclusionBuffer::SetupOccluder(const Occluder& occluder, std::vector<Triangle>& triangles) const
+    {
+        ZoneScoped;
+
+        glm::mat4 transform = m_ViewProjection * occluder.Transform;
+        const uint8_t* positions = reinterpret_cast<const uint8_t*>(occluder.Positions);
+
+        for (size_t i = 0; i + 2 < occluder.IndexCount; i += 3)
+        {
+            glm::vec4 clip[3];
+            for (int k = 0; k < 3; k++)
+            {
+                const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(positions + occluder.Indices[i + k] * occluder.Stride);
+                clip[k] = transform * glm::vec4(position, 1.0f);
+            }
+
+            // Triangles fully outside one of the side planes can not cover any pixel
+            if ((clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+                (clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+                (clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+                (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w))
+                continue;
+
+            // Signed distances to the near plane, z = -w in OpenGL clip space
+            float distances[3] = {clip[0].z + clip[0].w, clip[1].z + clip[1].w, clip[2].z + clip[2].w};
+
+            if (distances[0] >= 0.0f && distances[1] >= 0.0f && distances[2] >= 0.0f)
+            {
+                SetupTriangle(clip[0], clip[1], clip[2], triangles);
+                continue;
+            }
+
+            if (distances[0] < 0.0f && distances[1] < 0.0f && distances[2] < 0.0f)
+                continue;
+
+            // Clipping a triangle against one plane leaves a triangle or a quad
+            glm::vec4 polygon[4];
+            int count = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                int next = (k + 1) % 3;
+
+                if (distances[k] >= 0.0f)
+                    polygon[count++] = clip[k];
+
+                if ((distances[k] >= 0.0f) != (distances[next] >= 0.0f))
+                {
+                    float t = distances[k] / (distances[k] - distances[next]);
+                    polygon[count++] = clip[k] + (clip[next] - clip[k]) * t;
+                }
+            }
+
+            SetupTriangle(polygon[0], polygon[1], polygon[2], triangles);
+            if (count == 4)
+            {
+                SetupTriangle(polygon[0], polygon[2], polygon[3], triangles);
+            }
+        }
+    }
+
+    void OcclusionBuffer::SetupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2, std::vector<Triangle>& triangles) const
+    {
+        if (v0.w <= 0.0f || v1.w <= 0.0f || v2.w <= 0.0f)
+            return;
+
+        // The setup is done in double, the clipped vertices can project far outside the buffer
+        glm::dvec3 p[3];
+        const glm::vec4* vertices[3] = {&v0, &v1, &v2};
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::vec4& v = *vertices[k];
+            p[k] = glm::dvec3((v.x / (double)v.w * 0.5 + 0.5) * m_Width, (v.y / (double)v.w * 0.5 + 0.5) * m_Height, v.z / (double)v.w);
+        }
+
+        double area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+        if (std::abs(area) < 1e-9)
+            return;
+
+        // Both faces are occluders, the back faces are turned counter clockwise
+        if (area < 0.0)
+        {
+            std::swap(p[1], p[2]);
+            area = -area;
+        }
+
+        double minX = std::max(std::floor(std::min({p[0].x, p[1].x, p[2].x})), 0.0);
+        double minY = std::max(std::floor(std::min({p[0].y, p[1].y, p[2].y})), 0.0);
+        double maxX = std::min(std::floor(std::max({p[0].x, p[1].x, p[2].x})), (double)m_Width - 1.0);
+        double maxY = std::min(std::floor(std::max({p[0].y, p[1].y, p[2].y})), (double)m_Height - 1.0);
+
+        if (minX > maxX || minY > maxY)
+            return;
+
+        Triangle triangle;
+        triangle.MinX = static_cast<int32_t>(minX);
+        triangle.MinY = static_cast<int32_t>(minY);
+        triangle.MaxX = static_cast<int32_t>(maxX);
+        triangle.MaxY = static_cast<int32_t>(maxY);
+
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::dvec3& a = p[k];
+            const glm::dvec3& b = p[(k + 1) % 3];
+
+            triangle.EdgeA[k] = a.y - b.y;
+            triangle.EdgeB[k] = b.x - a.x;
+
+            // Evaluated at the pixel centers, the shrink makes a pixel pass only if its whole square is inside
+            triangle.EdgeC[k] = -(triangle.EdgeA[k] * a.x + triangle.EdgeB[k] * a.y) -
+                                0.5 * (std::abs(triangle.EdgeA[k]) + std::abs(triangle.EdgeB[k]));
+        }
+
+        double dx1 = p[1].x - p[0].x, dy1 = p[1].y - p[0].y, dz1 = p[1].z - p[0].z;
+        double dx2 = p[2].x - p[0].x, dy2 = p[2].y - p[0].y, dz2 = p[2].z - p[0].z;
+
+        triangle.DepthX = (dz1 * dy2 - dz2 * dy1) / area;
+        triangle.DepthY = (dz2 * dx1 - dz1 * dx2) / area;
+
+        // Raised to the farthest depth of the plane inside a pixel, the occluder never hides more than it covers
+        triangle.DepthC = p[0].z - triangle.DepthX * p[0].x - triangle.DepthY * p[0].y +
+                          0.5 * (std::abs(triangle.DepthX) + std::abs(triangle.DepthY));
+
+        triangles.push_back(triangle);
+    }
+
+    void OcclusionBuffer::RasterizeBand(int32_t firstRow, int32_t lastRow)
+    {
+        ZoneScoped;
+
+        for (const auto& triangles : m_Triangles)
+        {
+            for (const Triangle& triangle : triangles)
+            {
+                int32_t beginY = std::max(triangle.MinY, firstRow);
+                int32_t endY = std::min(triangle.MaxY + 1, lastRow);
+
+                // The groups of pixels start aligned, the extra pixels on the sides fail the edge tests
+                int32_t beginX = triangle.MinX / (int32_t)s_SimdWidth * (int32_t)s_SimdWidth;
+
+                for (int32_t y = beginY; y < endY; y++)
+                {
+                    double centerY = y + 0.5;
+                    float* row = &m_Depth[y * m_Stride];
+
+                    for (int32_t x = beginX; x <= triangle.MaxX; x += s_SimdWidth)
+                    {
+                        double centerX = x + 0.5;
+
+                        float edges[3];
+                        for (int k = 0; k < 3; k++)
+                        {
+                            edges[k] = static_cast<float>(triangle.EdgeA[k] * centerX + triangle.EdgeB[k] * centerY + triangle.EdgeC[k]);
+                        }
+                        float depth = static_cast<float>(triangle.DepthX * centerX + triangle.DepthY * centerY + triangle.DepthC);
+
+#if COFFEE_OCCLUSION_BUFFER_SSE
+                        const __m128 steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+                        __m128 covered = _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(edges[0]), _mm_mul_ps(_mm_set1_ps((float)triangle.EdgeA[0]), steps)), _mm_setzero_ps());
+                        covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(edges[1]), _mm_mul_ps(_mm_set1_ps((float)triangle.EdgeA[1]), steps)), _mm_setzero_ps()));
+                        covered = _mm_and_ps(covered, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(edges[2]), _mm_mul_ps(_mm_set1_ps((float)triangle.EdgeA[2]), steps)), _mm_setzero_ps()));
+
+                        if (_mm_movemask_ps(covered) == 0)
+                            continue;
+
+                        __m128 depths = _mm_add_ps(_mm_set1_ps(depth), _mm_mul_ps(_mm_set1_ps((float)triangle.DepthX), steps));
+                        __m128 stored = _mm_loadu_ps(row + x);
+                        __m128 nearest = _mm_min_ps(stored, depths);
+
+                        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(covered, nearest), _mm_andnot_ps(covered, stored)));
+#else
+                        for (uint32_t i = 0; i < s_SimdWidth; i++)
+                        {
+                            if (edges[0] + (float)triangle.EdgeA[0] * i >= 0.0f &&
+                                edges[1] + (float)triangle.EdgeA[1] * i >= 0.0f &&
+                                edges[2] + (float)triangle.EdgeA[2] * i >= 0.0f)
+                            {
+                                row[x + i] = std::min(row[x + i], depth + (float)triangle.DepthX * i);
+                            }
+                        }
+#endif
+                    }
+                }
+            }
+        }
+    }
+
+    bool OcclusionBuffer::IsVisible(const AABB& bounds) const
+    {
+        float minX = std::numeric_limits<float>::max(), minY = minX, minZ = minX;
+        float maxX = -minX, maxY = -minX;
+
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z);
+            glm::vec4 clip = m_ViewProjection * glm::vec4(corner, 1.0f);
+
+            // Boxes crossing the near plane are too close to be hidden
+            if (clip.z + clip.w < 0.0f || clip.w <= 0.0f)
+                return true;
+
+            float inverseW = 1.0f / clip.w;
+            float x = (clip.x * inverseW * 0.5f + 0.5f) * m_Width;
+            float y = (clip.y * inverseW * 0.5f + 0.5f) * m_Height;
+
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            minZ = std::min(minZ, clip.z * inverseW);
+        }
+
+        // Off screen boxes are left to the frustum culling
+        int32_t beginX = static_cast<int32_t>(std::max(std::floor(minX), 0.0f));
+        int32_t beginY = static_cast<int32_t>(std::max(std::floor(minY), 0.0f));
+        int32_t endX = static_cast<int32_t>(std::min(std::floor(maxX), (float)m_Width - 1.0f));
+        int32_t endY = static_cast<int32_t>(std::min(std::floor(maxY), (float)m_Height - 1.0f));
+
+        if (beginX > endX || beginY > endY)
+            return true;
+
+        // The box is hidden if every pixel it can touch has an occluder in front of its nearest point
+        for (int32_t y = beginY; y <= endY; y++)
+        {
+            const float* row = &m_Depth[y * m_Stride];
+
+#if COFFEE_OCCLUSION_BUFFER_SSE
+            __m128 nearest = _mm_set1_ps(minZ);
+            for (int32_t x = beginX; x <= endX; x += s_SimdWidth)
+            {
+                int32_t count = std::min<int32_t>(s_SimdWidth, endX - x + 1);
+                int laneMask = (1 << count) - 1;
+
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), nearest)) & laneMask)
+                    return true;
+            }
+#else
+            for (int32_t x = beginX; x <= endX; x++)
+            {
+                if (row[x] >= minZ)
+                    return true;
+            }
+#endif
+        }
+
+        return false;
+    }
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "CoffeeEngine/Math/BoundingBox.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @defgroup renderer Renderer
+     * @{
+     */
+
+    /**
+     * @brief Low resolution depth buffer rasterized on the CPU, used to cull the meshes hidden behind large occluders.
+     *
+     * Each frame the buffer is cleared with Begin, a few occluders are added and rasterized across the JobSystem
+     * workers, then the bounds of the candidate meshes are tested against it. The results are conservative: an
+     * occluder only writes the pixels it fully covers, with the farthest depth it has inside them, so a box reported
+     * as hidden is hidden at any resolution. It does not use the GPU, so it can run headless.
+     */
+    class OcclusionBuffer
+    {
+    public:
+        /**
+         * @brief Constructs an occlusion buffer.
+         * @param width The width of the depth buffer, in pixels.
+         * @param height The height of the depth buffer, in pixels.
+         */
+        OcclusionBuffer(uint32_t width = 256, uint32_t height = 128);
+
+        /**
+         * @brief Changes the resolution of the depth buffer, the contents are lost.
+         * @param width The width, in pixels.
+         * @param height The height, in pixels.
+         */
+        void Resize(uint32_t width, uint32_t height);
+
+        /**
+         * @brief Clears the depth and the occluders of the previous frame.
+         * @param viewProjection The projection * view matrix of the camera (OpenGL clip space).
+         */
+        void Begin(const glm::mat4& viewProjection);
+
+        /**
+         * @brief Queues a triangle mesh to be rasterized, the data must stay valid until Rasterize returns.
+         * @param transform The world transform of the mesh.
+         * @param positions The first vertex position.
+         * @param stride The distance in bytes between two vertex positions.
+         * @param indices The triangle list indices.
+         * @param indexCount The number of indices, three per triangle.
+         */
+        void AddOccluder(const glm::mat4& transform, const glm::vec3* positions, size_t stride, const uint32_t* indices, size_t indexCount);
+
+        /**
+         * @brief Rasterizes the queued occluders, the buffer is split in bands of rows across the worker threads.
+         */
+        void Rasterize();
+
+        /**
+         * @brief Tests a box against the rasterized occluders.
+         * @param bounds The box, in world space.
+         * @return False if the box is fully behind the occluders, true if it may be visible.
+         */
+        bool IsVisible(const AABB& bounds) const;
+
+        uint32_t GetWidth() const { return m_Width; }
+        uint32_t GetHeight() const { return m_Height; }
+
+        /**
+         * @brief Gets the depth of a pixel, the normalized device depth of the nearest occluder.
+         * @param x The column of the pixel.
+         * @param y The row of the pixel, from the bottom.
+         * @return The depth, or the largest float if no occluder covers the pixel.
+         */
+        float GetDepth(uint32_t x, uint32_t y) const { return m_Depth[y * m_Stride + x]; }
+
+        size_t GetOccluderCount() const { return m_Occluders.size(); }
+
+        /**
+         * @brief Gets the number of triangles that reached the rasterizer in the last Rasterize call.
+         * @return The number of triangles, after the near plane clipping and the off screen rejection.
+         */
+        size_t GetTriangleCount() const { return m_TriangleCount; }
+
+    private:
+        struct Occluder
+        {
+            glm::mat4 Transform;
+            const glm::vec3* Positions;
+            size_t Stride;
+            const uint32_t* Indices;
+            size_t IndexCount;
+        };
+
+        /**
+         * @brief A triangle ready to rasterize, in pixel coordinates.
+         */
+        struct Triangle
+        {
+            double EdgeA[3], EdgeB[3], EdgeC[3]; ///< Edge functions A*x + B*y + C, already shrunk by half a pixel.
+            double DepthX, DepthY, DepthC; ///< Depth plane, already raised to the farthest depth inside a pixel.
+            int32_t MinX, MinY, MaxX, MaxY; ///< The pixels of the bounding rectangle, inclusive.
+        };
+
+        void SetupOccluder(const Occluder& occluder, std::vector<Triangle>& triangles) const;
+        void SetupTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2, std::vector<Triangle>& triangles) const;
+        void RasterizeBand(int32_t firstRow, int32_t lastRow);
+
+        uint32_t m_Width = 0;
+        uint32_t m_Height = 0;
+        uint32_t m_Stride = 0; ///< The floats per row, the width rounded up to the SIMD width.
+        std::vector<float> m_Depth;
+
+        glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+        std::vector<Occluder> m_Occluders;
+        std::vector<std::vector<Triangle>> m_Triangles; ///< The triangles of each occluder, set up in parallel.
+        size_t m_TriangleCount = 0;
+
+        static constexpr uint32_t s_BandHeight = 8; ///< Rows rasterized by a single job.
+    };
+
+    /** @} */
+}
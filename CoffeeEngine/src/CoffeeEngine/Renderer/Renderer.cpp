@@ -7,6 +7,7 @@
 #include "CoffeeEngine/Renderer/Mesh.h"
 #include "CoffeeEngine/Renderer/RendererAPI.h"
 #include "CoffeeEngine/Renderer/Shader.h"
+#include "CoffeeEngine/Renderer/StorageBuffer.h"
 #include "CoffeeEngine/Renderer/Texture.h"
 #include "CoffeeEngine/Renderer/UniformBuffer.h"
 #include "CoffeeEngine/Renderer/TextRenderer.h"
@@ -18,13 +19,19 @@
 #include "CoffeeEngine/UI/UI Renderer.h"
 #include "CoffeeEngine/Scene/Entity.h"
 
+#include <algorithm>
+#include <bit>
 #include <cstdint>
 #include <glm/fwd.hpp>
 #include <glm/matrix.hpp>
 #include <tracy/Tracy.hpp>
+#include <unordered_map>
 
 namespace Coffee {
 
+    // The lights are uploaded as they are, their layout has to match the Light struct of the shaders
+    static_assert(sizeof(LightComponent) == 64, "LightComponent does not match the std140/std430 layout of the shaders");
+
     static bool s_viewportResized = false;
     static uint32_t s_viewportWidth = 0, s_viewportHeight = 0;
 
@@ -74,6 +81,10 @@ namespace Coffee {
         s_RendererData.CameraUniformBuffer = UniformBuffer::Create(sizeof(RendererData::CameraData), 0);
         s_RendererData.RenderDataUniformBuffer = UniformBuffer::Create(sizeof(RendererData::RenderData), 1);
 
+        s_RendererData.LightsStorageBuffer = StorageBuffer::Create(sizeof(LightComponent) * 64, 2);
+        s_RendererData.ClustersStorageBuffer = StorageBuffer::Create(sizeof(glm::uvec2) * 16 * 9 * 24, 3);
+        s_RendererData.LightIndicesStorageBuffer = StorageBuffer::Create(sizeof(uint32_t) * 1024, 4);
+
         Ref<Shader> missingShader = CreateRef<Shader>("MissingShader", std::string(missingShaderSource));
         s_RendererData.DefaultMaterial = CreateRef<Material>("Missing Material", missingShader); //TODO: Port it to use the Material::Create
 
@@ -101,6 +112,12 @@ namespace Coffee {
         s_Stats.DrawCalls = 0;
         s_Stats.VertexCount = 0;
         s_Stats.IndexCount = 0;
+        s_Stats.TriangleCount = 0;
+        s_Stats.FullDetailTriangleCount = 0;
+        s_Stats.MaterialChanges = 0;
+        s_Stats.ShaderChanges = 0;
+        s_Stats.VisibilityCacheHits = 0;
+        s_Stats.VisibilityCacheMisses = 0;
 
         //I think if a render queue is implemented this is not necessary. The OnResize would work.
         if(s_viewportResized)
@@ -114,7 +131,8 @@ namespace Coffee {
         s_RendererData.cameraData.position = camera.GetPosition();
         s_RendererData.CameraUniformBuffer->SetData(&s_RendererData.cameraData, sizeof(RendererData::CameraData));
 
-        s_RendererData.renderData.lightCount = 0;
+        s_RendererData.renderData.directionalLightCount = 0;
+        s_RendererData.lights.clear();
     }
 
     void Renderer::BeginScene(Camera& camera, const glm::mat4& transform)
@@ -122,6 +140,12 @@ namespace Coffee {
         s_Stats.DrawCalls = 0;
         s_Stats.VertexCount = 0;
         s_Stats.IndexCount = 0;
+        s_Stats.TriangleCount = 0;
+        s_Stats.FullDetailTriangleCount = 0;
+        s_Stats.MaterialChanges = 0;
+        s_Stats.ShaderChanges = 0;
+        s_Stats.VisibilityCacheHits = 0;
+        s_Stats.VisibilityCacheMisses = 0;
 
         // This resize the camera to the viewport size. Think how to manage this in a better way :p
         camera.SetViewportSize(s_viewportWidth, s_viewportHeight);
@@ -131,7 +155,8 @@ namespace Coffee {
         s_RendererData.cameraData.position = transform[3];
         s_RendererData.CameraUniformBuffer->SetData(&s_RendererData.cameraData, sizeof(RendererData::CameraData));
 
-        s_RendererData.renderData.lightCount = 0;
+        s_RendererData.renderData.directionalLightCount = 0;
+        s_RendererData.lights.clear();
     }
 
     void Renderer::EndScene()
@@ -151,11 +176,17 @@ namespace Coffee {
 
         s_EntityIDTexture->Clear({-1.0f, 0.0f, 0.0f, 0.0f});
 
+        UpdateLightClusters();
         s_RendererData.RenderDataUniformBuffer->SetData(&s_RendererData.renderData, sizeof(RendererData::RenderData));
 
-        // Ordenar la cola de renderizado para minimizar cambios de estado
-        for (const auto& command : s_RendererData.renderQueue)
+        SortRenderQueue();
+
+        // Consecutive commands with the same material keep its shader, textures and uniforms bound
+        Material* boundMaterial = nullptr;
+        Shader* boundShader = nullptr;
+        for (const auto& [key, index] : s_RendererData.sortedQueue)
         {
+            const RenderCommand& command = s_RendererData.renderQueue[index];
             Material* material = command.material.get();
 
             if (material == nullptr)
@@ -163,10 +194,20 @@ namespace Coffee {
                 material = s_RendererData.DefaultMaterial.get();
             }
 
-            material->Use();
             const Ref<Shader>& shader = material->GetShader();
+            if (material != boundMaterial)
+            {
+                material->Use();
+                boundMaterial = material;
+                s_Stats.MaterialChanges++;
+
+                if (shader.get() != boundShader)
+                {
+                    boundShader = shader.get();
+                    s_Stats.ShaderChanges++;
+                }
+            }
 
-            shader->Bind();
             shader->setMat4("model", command.transform);
             shader->setMat3("normalMatrix", glm::transpose(glm::inverse(glm::mat3(command.transform))));
             shader->setBool("showNormals", s_RenderSettings.showNormals);
@@ -178,11 +219,16 @@ namespace Coffee {
             glm::vec3 entityIDVec3 = glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);
 
             shader->setVec3("entityID", entityIDVec3);
-            RendererAPI::DrawIndexed(command.mesh->GetVertexArray());
 
+            uint32_t lod = command.lod ? SelectLOD(command) : 0;
+            RendererAPI::DrawIndexed(command.mesh->GetVertexArray(lod));
+
+            uint32_t indexCount = command.mesh->GetIndexCount(lod);
             s_Stats.DrawCalls++;
             s_Stats.VertexCount += command.mesh->GetVertices().size();
-            s_Stats.IndexCount += command.mesh->GetIndices().size();
+            s_Stats.IndexCount += indexCount;
+            s_Stats.TriangleCount += indexCount / 3;
+            s_Stats.FullDetailTriangleCount += command.mesh->GetIndices().size() / 3;
         }
 
         // Dibujar Skybox
@@ -227,6 +273,7 @@ namespace Coffee {
         s_RendererData.RenderTexture = s_MainRenderTexture;
         s_MainFramebuffer->UnBind();
         s_RendererData.renderQueue.clear();
+        s_RendererData.sortedQueue.clear();
     }
 
     //TEMPORAL
@@ -247,8 +294,133 @@ namespace Coffee {
 
     void Renderer::Submit(const LightComponent& light)
     {
-        s_RendererData.renderData.lights[s_RendererData.renderData.lightCount] = light;
-        s_RendererData.renderData.lightCount++;
+        if (light.type == LightComponent::Type::DirectionalLight)
+        {
+            RendererData::RenderData& renderData = s_RendererData.renderData;
+            if (renderData.directionalLightCount < RendererData::RenderData::MaxDirectionalLights)
+            {
+                renderData.directionalLights[renderData.directionalLightCount++] = light;
+            }
+            return;
+        }
+
+        s_RendererData.lights.push_back(light);
+    }
+
+    void Renderer::UpdateLightClusters()
+    {
+        ZoneScoped;
+
+        LightClusters& lightClusters = s_RendererData.lightClusters;
+        lightClusters.Build(s_RendererData.lights, s_RendererData.cameraData.view, s_RendererData.cameraData.projection);
+
+        RendererData::RenderData& renderData = s_RendererData.renderData;
+        renderData.clusterGrid = glm::uvec4(lightClusters.GetGridSize(), lightClusters.IsLogarithmic() ? 1 : 0);
+        renderData.clusterDepth = glm::vec4(lightClusters.GetDepthScaleBias(), s_MainFramebuffer->GetWidth(), s_MainFramebuffer->GetHeight());
+
+        const auto& lights = s_RendererData.lights;
+        const auto& clusters = lightClusters.GetClusters();
+        const auto& lightIndices = lightClusters.GetLightIndices();
+        s_RendererData.LightsStorageBuffer->SetData(lights.data(), static_cast<uint32_t>(lights.size() * sizeof(LightComponent)));
+        s_RendererData.ClustersStorageBuffer->SetData(clusters.data(), static_cast<uint32_t>(clusters.size() * sizeof(glm::uvec2)));
+        s_RendererData.LightIndicesStorageBuffer->SetData(lightIndices.data(), static_cast<uint32_t>(lightIndices.size() * sizeof(uint32_t)));
+
+        s_Stats.LightCount = static_cast<uint32_t>(lights.size());
+        s_Stats.MaxClusterLightCount = lightClusters.GetMaxClusterLightCount();
+    }
+
+    uint32_t Renderer::SelectLOD(const RenderCommand& command)
+    {
+        return command.lod->SelectLevel(command.mesh->GetAABB(), command.transform, s_RendererData.cameraData.projection,
+                                        s_RendererData.cameraData.position, command.mesh->GetLODCount());
+    }
+
+    // Stable least significant digit radix sort of the keys, 8 bits per pass
+    static void RadixSortKeys(std::vector<std::pair<uint64_t, uint32_t>>& keys)
+    {
+        if (keys.size() < 2)
+            return;
+
+        std::vector<std::pair<uint64_t, uint32_t>> buffer(keys.size());
+
+        for (uint32_t shift = 0; shift < 64; shift += 8)
+        {
+            uint32_t offsets[257] = {};
+            for (const auto& key : keys)
+            {
+                offsets[((key.first >> shift) & 0xFF) + 1]++;
+            }
+
+            // All the keys have the same digit, the pass would not move anything
+            if (offsets[((keys[0].first >> shift) & 0xFF) + 1] == keys.size())
+                continue;
+
+            for (uint32_t digit = 1; digit < 257; digit++)
+            {
+                offsets[digit] += offsets[digit - 1];
+            }
+
+            for (const auto& key : keys)
+            {
+                buffer[offsets[(key.first >> shift) & 0xFF]++] = key;
+            }
+
+            keys.swap(buffer);
+        }
+    }
+
+    void Renderer::SortRenderQueue()
+    {
+        ZoneScoped;
+
+        // Opaque keys:      pass (2) | shader (12) | material (16) | mesh (14) | depth (20)
+        // Transparent keys: pass (2) | inverted depth (20) | shader (12) | material (16) | mesh (14)
+        constexpr uint64_t OpaquePass = 0, TransparentPass = 1;
+        constexpr uint32_t MaxShader = (1 << 12) - 1, MaxMaterial = (1 << 16) - 1, MaxMesh = (1 << 14) - 1, MaxDepth = (1 << 20) - 1;
+
+        // The states are numbered in the order they are first submitted. Past the size of their field they share the
+        // last number, which only breaks up their grouping
+        std::unordered_map<const void*, uint32_t> shaderIDs, materialIDs, meshIDs;
+        auto getID = [](std::unordered_map<const void*, uint32_t>& ids, const void* state, uint32_t maxID) -> uint64_t {
+            auto [it, inserted] = ids.try_emplace(state, static_cast<uint32_t>(ids.size()));
+            return std::min(it->second, maxID);
+        };
+
+        const glm::mat4& view = s_RendererData.cameraData.view;
+        auto& sortedQueue = s_RendererData.sortedQueue;
+        sortedQueue.clear();
+        sortedQueue.reserve(s_RendererData.renderQueue.size());
+
+        for (uint32_t i = 0; i < s_RendererData.renderQueue.size(); i++)
+        {
+            const RenderCommand& command = s_RendererData.renderQueue[i];
+            Material* material = command.material ? command.material.get() : s_RendererData.DefaultMaterial.get();
+
+            uint64_t shader = getID(shaderIDs, material->GetShader().get(), MaxShader);
+            uint64_t materialID = getID(materialIDs, material, MaxMaterial);
+            uint64_t mesh = getID(meshIDs, command.mesh.get(), MaxMesh);
+
+            // The view depth of the center of the mesh. The bits of a positive float grow with its value, the 20 bits
+            // below the sign keep the exponent and 12 bits of mantissa
+            const AABB& aabb = command.mesh->GetAABB();
+            glm::vec4 center = view * command.transform * glm::vec4((aabb.min + aabb.max) * 0.5f, 1.0f);
+            float depth = std::max(-center.z, 0.0f);
+            uint64_t depthBits = std::min(std::bit_cast<uint32_t>(depth) >> 11, MaxDepth);
+
+            uint64_t key;
+            if (material->GetMaterialProperties().color.a < 1.0f)
+            {
+                key = TransparentPass << 62 | (MaxDepth - depthBits) << 42 | shader << 30 | materialID << 14 | mesh;
+            }
+            else
+            {
+                key = OpaquePass << 62 | shader << 50 | materialID << 34 | mesh << 20 | depthBits;
+            }
+
+            sortedQueue.emplace_back(key, i);
+        }
+
+        RadixSortKeys(sortedQueue);
     }
 
     void Renderer::Submit(const RenderCommand& command)
@@ -3,15 +3,18 @@
 #include "CoffeeEngine/Core/Base.h"
 #include "CoffeeEngine/Renderer/EditorCamera.h"
 #include "CoffeeEngine/Renderer/Framebuffer.h"
+#include "CoffeeEngine/Renderer/LightClusters.h"
 #include "CoffeeEngine/Renderer/Material.h"
 #include "CoffeeEngine/Renderer/Mesh.h"
 #include "CoffeeEngine/Renderer/Shader.h"
+#include "CoffeeEngine/Renderer/StorageBuffer.h"
 #include "CoffeeEngine/Renderer/Texture.h"
 #include "CoffeeEngine/Renderer/UniformBuffer.h"
 #include "CoffeeEngine/Renderer/VertexArray.h"
 #include "CoffeeEngine/Scene/Components.h"
 #include "CoffeeEngine/Scene/Entity.h"
 #include <glm/fwd.hpp>
+#include <optional>
 
 namespace Coffee {
 
@@ -28,6 +31,7 @@ namespace Coffee {
         Ref<Material> material;
         uint32_t entityID;
         Entity entity;
+        std::optional<LODComponent> lod; ///< The level of detail settings, the full detail mesh is drawn without them.
     };
 
     /**
@@ -47,11 +51,17 @@ namespace Coffee {
 
         /**
          * @brief Structure containing render data.
+         *
+         * The point and spot lights are not here, they are uploaded to storage buffers with their cluster lists.
          */
         struct RenderData
         {
-            LightComponent lights[32]; ///< Array of light components.
-            int lightCount = 0; ///< Number of lights.
+            static constexpr int MaxDirectionalLights = 8; ///< Further directional lights are ignored.
+
+            LightComponent directionalLights[MaxDirectionalLights]; ///< Lights that reach every pixel.
+            int directionalLightCount = 0; ///< Number of directional lights.
+            alignas(16) glm::uvec4 clusterGrid = glm::uvec4(0); ///< Clusters along x, y and z, w is 1 for logarithmic depth slices.
+            glm::vec4 clusterDepth = glm::vec4(0.0f); ///< Scale and bias from view depth to depth slice (x, y), viewport size (z, w).
         };
 
         CameraData cameraData; ///< Camera data.
@@ -60,11 +70,18 @@ namespace Coffee {
         Ref<UniformBuffer> CameraUniformBuffer; ///< Uniform buffer for camera data.
         Ref<UniformBuffer> RenderDataUniformBuffer; ///< Uniform buffer for render data.
 
+        std::vector<LightComponent> lights; ///< Point and spot lights of the frame.
+        LightClusters lightClusters; ///< Assignment of the lights to the clusters of the view frustum.
+        Ref<StorageBuffer> LightsStorageBuffer; ///< Storage buffer for the point and spot lights.
+        Ref<StorageBuffer> ClustersStorageBuffer; ///< Storage buffer for the light list offset and size of each cluster.
+        Ref<StorageBuffer> LightIndicesStorageBuffer; ///< Storage buffer for the light lists of the clusters.
+
         Ref<Material> DefaultMaterial; ///< Default material.
 
         Ref<Texture2D> RenderTexture; ///< Render texture.
 
         std::vector<RenderCommand> renderQueue; ///< Render queue.
+        std::vector<std::pair<uint64_t, uint32_t>> sortedQueue; ///< Sort key and render queue index of each command, in draw order.
     };
 
     /**
@@ -75,6 +92,14 @@ namespace Coffee {
         uint32_t DrawCalls = 0; ///< Number of draw calls.
         uint32_t VertexCount = 0; ///< Number of vertices.
         uint32_t IndexCount = 0; ///< Number of indices.
+        uint32_t TriangleCount = 0; ///< Number of mesh triangles drawn.
+        uint32_t FullDetailTriangleCount = 0; ///< Number of mesh triangles that would be drawn without the levels of detail.
+        uint32_t LightCount = 0; ///< Number of point and spot lights.
+        uint32_t MaxClusterLightCount = 0; ///< Most lights shaded by a single cluster.
+        uint32_t MaterialChanges = 0; ///< Number of materials bound for the render queue.
+        uint32_t ShaderChanges = 0; ///< Number of shaders bound for the render queue.
+        uint32_t VisibilityCacheHits = 0; ///< Octree nodes classified from the previous frame.
+        uint32_t VisibilityCacheMisses = 0; ///< Octree nodes tested against the frustum planes.
     };
 
     /**
@@ -143,6 +168,10 @@ namespace Coffee {
 
         /**
          * @brief Submits a light component.
+         *
+         * Point and spot lights are assigned to the clusters they reach, their count is only limited by the memory.
+         * Directional lights are shaded on every pixel, past RenderData::MaxDirectionalLights they are ignored.
+         *
          * @param light The light component.
          */
 
@@ -195,10 +224,41 @@ namespace Coffee {
          */
         static RenderSettings& GetRenderSettings() { return s_RenderSettings; }
 
+        /**
+         * @brief Reports the visibility cache statistics of the spatial query of the frame.
+         * @param hits The nodes classified from the previous frame.
+         * @param misses The nodes tested against the frustum planes.
+         */
+        static void SetVisibilityCacheStats(uint32_t hits, uint32_t misses)
+        {
+            s_Stats.VisibilityCacheHits = hits;
+            s_Stats.VisibilityCacheMisses = misses;
+        }
+
     private:
 
         static void ResizeFramebuffers();
 
+        /**
+         * @brief Assigns the submitted lights to the clusters of the camera and uploads the lights and the cluster lists.
+         */
+        static void UpdateLightClusters();
+
+        /**
+         * @brief Selects the level of detail of a mesh from the size it has on the screen.
+         * @param command The render command, with its level of detail settings.
+         * @return The level to draw, 0 is the full detail mesh.
+         */
+        static uint32_t SelectLOD(const RenderCommand& command);
+
+        /**
+         * @brief Sorts the render queue into RendererData::sortedQueue to minimize the state changes.
+         *
+         * Each command gets a 64 bit key. Opaque commands come first, grouped by shader, material and mesh and then
+         * front to back, transparent commands (material alpha below one) come last, back to front.
+         */
+        static void SortRenderQueue();
+
     private:
         static RendererData s_RendererData; ///< Renderer data.
         static RendererStats s_Stats; ///< Renderer statistics.
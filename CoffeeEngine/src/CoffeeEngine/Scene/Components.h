@@ -7,12 +7,14 @@
 
 #include "CoffeeEngine/Core/Base.h"
 #include "CoffeeEngine/IO/ResourceRegistry.h"
+#include "CoffeeEngine/Math/AffineTransform.h"
 #include "CoffeeEngine/Renderer/Material.h"
 #include "CoffeeEngine/Renderer/Mesh.h"
 #include "CoffeeEngine/Renderer/Model.h"
 #include "CoffeeEngine/Scene/SceneCamera.h"
 #include <cereal/cereal.hpp>
 #include <cereal/access.hpp>
+#include <cereal/types/array.hpp>
 #include <cereal/types/string.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/fwd.hpp>
@@ -21,6 +23,8 @@
 #include "src/CoffeeEngine/IO/Serialization/GLMSerialization.h"
 #include "CoffeeEngine/IO/ResourceLoader.h"
 #include "string"
+#include <algorithm>
+#include <array>
 
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -58,6 +62,15 @@ namespace Coffee
     {
       private:
         glm::mat4 worldMatrix = glm::mat4(1.0f); ///< The world transformation matrix.
+        Affine3x4 localMatrix; ///< The cached local transformation matrix.
+
+        // Values the cached local matrix was built from, used to detect direct writes to Position/Rotation/Scale.
+        glm::vec3 cachedPosition = {0.0f, 0.0f, 0.0f};
+        glm::vec3 cachedRotation = {0.0f, 0.0f, 0.0f};
+        glm::vec3 cachedScale = {1.0f, 1.0f, 1.0f};
+        glm::quat cachedOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); ///< The Rotation euler angles as a quaternion.
+
+        bool dirty = true; ///< Forces a world matrix update even if the local values did not change (e.g. reparenting).
       public:
         glm::vec3 Position = {0.0f, 0.0f, 0.0f}; ///< The position vector.
         glm::vec3 Rotation = {0.0f, 0.0f, 0.0f}; ///< The rotation vector.
@@ -78,6 +91,28 @@ namespace Coffee
             return glm::translate(glm::mat4(1.0f), Position) * rotation * glm::scale(glm::mat4(1.0f), Scale);
         }
 
+        /**
+         * @brief Gets the local transformation in its compact affine form, rebuilding the cache if needed.
+         * @return The local affine transformation.
+         */
+        const Affine3x4& GetLocalAffineTransform()
+        {
+            if (IsLocalTransformChanged())
+            {
+                if (Rotation != cachedRotation)
+                {
+                    cachedOrientation = glm::quat(glm::radians(Rotation));
+                    cachedRotation = Rotation;
+                }
+
+                localMatrix = Affine3x4::FromTRS(Position, cachedOrientation, Scale);
+                cachedPosition = Position;
+                cachedScale = Scale;
+            }
+
+            return localMatrix;
+        }
+
         /**
          * @brief Sets the local transformation matrix.
          * @param transform The transformation matrix to set.
@@ -101,10 +136,45 @@ namespace Coffee
         const glm::mat4& GetWorldTransform() const { return worldMatrix; }
 
         /**
-         * @brief Sets the world transformation matrix.
-         * @param transform The transformation matrix to set.
+         * @brief Sets the world transformation matrix, composing the local transform with 4x4 matrices.
+         * @param transform The parent world transformation matrix.
+         */
+        void SetWorldTransform(const glm::mat4& transform)
+        {
+            glm::quat orientation = glm::quat(glm::radians(Rotation));
+            glm::mat4 localTransform = glm::translate(glm::mat4(1.0f), Position) * glm::toMat4(orientation) * glm::scale(glm::mat4(1.0f), Scale);
+
+            worldMatrix = transform * localTransform;
+
+            // Keep the affine cache in sync, otherwise the transform would look changed on every update
+            localMatrix = Affine3x4::FromMat4(localTransform);
+            cachedOrientation = orientation;
+            cachedPosition = Position;
+            cachedRotation = Rotation;
+            cachedScale = Scale;
+            dirty = false;
+        }
+
+        /**
+         * @brief Sets the already composed world transformation.
+         * @param transform The world affine transformation.
+         */
+        void SetWorldAffineTransform(const Affine3x4& transform)
+        {
+            worldMatrix = transform.ToMat4();
+            dirty = false;
+        }
+
+        /**
+         * @brief Flags the transform so the world matrix is recalculated on the next scene tree update.
+         */
+        void MarkDirty() { dirty = true; }
+
+        /**
+         * @brief Checks if the world matrix of this transform is out of date.
+         * @return True if the transform was flagged or its local values changed since the last update.
          */
-        void SetWorldTransform(const glm::mat4& transform) { worldMatrix = transform * GetLocalTransform(); }
+        bool IsDirty() const { return dirty || IsLocalTransformChanged(); }
 
         /**
          * @brief Serializes the TransformComponent.
@@ -116,6 +186,12 @@ namespace Coffee
             archive(cereal::make_nvp("Position", Position), cereal::make_nvp("Rotation", Rotation),
                     cereal::make_nvp("Scale", Scale));
         }
+
+      private:
+        bool IsLocalTransformChanged() const
+        {
+            return Position != cachedPosition || Rotation != cachedRotation || Scale != cachedScale;
+        }
     };
 
     /**
@@ -183,6 +259,138 @@ namespace Coffee
         }
     };
 
+    /**
+     * @brief Component caching the world space bounds of a mesh.
+     *
+     * The scene updates it only when the transform or the mesh of the entity changes, the culling and debug code
+     * reads it instead of transforming the mesh bounds again. It is derived data, so it is not serialized.
+     * @ingroup scene
+     */
+    struct WorldBoundsComponent
+    {
+        AABB Bounds; ///< The bounds of the mesh in world space.
+
+        WorldBoundsComponent() = default;
+        WorldBoundsComponent(const WorldBoundsComponent&) = default;
+        WorldBoundsComponent(const AABB& bounds) : Bounds(bounds) {}
+    };
+
+    /**
+     * @brief Component marking a mesh as an occluder for the CPU occlusion culling.
+     *
+     * Occluders are rasterized into the occlusion buffer every frame, the meshes fully hidden behind them are not
+     * submitted. Large walls, floors and buildings make good occluders.
+     * @ingroup scene
+     */
+    struct OccluderComponent
+    {
+        Ref<Mesh> OccluderMesh; ///< Simplified geometry rasterized instead of the mesh of the entity, optional.
+
+        OccluderComponent() = default;
+        OccluderComponent(const OccluderComponent&) = default;
+        OccluderComponent(Ref<Mesh> occluderMesh) : OccluderMesh(occluderMesh) {}
+
+      private:
+        friend class cereal::access;
+        /**
+         * @brief Serializes the OccluderComponent.
+         * @tparam Archive The type of the archive.
+         * @param archive The archive to serialize to.
+         */
+        template <class Archive> void save(Archive& archive) const
+        {
+            archive(cereal::make_nvp("OccluderMesh", OccluderMesh ? OccluderMesh->GetUUID() : UUID::null));
+        }
+
+        template <class Archive> void load(Archive& archive)
+        {
+            UUID occluderMeshUUID;
+            archive(cereal::make_nvp("OccluderMesh", occluderMeshUUID));
+
+            OccluderMesh = occluderMeshUUID != UUID::null ? ResourceRegistry::Get<Mesh>(occluderMeshUUID) : nullptr;
+        }
+    };
+
+    /**
+     * @brief Component drawing the simplified levels of detail of a mesh when it looks small on the screen.
+     *
+     * The renderer projects the bounding sphere of the mesh and measures it as a fraction of the screen height, level
+     * i + 1 is drawn when it is smaller than ScreenSizes[i]. The levels are generated when the mesh is imported.
+     * @ingroup scene
+     */
+    struct LODComponent
+    {
+        static constexpr uint32_t MaxLevels = 4; ///< The simplified levels that can be selected.
+
+        std::array<float, MaxLevels> ScreenSizes = {0.5f, 0.25f, 0.125f, 0.0625f}; ///< The screen size below which each level is drawn, decreasing.
+        float Bias = 1.0f; ///< Scales the screen size, above 1 the detailed levels are kept longer.
+        int ForcedLevel = -1; ///< Level drawn whatever the screen size, -1 to select it from the screen size.
+
+        LODComponent() = default;
+        LODComponent(const LODComponent&) = default;
+
+        /**
+         * @brief Selects the level to draw from the size of a mesh on the screen.
+         * @param aabb The local bounds of the mesh.
+         * @param transform The world transform of the mesh.
+         * @param projection The projection of the camera.
+         * @param cameraPosition The position of the camera.
+         * @param levelCount The number of levels of the mesh, counting the full detail one.
+         * @return The level to draw, 0 is the full detail mesh.
+         */
+        uint32_t SelectLevel(const AABB& aabb, const glm::mat4& transform, const glm::mat4& projection,
+                             const glm::vec3& cameraPosition, uint32_t levelCount) const
+        {
+            uint32_t lastLevel = std::min(levelCount - 1, MaxLevels);
+
+            if (ForcedLevel >= 0)
+                return std::min(static_cast<uint32_t>(ForcedLevel), lastLevel);
+
+            if (lastLevel == 0)
+                return 0;
+
+            // The bounding sphere of the mesh in world space
+            glm::vec3 center = glm::vec3(transform * glm::vec4((aabb.min + aabb.max) * 0.5f, 1.0f));
+            float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                    glm::length(glm::vec3(transform[2]))});
+            float radius = glm::length(aabb.max - aabb.min) * 0.5f * scale;
+
+            // The fraction of the screen height covered by the sphere. projection[1][1] is 1 / tan(fov / 2) for a
+            // perspective camera and 2 / height for an orthographic one, whose projection[3][3] is 1
+            float screenSize = radius * projection[1][1] * Bias;
+
+            if (projection[3][3] == 0.0f)
+            {
+                float distance = glm::length(center - cameraPosition);
+                if (distance <= radius)
+                    return 0;
+
+                screenSize /= distance;
+            }
+
+            uint32_t level = 0;
+            while (level < lastLevel && screenSize < ScreenSizes[level])
+            {
+                level++;
+            }
+
+            return level;
+        }
+
+      private:
+        friend class cereal::access;
+        /**
+         * @brief Serializes the LODComponent.
+         * @tparam Archive The type of the archive.
+         * @param archive The archive to serialize to.
+         */
+        template <class Archive> void serialize(Archive& archive)
+        {
+            archive(cereal::make_nvp("ScreenSizes", ScreenSizes), cereal::make_nvp("Bias", Bias),
+                    cereal::make_nvp("ForcedLevel", ForcedLevel));
+        }
+    };
+
     /**
      * @brief Component representing a material.
      * @ingroup scene
@@ -0,0 +1,92 @@
+#include "EntityCommandBuffer.h"
+#include "CoffeeEngine/Scene/Entity.h"
+#include "CoffeeEngine/Scene/Scene.h"
+#include "CoffeeEngine/Scene/SceneTree.h"
+
+#include <algorithm>
+#include <tuple>
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    void EntityCommandBuffer::Playback(Scene& scene)
+    {
+        ZoneScoped;
+
+        std::vector<Command> commands;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            commands.swap(m_Commands);
+        }
+
+        if(commands.empty())
+            return;
+
+        // The commands are played back in recording order. Creating, reparenting and destroying entities can change
+        // what any later command sees, but a run of component commands only depends on itself for the same entity and
+        // component, so each run is grouped by component pool keeping the recording order inside each pool
+        auto isComponentCommand = [](const Command& command) {
+            return command.Type == CommandType::AddComponent || command.Type == CommandType::RemoveComponent;
+        };
+
+        for(auto run = commands.begin(); run != commands.end();)
+        {
+            auto runEnd = std::find_if_not(run, commands.end(), isComponentCommand);
+            std::sort(run, runEnd, [](const Command& a, const Command& b) {
+                return std::tie(a.ComponentType, a.Sequence) < std::tie(b.ComponentType, b.Sequence);
+            });
+            run = runEnd == commands.end() ? runEnd : runEnd + 1;
+        }
+
+        auto& registry = scene.m_Registry;
+
+        for(auto& command : commands)
+        {
+            switch(command.Type)
+            {
+                case CommandType::Create:
+                {
+                    Entity entity = scene.CreateEntity(command.Name);
+
+                    if(command.Target != entt::null && registry.valid(command.Target))
+                    {
+                        HierarchyComponent::Reparent(registry, entity, command.Target);
+                    }
+
+                    if(command.OnCreated)
+                    {
+                        command.OnCreated(entity);
+                    }
+                    break;
+                }
+                case CommandType::AddComponent:
+                case CommandType::RemoveComponent:
+                {
+                    if(registry.valid(command.Target))
+                    {
+                        command.Apply(registry, command.Target);
+                    }
+                    break;
+                }
+                case CommandType::Reparent:
+                {
+                    bool isParentValid = command.Parent == entt::null || registry.valid(command.Parent);
+                    if(registry.valid(command.Target) && isParentValid)
+                    {
+                        HierarchyComponent::Reparent(registry, command.Target, command.Parent);
+                    }
+                    break;
+                }
+                case CommandType::Destroy:
+                {
+                    if(registry.valid(command.Target))
+                    {
+                        scene.DestroyEntity(Entity{command.Target, &scene});
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+}
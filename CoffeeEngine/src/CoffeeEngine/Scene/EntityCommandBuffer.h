@@ -0,0 +1,168 @@
+#pragma once
+
+#include "entt/entity/fwd.hpp"
+
+#include <entt/entt.hpp>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @defgroup scene Scene
+     * @{
+     */
+
+    class Entity;
+    class Scene;
+
+    /**
+     * @brief Records structural changes of a scene to apply them later at a sync point.
+     *
+     * Creating or destroying entities and adding or removing components while a view is being iterated can
+     * invalidate the pools. The commands are recorded instead (from any thread) and played back in one batch, in
+     * recording order. Consecutive component commands are independent of each other except on the same entity and
+     * component, so each run of them is grouped by component type to touch each pool once.
+     * @ingroup scene
+     */
+    class EntityCommandBuffer
+    {
+    public:
+        /**
+         * @brief Record the creation of an entity.
+         * @param name The name of the entity.
+         * @param parent The parent of the entity, or a null entity.
+         * @param onCreated Called during the playback with the created entity, e.g. to add components to it.
+         */
+        void CreateEntity(const std::string& name, entt::entity parent = entt::null, std::function<void(Entity)> onCreated = {})
+        {
+            Command command;
+            command.Type = CommandType::Create;
+            command.Target = parent;
+            command.Name = name;
+            command.OnCreated = std::move(onCreated);
+            Record(std::move(command));
+        }
+
+        /**
+         * @brief Record the destruction of an entity and all its children.
+         * @param entity The entity to destroy.
+         */
+        void DestroyEntity(entt::entity entity)
+        {
+            Command command;
+            command.Type = CommandType::Destroy;
+            command.Target = entity;
+            Record(std::move(command));
+        }
+
+        /**
+         * @brief Record the addition of a component, it replaces the component if the entity already has it.
+         * @tparam T The component type.
+         * @param entity The entity.
+         * @param component The component to add.
+         */
+        template<typename T>
+        void AddComponent(entt::entity entity, T component = T())
+        {
+            Command command;
+            command.Type = CommandType::AddComponent;
+            command.ComponentType = entt::type_hash<T>::value();
+            command.Target = entity;
+            command.Apply = [component = std::move(component)](entt::registry& registry, entt::entity entity) mutable {
+                registry.emplace_or_replace<T>(entity, std::move(component));
+            };
+            Record(std::move(command));
+        }
+
+        /**
+         * @brief Record the removal of a component.
+         * @tparam T The component type.
+         * @param entity The entity.
+         */
+        template<typename T>
+        void RemoveComponent(entt::entity entity)
+        {
+            Command command;
+            command.Type = CommandType::RemoveComponent;
+            command.ComponentType = entt::type_hash<T>::value();
+            command.Target = entity;
+            command.Apply = [](entt::registry& registry, entt::entity entity) {
+                registry.remove<T>(entity);
+            };
+            Record(std::move(command));
+        }
+
+        /**
+         * @brief Record a change of parent.
+         * @param entity The entity.
+         * @param parent The new parent, or a null entity to make it a root.
+         */
+        void Reparent(entt::entity entity, entt::entity parent)
+        {
+            Command command;
+            command.Type = CommandType::Reparent;
+            command.Target = entity;
+            command.Parent = parent;
+            Record(std::move(command));
+        }
+
+        /**
+         * @brief Apply all the recorded commands to the scene and clear the buffer.
+         *
+         * Must be called from the main thread while no view of the scene is being iterated.
+         *
+         * @param scene The scene to apply the commands to.
+         */
+        void Playback(Scene& scene);
+
+        /**
+         * @brief Check if there are commands waiting for the playback.
+         * @return True if the buffer is empty.
+         */
+        bool IsEmpty() const
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            return m_Commands.empty();
+        }
+
+    private:
+        enum class CommandType : uint8_t
+        {
+            Create,
+            AddComponent,
+            RemoveComponent,
+            Reparent,
+            Destroy
+        };
+
+        struct Command
+        {
+            CommandType Type = CommandType::Create;
+            uint32_t ComponentType = 0; ///< Hash of the component type, groups the commands of the same pool.
+            uint64_t Sequence = 0; ///< Recording order, the order of the playback.
+            entt::entity Target = entt::null; ///< The target entity, the parent for Create commands.
+            entt::entity Parent = entt::null; ///< The new parent for Reparent commands.
+            std::string Name; ///< The name for Create commands.
+            std::function<void(Entity)> OnCreated; ///< The callback for Create commands.
+            std::function<void(entt::registry&, entt::entity)> Apply; ///< The component operation.
+        };
+
+        void Record(Command&& command)
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            command.Sequence = m_NextSequence++;
+            m_Commands.push_back(std::move(command));
+        }
+
+    private:
+        mutable std::mutex m_Mutex;
+        std::vector<Command> m_Commands;
+        uint64_t m_NextSequence = 0;
+    };
+
+    /** @} */ // end of scene group
+}
@@ -1,6 +1,7 @@
 #include "Scene.h"
 
 #include "CoffeeEngine/Core/Base.h"
+#include "CoffeeEngine/Core/JobSystem.h"
 #include "CoffeeEngine/Core/DataStructures/Octree.h"
 #include "CoffeeEngine/Math/Frustum.h"
 #include "CoffeeEngine/Renderer/DebugRenderer.h"
@@ -12,6 +13,8 @@
 #include "CoffeeEngine/Scene/Entity.h"
 #include "CoffeeEngine/Scene/PrimitiveMesh.h"
 #include "CoffeeEngine/Scene/SceneCamera.h"
+#include "CoffeeEngine/Scene/SceneFormat.h"
+#include "CoffeeEngine/Scene/SceneLoader.h"
 #include "CoffeeEngine/Scene/SceneTree.h"
 #include "CoffeeEngine/Scripting/Lua/LuaBackend.h"
 #include "CoffeeEngine/Scripting/ScriptManager.h"
@@ -19,22 +22,39 @@
 #include "entt/entity/fwd.hpp"
 #include "entt/entity/snapshot.hpp"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <glm/detail/type_quat.hpp>
 #include <glm/fwd.hpp>
 #include <string>
 #include <tracy/Tracy.hpp>
+#include <unordered_set>
 
 #include <CoffeeEngine/Scripting/Script.h>
+#include <cereal/archives/binary.hpp>
 #include <cereal/archives/json.hpp>
 #include <fstream>
+#include <sstream>
 
 namespace Coffee {
 
-    Scene::Scene() : m_Octree({glm::vec3(-50.0f), glm::vec3(50.0f)}, 10, 5)
+    Scene::Scene() : m_Octree({glm::vec3(-50.0f), glm::vec3(50.0f)}, 10, 5, 2.0f)
     {
         m_SceneTree = CreateScope<SceneTree>(this);
+
+        m_Registry.on_construct<MeshComponent>().connect<&SceneRaycaster::OnMeshChanged>(m_Raycaster);
+        m_Registry.on_update<MeshComponent>().connect<&SceneRaycaster::OnMeshChanged>(m_Raycaster);
+        m_Registry.on_destroy<MeshComponent>().connect<&SceneRaycaster::OnMeshChanged>(m_Raycaster);
+
+        m_Registry.on_construct<MeshComponent>().connect<&Scene::OnMeshComponentChanged>(this);
+        m_Registry.on_update<MeshComponent>().connect<&Scene::OnMeshComponentChanged>(this);
+        m_Registry.on_destroy<MeshComponent>().connect<&Scene::OnMeshComponentDestroyed>(this);
+
+        m_Registry.on_destroy<TransformComponent>().connect<&Scene::OnTransformComponentDestroyed>(this);
     }
 
 /*     Scene::Scene(Ref<Scene> other)
@@ -58,19 +78,177 @@ namespace Coffee {
         return entity;
     }
 
+    std::vector<Entity> Scene::CreateEntities(const std::vector<EntityDescription>& descriptions, entt::entity parent)
+    {
+        ZoneScoped;
+
+        const size_t count = descriptions.size();
+
+        std::vector<entt::entity> entities(count);
+        m_Registry.create(entities.begin(), entities.end());
+
+        std::vector<TransformComponent> transforms(count);
+        std::vector<TagComponent> tags(count);
+        std::vector<HierarchyComponent> hierarchies(count);
+
+        std::vector<entt::entity> meshEntities;
+        std::vector<MeshComponent> meshComponents;
+        std::vector<entt::entity> materialEntities;
+        std::vector<MaterialComponent> materialComponents;
+
+        // Resolve the sibling links up front, the last child of each parent is tracked by index
+        std::vector<int32_t> lastChildIndices(count, -1);
+        int32_t lastRootIndex = -1;
+
+        HierarchyComponent* parentHierarchy = (parent != entt::null) ? &m_Registry.get<HierarchyComponent>(parent) : nullptr;
+        entt::entity parentLastChild = (parent != entt::null) ? HierarchyComponent::GetLastChild(m_Registry, parent) : entt::null;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const EntityDescription& description = descriptions[i];
+            entt::entity entity = entities[i];
+
+            transforms[i].SetLocalTransform(description.LocalTransform);
+            tags[i].Tag = description.Name.empty() ? "Entity" : description.Name;
+
+            auto& hierarchy = hierarchies[i];
+
+            if (description.ParentIndex >= 0)
+            {
+                COFFEE_CORE_ASSERT(description.ParentIndex < (int32_t)i, "The parent must be described before its children!");
+
+                auto& batchParentHierarchy = hierarchies[description.ParentIndex];
+                int32_t& lastChildIndex = lastChildIndices[description.ParentIndex];
+
+                hierarchy.m_Parent = entities[description.ParentIndex];
+
+                if (lastChildIndex == -1)
+                {
+                    batchParentHierarchy.m_First = entity;
+                }
+                else
+                {
+                    hierarchies[lastChildIndex].m_Next = entity;
+                    hierarchy.m_Prev = entities[lastChildIndex];
+                }
+
+                batchParentHierarchy.m_Last = entity;
+                lastChildIndex = (int32_t)i;
+            }
+            else if (parentHierarchy)
+            {
+                hierarchy.m_Parent = parent;
+
+                if (lastRootIndex != -1)
+                {
+                    hierarchies[lastRootIndex].m_Next = entity;
+                    hierarchy.m_Prev = entities[lastRootIndex];
+                }
+                else if (parentLastChild != entt::null)
+                {
+                    m_Registry.get<HierarchyComponent>(parentLastChild).m_Next = entity;
+                    hierarchy.m_Prev = parentLastChild;
+                }
+                else
+                {
+                    parentHierarchy->m_First = entity;
+                }
+
+                parentHierarchy->m_Last = entity;
+                lastRootIndex = (int32_t)i;
+            }
+
+            if (description.Mesh)
+            {
+                meshEntities.push_back(entity);
+                meshComponents.emplace_back(description.Mesh);
+            }
+
+            if (description.Material)
+            {
+                materialEntities.push_back(entity);
+                materialComponents.emplace_back(description.Material);
+            }
+        }
+
+        // The links are already resolved, so the HierarchyComponent listeners only see consistent data
+        m_Registry.insert<TransformComponent>(entities.begin(), entities.end(), transforms.begin());
+        m_Registry.insert<TagComponent>(entities.begin(), entities.end(), tags.begin());
+        m_Registry.insert<HierarchyComponent>(entities.begin(), entities.end(), hierarchies.begin());
+        m_Registry.insert<MeshComponent>(meshEntities.begin(), meshEntities.end(), meshComponents.begin());
+        m_Registry.insert<MaterialComponent>(materialEntities.begin(), materialEntities.end(), materialComponents.begin());
+
+        std::vector<Entity> result;
+        result.reserve(count);
+        for (auto entity : entities)
+        {
+            result.emplace_back(entity, this);
+        }
+
+        return result;
+    }
+
     void Scene::DestroyEntity(Entity entity)
     {
-        auto& hierarchyComponent = m_Registry.get<HierarchyComponent>(entity);
-        auto curr = hierarchyComponent.m_First;
+        m_DestroyQueue.push_back((entt::entity)entity);
+    }
+
+    void Scene::FlushDestroyQueue()
+    {
+        ZoneScoped;
+
+        if(m_DestroyQueue.empty())
+            return;
 
-        while(curr != entt::null)
+        // Collect the whole subtrees, an entity can be queued twice or be inside another queued subtree
+        std::unordered_set<entt::entity> doomed;
+        std::vector<entt::entity> doomedEntities;
+        std::vector<entt::entity> stack;
+
+        for(auto root : m_DestroyQueue)
         {
-            Entity e{curr, this};
-            curr = m_Registry.get<HierarchyComponent>(curr).m_Next;
-            DestroyEntity(e);
+            if(!m_Registry.valid(root) || doomed.contains(root))
+                continue;
+
+            stack.push_back(root);
+            while(!stack.empty())
+            {
+                entt::entity current = stack.back();
+                stack.pop_back();
+
+                if(!doomed.insert(current).second)
+                    continue;
+
+                doomedEntities.push_back(current);
+
+                if(auto hierarchyComponent = m_Registry.try_get<HierarchyComponent>(current))
+                {
+                    auto child = hierarchyComponent->m_First;
+                    while(child != entt::null && m_Registry.valid(child))
+                    {
+                        stack.push_back(child);
+                        child = m_Registry.get<HierarchyComponent>(child).m_Next;
+                    }
+                }
+            }
         }
 
-        m_Registry.destroy((entt::entity)entity);
+        m_DestroyQueue.clear();
+
+        // Only the roots of the doomed subtrees are linked to entities that survive
+        for(auto entity : doomedEntities)
+        {
+            auto hierarchyComponent = m_Registry.try_get<HierarchyComponent>(entity);
+            if(hierarchyComponent && !doomed.contains(hierarchyComponent->m_Parent))
+            {
+                HierarchyComponent::OnDestroy(m_Registry, entity);
+            }
+        }
+
+        // The sibling relinking inside the doomed subtrees is wasted work, so it is skipped during the bulk destroy
+        m_Registry.on_destroy<HierarchyComponent>().disconnect<&HierarchyComponent::OnDestroy>();
+        m_Registry.destroy(doomedEntities.begin(), doomedEntities.end());
+        m_Registry.on_destroy<HierarchyComponent>().connect<&HierarchyComponent::OnDestroy>();
     }
 
     void Scene::OnInitEditor()
@@ -97,25 +275,247 @@ namespace Coffee {
 
         m_SceneTree->Update();
 
+        RebuildSpatialIndices();
+    }
+
+    void Scene::RebuildSpatialIndices()
+    {
+        ZoneScoped;
+
+        m_Octree.Clear();
+        m_BVH.Clear();
+        m_SpatialHash.Clear();
+        m_PendingOctreeUpdates.clear();
+        m_IsLinearOctreeValid = false;
+
+        auto transformView = m_Registry.view<TransformComponent>();
+        for (auto entity : transformView)
+        {
+            m_SpatialHash.Insert(entity, transformView.get<TransformComponent>(entity).GetWorldTransform()[3]);
+        }
+
         auto view = m_Registry.view<MeshComponent>();
 
+        std::vector<ObjectContainer<entt::entity>> objects;
+        objects.reserve(view.size());
+
         for (auto& entity : view)
         {
             auto& meshComponent = view.get<MeshComponent>(entity);
             auto& transformComponent = m_Registry.get<TransformComponent>(entity);
 
-            ObjectContainer<Ref<Mesh>> objectContainer = {transformComponent.GetWorldTransform(), meshComponent.GetMesh()->GetAABB(), meshComponent.GetMesh()};
+            if (!meshComponent.GetMesh())
+                continue;
+
+            ObjectContainer<entt::entity> objectContainer = UpdateWorldBounds(entity, meshComponent.GetMesh(), transformComponent.GetWorldTransform());
+
+            m_BVH.Insert(objectContainer);
+            objects.push_back(objectContainer);
+        }
+
+        // The whole octree is built at once instead of subdividing it insert after insert
+        m_Octree.Build(objects);
+    }
+
+    void Scene::UpdateSpatialIndices()
+    {
+        ZoneScoped;
+
+        // Only the entities that moved or changed their mesh are touched
+        m_SceneTree->GetUpdatedEntities(m_PendingOctreeUpdates);
+
+        for (entt::entity entity : m_PendingOctreeUpdates)
+        {
+            if (!m_Registry.valid(entity))
+                continue;
+
+            const auto* transformComponent = m_Registry.try_get<TransformComponent>(entity);
+            if (!transformComponent)
+                continue;
+
+            m_SpatialHash.Update(entity, transformComponent->GetWorldTransform()[3]);
+
+            auto* meshComponent = m_Registry.try_get<MeshComponent>(entity);
+            if (!meshComponent)
+                continue;
+
+            // Only the entities with a mesh are in the linear octree, a moving camera or empty does not rebuild it
+            m_IsLinearOctreeValid = false;
+
+            if (!meshComponent->GetMesh())
+            {
+                m_Octree.Remove(entity);
+                m_BVH.Remove(entity);
+                m_Registry.remove<WorldBoundsComponent>(entity);
+                continue;
+            }
+
+            ObjectContainer<entt::entity> objectContainer = UpdateWorldBounds(entity, meshComponent->GetMesh(), transformComponent->GetWorldTransform());
+
+            m_Octree.Update(objectContainer);
+            m_BVH.Update(objectContainer);
+            m_Raycaster.OnEntityMoved(entity);
+        }
 
-            m_Octree.Insert(objectContainer);
+        m_PendingOctreeUpdates.clear();
+    }
+
+    ObjectContainer<entt::entity> Scene::UpdateWorldBounds(entt::entity entity, const Ref<Mesh>& mesh, const glm::mat4& worldTransform)
+    {
+        const AABB& worldBounds = m_Registry.emplace_or_replace<WorldBoundsComponent>(entity, mesh->GetAABB().CalculateTransformedAABB(worldTransform)).Bounds;
+
+        return {worldTransform, mesh->GetAABB(), entity, worldBounds};
+    }
+
+    void Scene::RebuildLinearOctree()
+    {
+        ZoneScoped;
+
+        std::vector<ObjectContainer<entt::entity>> objects;
+
+        auto view = m_Registry.view<MeshComponent, TransformComponent, WorldBoundsComponent>();
+        for (auto entity : view)
+        {
+            const Ref<Mesh>& mesh = view.get<MeshComponent>(entity).GetMesh();
+            if (!mesh)
+                continue;
+
+            objects.push_back({view.get<TransformComponent>(entity).GetWorldTransform(), mesh->GetAABB(), entity, view.get<WorldBoundsComponent>(entity).Bounds});
         }
+
+        m_LinearOctree.Build(objects);
+        m_IsLinearOctreeValid = true;
+    }
+
+    void Scene::CullFlat(const Frustum& frustum, std::vector<ObjectContainer<entt::entity>>& visibleObjects)
+    {
+        ZoneScoped;
+
+        m_FlatObjects.clear();
+
+        auto view = m_Registry.view<MeshComponent, TransformComponent, WorldBoundsComponent>();
+        for (auto entity : view)
+        {
+            const Ref<Mesh>& mesh = view.get<MeshComponent>(entity).GetMesh();
+            if (!mesh)
+                continue;
+
+            m_FlatObjects.push_back({view.get<TransformComponent>(entity).GetWorldTransform(), mesh->GetAABB(), entity, view.get<WorldBoundsComponent>(entity).Bounds});
+        }
+
+        m_FlatBounds.Resize(m_FlatObjects.size());
+        for (size_t i = 0; i < m_FlatObjects.size(); i++)
+        {
+            m_FlatBounds.Set(i, m_FlatObjects[i].worldAABB);
+        }
+
+        std::vector<uint8_t> visible(m_FlatObjects.size());
+        CullAABBs(FrustumPlanes(frustum), m_FlatBounds, 0, m_FlatObjects.size(), visible.data());
+
+        for (size_t i = 0; i < m_FlatObjects.size(); i++)
+        {
+            if (visible[i])
+                visibleObjects.push_back(m_FlatObjects[i]);
+        }
+    }
+
+    void Scene::CullOccluded(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, std::vector<ObjectContainer<entt::entity>>& visibleObjects)
+    {
+        ZoneScoped;
+
+        m_OcclusionBuffer.Begin(viewProjection);
+
+        auto addOccluder = [this](const glm::mat4& transform, const Ref<Mesh>& mesh) {
+            const auto& vertices = mesh->GetVertices();
+            const auto& indices = mesh->GetIndices();
+            if (vertices.empty() || indices.empty())
+                return;
+
+            m_OcclusionBuffer.AddOccluder(transform, &vertices[0].Position, sizeof(Vertex), indices.data(), indices.size());
+        };
+
+        auto occluderView = m_Registry.view<OccluderComponent, MeshComponent, TransformComponent>();
+        for (auto entity : occluderView)
+        {
+            const auto& occluderComponent = occluderView.get<OccluderComponent>(entity);
+            const Ref<Mesh>& mesh = occluderComponent.OccluderMesh ? occluderComponent.OccluderMesh : occluderView.get<MeshComponent>(entity).GetMesh();
+
+            if (mesh)
+            {
+                addOccluder(occluderView.get<TransformComponent>(entity).GetWorldTransform(), mesh);
+            }
+        }
+
+        // The visible meshes that look the largest from the camera are good occluders, if they are simple enough
+        std::vector<std::pair<float, size_t>> candidates;
+        for (size_t i = 0; i < visibleObjects.size(); i++)
+        {
+            const ObjectContainer<entt::entity>& object = visibleObjects[i];
+            if (m_Registry.all_of<OccluderComponent>(object.object))
+                continue;
+
+            const Ref<Mesh>& mesh = m_Registry.get<MeshComponent>(object.object).GetMesh();
+            if (mesh->GetIndices().size() / 3 > s_MaxAutoOccluderTriangles)
+                continue;
+
+            glm::vec3 halfSize = object.worldAABB.GetHalfSize();
+            glm::vec3 offset = object.worldAABB.GetCenter() - cameraPosition;
+            float size = glm::dot(halfSize, halfSize) / std::max(glm::dot(offset, offset), 1e-4f);
+
+            if (size >= s_MinAutoOccluderSize)
+            {
+                candidates.emplace_back(size, i);
+            }
+        }
+
+        size_t autoOccluderCount = std::min(candidates.size(), s_MaxAutoOccluders);
+        std::partial_sort(candidates.begin(), candidates.begin() + autoOccluderCount, candidates.end(), std::greater<>());
+
+        for (size_t i = 0; i < autoOccluderCount; i++)
+        {
+            const ObjectContainer<entt::entity>& object = visibleObjects[candidates[i].second];
+            addOccluder(object.transform, m_Registry.get<MeshComponent>(object.object).GetMesh());
+        }
+
+        m_OcclusionBuffer.Rasterize();
+
+        // An occluder is never hidden by itself, its bounds contain the depth it wrote
+        size_t visibleCount = visibleObjects.size();
+        std::erase_if(visibleObjects, [this](const ObjectContainer<entt::entity>& object) {
+            return !m_OcclusionBuffer.IsVisible(object.worldAABB);
+        });
+
+        m_OccludedCount = static_cast<uint32_t>(visibleCount - visibleObjects.size());
+    }
+
+    void Scene::OnMeshComponentChanged(entt::registry& registry, entt::entity entity)
+    {
+        m_PendingOctreeUpdates.push_back(entity);
+    }
+
+    void Scene::OnMeshComponentDestroyed(entt::registry& registry, entt::entity entity)
+    {
+        m_Octree.Remove(entity);
+        m_BVH.Remove(entity);
+        m_IsLinearOctreeValid = false;
+    }
+
+    void Scene::OnTransformComponentDestroyed(entt::registry& registry, entt::entity entity)
+    {
+        m_SpatialHash.Remove(entity);
     }
 
     void Scene::OnUpdateEditor(EditorCamera& camera, float dt)
     {
         ZoneScoped;
 
+        m_CommandBuffer.Playback(*this);
+        FlushDestroyQueue();
+
         m_SceneTree->Update();
 
+        UpdateSpatialIndices();
+
         Renderer::BeginScene(camera);
 
         // TEST ------------------------------
@@ -135,8 +535,14 @@ namespace Coffee {
             Ref<Mesh> mesh = meshComponent.GetMesh();
             Ref<Material> material = (materialComponent) ? materialComponent->material : nullptr;
             
+            RenderCommand command{transformComponent.GetWorldTransform(), mesh, material, (uint32_t)entity};
+            if (auto lodComponent = m_Registry.try_get<LODComponent>(entity))
+            {
+                command.lod = *lodComponent;
+            }
+
             //Renderer::Submit(material, mesh, transformComponent.GetWorldTransform(), (uint32_t)entity);
-            Renderer::Submit(RenderCommand{transformComponent.GetWorldTransform(), mesh, material, (uint32_t)entity});
+            Renderer::Submit(command);
         }
 
         //Get all entities with LightComponent and TransformComponent
@@ -172,8 +578,13 @@ namespace Coffee {
     {
         ZoneScoped;
 
+        m_CommandBuffer.Playback(*this);
+        FlushDestroyQueue();
+
         m_SceneTree->Update();
 
+        UpdateSpatialIndices();
+
         Camera* camera = nullptr;
         glm::mat4 cameraTransform;
         auto cameraView = m_Registry.view<TransformComponent, CameraComponent>();
@@ -208,11 +619,46 @@ namespace Coffee {
         Frustum frustum = Frustum(camera->GetProjection() /* testProjection */ * glm::inverse(cameraTransform));
         DebugRenderer::DrawFrustum(frustum, glm::vec4(1.0f), 1.0f);
 
-        auto meshes = m_Octree.Query(frustum);
+        std::vector<ObjectContainer<entt::entity>> visibleObjects;
+        switch (m_SpatialIndex)
+        {
+            case SpatialIndexType::Octree:
+                visibleObjects = m_Octree.Query(frustum);
+                Renderer::SetVisibilityCacheStats(m_Octree.GetVisibilityCacheStats().hits, m_Octree.GetVisibilityCacheStats().misses);
+                break;
+            case SpatialIndexType::LinearOctree:
+                if (!m_IsLinearOctreeValid)
+                {
+                    RebuildLinearOctree();
+                }
+                visibleObjects = m_LinearOctree.Query(frustum);
+                break;
+            case SpatialIndexType::BVH:
+                visibleObjects = m_BVH.Query(frustum);
+                break;
+            case SpatialIndexType::Flat:
+                CullFlat(frustum, visibleObjects);
+                break;
+        }
 
-        for(auto& mesh : meshes)
+        if (m_IsOcclusionCullingEnabled)
         {
-            Renderer::Submit(RenderCommand{mesh.transform, mesh.object, mesh.object->GetMaterial(), 0});
+            CullOccluded(camera->GetProjection() * glm::inverse(cameraTransform), cameraTransform[3], visibleObjects);
+        }
+
+        for(auto& visibleObject : visibleObjects)
+        {
+            const Ref<Mesh>& mesh = m_Registry.get<MeshComponent>(visibleObject.object).GetMesh();
+            auto materialComponent = m_Registry.try_get<MaterialComponent>(visibleObject.object);
+            Ref<Material> material = (materialComponent) ? materialComponent->material : mesh->GetMaterial();
+
+            RenderCommand command{visibleObject.transform, mesh, material, (uint32_t)visibleObject.object};
+            if (auto lodComponent = m_Registry.try_get<LODComponent>(visibleObject.object))
+            {
+                command.lod = *lodComponent;
+            }
+
+            Renderer::Submit(command);
         }
         
 /*         // Get all entities with ModelComponent and TransformComponent
@@ -278,51 +724,88 @@ namespace Coffee {
 
     }
 
+    namespace
+    {
+        struct SceneChunk
+        {
+            SceneChunkType Type;
+            uint32_t Count = 0;
+            std::string Data;
+        };
+
+        template<typename Component>
+        std::function<void(SceneChunk&)> CreateChunkWriter(entt::registry& registry, SceneChunkType type)
+        {
+            // The view is created here, on the calling thread, because it can create the pool
+            auto view = registry.view<Component>();
+
+            return [view, type](SceneChunk& chunk) {
+                ZoneScopedN("SceneChunkWriter");
+
+                chunk.Type = type;
+                chunk.Count = static_cast<uint32_t>(view.size());
+
+                std::ostringstream stream(std::ios::binary);
+                for (auto entity : view)
+                {
+                    stream.write(reinterpret_cast<const char*>(&entity), sizeof(entt::entity));
+                }
+
+                {
+                    cereal::BinaryOutputArchive archive(stream);
+                    for (auto entity : view)
+                    {
+                        archive(view.template get<Component>(entity));
+                    }
+                }
+
+                chunk.Data = stream.str();
+            };
+        }
+    }
+
     Ref<Scene> Scene::Load(const std::filesystem::path& path)
     {
         ZoneScoped;
 
-        Ref<Scene> scene = CreateRef<Scene>();
+        SceneLoader loader(path);
+        loader.Parse();
+        loader.Instantiate(std::numeric_limits<double>::infinity());
 
-        std::ifstream sceneFile(path);
-        cereal::JSONInputArchive archive(sceneFile);
+        if (loader.GetState() == SceneLoader::State::Failed)
+        {
+            COFFEE_CORE_ERROR("Scene {0} could not be loaded", path.filename().string());
+            return nullptr;
+        }
 
-        entt::snapshot_loader{scene->m_Registry}
-            .get<entt::entity>(archive)
-            .get<TagComponent>(archive)
-            .get<TransformComponent>(archive)
-            .get<HierarchyComponent>(archive)
-            .get<CameraComponent>(archive)
-            .get<MeshComponent>(archive)
-            .get<MaterialComponent>(archive)
-            .get<LightComponent>(archive)
-            .get<UIComponent>(archive);
-            
-        
-        scene->m_FilePath = path;
+        return loader.GetScene();
+    }
 
-        auto view = scene->m_Registry.view<entt::entity>();
-        for (auto entity : view)
-        {
-            auto& tag = scene->m_Registry.get<TagComponent>(entity);
-            auto& hierarchy = scene->m_Registry.get<HierarchyComponent>(entity);
+    void Scene::Save(const std::filesystem::path& path, Ref<Scene> scene, ResourceFormat format)
+    {
+        ZoneScoped;
 
-            COFFEE_INFO("Entity {0}, {1}", (uint32_t)entity, tag.Tag);
+        if (format == ResourceFormat::JSON)
+        {
+            SaveJSON(path, scene);
+        }
+        else
+        {
+            SaveBinary(path, scene);
         }
 
-        return scene;
+        scene->m_FilePath = path;
+
+        COFFEE_INFO("Scene {0} saved", path.filename().string());
     }
 
-    void Scene::Save(const std::filesystem::path& path, Ref<Scene> scene)
+    void Scene::SaveJSON(const std::filesystem::path& path, const Ref<Scene>& scene)
     {
         ZoneScoped;
 
         std::ofstream sceneFile(path);
         cereal::JSONOutputArchive archive(sceneFile);
 
-        //archive(*scene);
-
-        //TEMPORAL
         entt::snapshot{scene->m_Registry}
             .get<entt::entity>(archive)
             .get<TagComponent>(archive)
@@ -332,55 +815,220 @@ namespace Coffee {
             .get<MeshComponent>(archive)
             .get<MaterialComponent>(archive)
             .get<LightComponent>(archive)
-            .get<UIComponent>(archive);
-        
-        scene->m_FilePath = path;
+            .get<UIComponent>(archive)
+            .get<LODComponent>(archive)
+            .get<OccluderComponent>(archive);
+    }
+
+    void Scene::SaveBinary(const std::filesystem::path& path, const Ref<Scene>& scene)
+    {
+        ZoneScoped;
+
+        auto& registry = scene->m_Registry;
+
+        std::vector<entt::entity> entities;
+        for (auto entity : registry.view<entt::entity>())
+        {
+            entities.push_back(entity);
+        }
+
+        std::vector<std::function<void(SceneChunk&)>> writers = {
+            CreateChunkWriter<TagComponent>(registry, SceneChunkType::Tag),
+            CreateChunkWriter<TransformComponent>(registry, SceneChunkType::Transform),
+            CreateChunkWriter<HierarchyComponent>(registry, SceneChunkType::Hierarchy),
+            CreateChunkWriter<CameraComponent>(registry, SceneChunkType::Camera),
+            CreateChunkWriter<MeshComponent>(registry, SceneChunkType::Mesh),
+            CreateChunkWriter<MaterialComponent>(registry, SceneChunkType::Material),
+            CreateChunkWriter<LightComponent>(registry, SceneChunkType::Light),
+            CreateChunkWriter<UIComponent>(registry, SceneChunkType::UI),
+            CreateChunkWriter<LODComponent>(registry, SceneChunkType::LOD),
+            CreateChunkWriter<OccluderComponent>(registry, SceneChunkType::Occluder)
+        };
+
+        std::vector<SceneChunk> chunks(writers.size() + 1);
+
+        chunks[0].Type = SceneChunkType::Entities;
+        chunks[0].Count = static_cast<uint32_t>(entities.size());
+        chunks[0].Data.assign(reinterpret_cast<const char*>(entities.data()), entities.size() * sizeof(entt::entity));
+
+        // Every pool is serialized independently, one job per pool
+        JobSystem::ParallelFor(static_cast<uint32_t>(writers.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                writers[i](chunks[i + 1]);
+            }
+        });
+
+        SceneFileHeader header;
+        std::memcpy(header.Magic, s_SceneFileMagic, sizeof(s_SceneFileMagic));
+        header.Version = s_SceneFileVersion;
+        header.ChunkCount = static_cast<uint32_t>(chunks.size());
+        header.Reserved = 0;
+
+        std::vector<SceneChunkEntry> table;
+        uint64_t offset = sizeof(SceneFileHeader) + chunks.size() * sizeof(SceneChunkEntry);
+        for (const SceneChunk& chunk : chunks)
+        {
+            table.push_back({chunk.Type, chunk.Count, offset, chunk.Data.size()});
+            offset += chunk.Data.size();
+        }
+
+        std::ofstream sceneFile(path, std::ios::binary);
+        sceneFile.write(reinterpret_cast<const char*>(&header), sizeof(SceneFileHeader));
+        sceneFile.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SceneChunkEntry));
+        for (const SceneChunk& chunk : chunks)
+        {
+            sceneFile.write(chunk.Data.data(), chunk.Data.size());
+        }
+    }
+
+    template<typename Component>
+    static void CopyComponentPool(entt::registry& src, entt::registry& dst)
+    {
+        auto view = src.view<Component>();
+
+        std::vector<entt::entity> entities;
+        std::vector<Component> components;
+        entities.reserve(view.size());
+        components.reserve(view.size());
 
-        auto view = scene->m_Registry.view<entt::entity>();
         for (auto entity : view)
         {
-            auto& tag = scene->m_Registry.get<TagComponent>(entity);
-            auto& hierarchy = scene->m_Registry.get<HierarchyComponent>(entity);
+            entities.push_back(entity);
+            components.push_back(view.template get<Component>(entity));
+        }
+
+        dst.insert<Component>(entities.begin(), entities.end(), components.begin());
+    }
+
+    bool Scene::Raycast(const Ray& ray, float maxDistance, RaycastHit& hit)
+    {
+        return m_Raycaster.Raycast(m_Registry, ray, maxDistance, hit);
+    }
+
+    namespace
+    {
+        std::vector<Entity> ToEntities(const std::vector<entt::entity>& handles, Scene* scene)
+        {
+            std::vector<Entity> entities;
+            entities.reserve(handles.size());
+            for (entt::entity handle : handles)
+            {
+                entities.emplace_back(handle, scene);
+            }
+            return entities;
+        }
+    }
+
+    std::vector<Entity> Scene::GetEntitiesInRadius(const glm::vec3& center, float radius)
+    {
+        std::vector<entt::entity> handles;
+        m_SpatialHash.QueryRadius(center, radius, handles);
+        return ToEntities(handles, this);
+    }
+
+    std::vector<Entity> Scene::GetEntitiesInBox(const AABB& box)
+    {
+        std::vector<entt::entity> handles;
+        m_SpatialHash.QueryBox(box, handles);
+        return ToEntities(handles, this);
+    }
+
+    std::vector<Entity> Scene::GetNearestEntities(const glm::vec3& point, size_t count)
+    {
+        std::vector<entt::entity> handles;
+        m_SpatialHash.QueryNearest(point, count, handles);
+        return ToEntities(handles, this);
+    }
+
+    Ref<Scene> Scene::Copy(const Ref<Scene>& other)
+    {
+        ZoneScoped;
 
-            COFFEE_INFO("Entity {0}, {1}", (uint32_t)entity, tag.Tag);
+        Ref<Scene> scene = CreateRef<Scene>();
+
+        auto& srcRegistry = other->m_Registry;
+        auto& dstRegistry = scene->m_Registry;
+
+        // The registry is empty, so each hint gives back the same identifier
+        for (auto entity : srcRegistry.view<entt::entity>())
+        {
+            dstRegistry.create(entity);
         }
+
+        // Same components as Save/Load, the Ref members are shared with the original scene
+        CopyComponentPool<TagComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<TransformComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<HierarchyComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<CameraComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<MeshComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<MaterialComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<LightComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<UIComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<OccluderComponent>(srcRegistry, dstRegistry);
+        CopyComponentPool<LODComponent>(srcRegistry, dstRegistry);
+
+        scene->m_FilePath = other->m_FilePath;
+
+        // The spatial indices reference the component storage, so they can not be copied. OnInitRuntime builds them
+        return scene;
     }
 
     // Is possible that this function will be moved to the SceneTreePanel but for now it will stay here
     void AddModelToTheSceneTree(Scene* scene, Ref<Model> model)
     {
-        static Entity parent;
+        ZoneScoped;
 
-        Entity modelEntity = scene->CreateEntity(model->GetName());
+        std::vector<EntityDescription> descriptions;
 
-        if((entt::entity)parent != entt::null)modelEntity.SetParent(parent);
-        modelEntity.GetComponent<TransformComponent>().SetLocalTransform(model->GetTransform());
+        // Flatten the model tree, each node is described before its meshes and its children
+        std::vector<std::pair<Ref<Model>, int32_t>> stack = {{model, -1}};
+        while (!stack.empty())
+        {
+            auto [node, parentIndex] = stack.back();
+            stack.pop_back();
 
-        auto& meshes = model->GetMeshes();
-        bool hasMultipleMeshes = meshes.size() > 1;
+            int32_t nodeIndex = (int32_t)descriptions.size();
 
-        for(auto& mesh : meshes)
-        {
-            Entity entity = hasMultipleMeshes ? scene->CreateEntity(mesh->GetName()) : modelEntity;
+            EntityDescription nodeDescription;
+            nodeDescription.Name = node->GetName();
+            nodeDescription.LocalTransform = node->GetTransform();
+            nodeDescription.ParentIndex = parentIndex;
 
-            entity.AddComponent<MeshComponent>(mesh);
+            auto& meshes = node->GetMeshes();
+            bool hasMultipleMeshes = meshes.size() > 1;
 
-            if(mesh->GetMaterial())
+            if (meshes.size() == 1)
             {
-                entity.AddComponent<MaterialComponent>(mesh->GetMaterial());
+                nodeDescription.Mesh = meshes[0];
+                nodeDescription.Material = meshes[0]->GetMaterial();
             }
 
-            if(hasMultipleMeshes)
+            descriptions.push_back(nodeDescription);
+
+            if (hasMultipleMeshes)
             {
-                entity.SetParent(modelEntity);
+                for (auto& mesh : meshes)
+                {
+                    EntityDescription meshDescription;
+                    meshDescription.Name = mesh->GetName();
+                    meshDescription.ParentIndex = nodeIndex;
+                    meshDescription.Mesh = mesh;
+                    meshDescription.Material = mesh->GetMaterial();
+
+                    descriptions.push_back(meshDescription);
+                }
             }
-        }
 
-        for(auto& c : model->GetChildren())
-        {
-            parent = modelEntity;
-            AddModelToTheSceneTree(scene, c);
+            // Pushed in reverse so the children keep their order
+            const auto children = node->GetChildren();
+            for (auto it = children.rbegin(); it != children.rend(); ++it)
+            {
+                stack.push_back({*it, nodeIndex});
+            }
         }
+
+        scene->CreateEntities(descriptions);
     }
 
 }
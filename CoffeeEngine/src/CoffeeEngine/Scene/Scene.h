@@ -1,14 +1,23 @@
 #pragma once
 
+#include "CoffeeEngine/Core/DataStructures/BVH.h"
+#include "CoffeeEngine/Core/DataStructures/LinearOctree.h"
 #include "CoffeeEngine/Core/DataStructures/Octree.h"
+#include "CoffeeEngine/Core/DataStructures/SpatialHash.h"
 #include "CoffeeEngine/Events/Event.h"
+#include "CoffeeEngine/Math/FrustumCulling.h"
+#include "CoffeeEngine/IO/ResourceFormat.h"
 #include "CoffeeEngine/Renderer/EditorCamera.h"
+#include "CoffeeEngine/Renderer/OcclusionBuffer.h"
+#include "CoffeeEngine/Scene/EntityCommandBuffer.h"
+#include "CoffeeEngine/Scene/SceneRaycast.h"
 #include "CoffeeEngine/Scene/SceneTree.h"
 #include "entt/entity/fwd.hpp"
 
 #include <entt/entt.hpp>
 #include <filesystem>
 #include <string>
+#include <vector>
 
 namespace Coffee {
 
@@ -20,6 +29,31 @@ namespace Coffee {
     class Entity;
     class Model;
 
+    /**
+     * @brief Description of an entity created in bulk with Scene::CreateEntities.
+     * @ingroup scene
+     */
+    struct EntityDescription
+    {
+        std::string Name; ///< The name of the entity.
+        glm::mat4 LocalTransform = glm::mat4(1.0f); ///< The local transform of the entity.
+        int32_t ParentIndex = -1; ///< Index of the parent in the same batch (lower than the entity index), -1 for the batch parent.
+        Ref<Coffee::Mesh> Mesh; ///< The mesh of the entity, adds a MeshComponent if set.
+        Ref<Coffee::Material> Material; ///< The material of the entity, adds a MaterialComponent if set.
+    };
+
+    /**
+     * @brief The spatial index used to cull the meshes of the scene at runtime.
+     * @ingroup scene
+     */
+    enum class SpatialIndexType
+    {
+        Octree,       ///< Dynamic loose octree, updated incrementally.
+        LinearOctree, ///< Morton-coded octree, rebuilt in bulk when a mesh moves.
+        BVH,          ///< Surface area heuristic BVH, refitted when a mesh moves.
+        Flat          ///< No hierarchy, the bounds of every mesh are tested with the SIMD culling kernel.
+    };
+
     /**
      * @brief Class representing a scene.
      * @ingroup scene
@@ -47,11 +81,41 @@ namespace Coffee {
         Entity CreateEntity(const std::string& name = std::string());
 
         /**
-         * @brief Destroy an entity in the scene.
+         * @brief Create a whole entity subtree in the scene in one call.
+         *
+         * The components of all the entities are inserted in batch and the hierarchy links are resolved
+         * up front, so the cost is linear in the number of entities.
+         *
+         * @param descriptions The entities to create, parents must be before their children.
+         * @param parent The entity the roots of the batch are attached to, or a null entity.
+         * @return The created entities, in the same order as the descriptions.
+         */
+        std::vector<Entity> CreateEntities(const std::vector<EntityDescription>& descriptions, entt::entity parent = entt::null);
+
+        /**
+         * @brief Queue an entity and all its children for destruction.
+         *
+         * The entity stays valid until the queue is flushed at the start of the next scene update,
+         * so it is safe to call while iterating over the registry (e.g. from scripts).
+         *
          * @param entity The entity to destroy.
          */
         void DestroyEntity(Entity entity);
 
+        /**
+         * @brief Destroy all the queued entities and their subtrees in bulk.
+         */
+        void FlushDestroyQueue();
+
+        /**
+         * @brief Get the command buffer used to record structural changes during the updates.
+         *
+         * The commands are played back at the start of the next scene update, before the destroy queue is flushed.
+         *
+         * @return The command buffer of the scene.
+         */
+        EntityCommandBuffer& GetCommandBuffer() { return m_CommandBuffer; }
+
         /**
          * @brief Initialize the scene.
          */
@@ -91,8 +155,11 @@ namespace Coffee {
 
         /**
          * @brief Load a scene from a file.
+         *
+         * The format is detected from the file contents, binary scene files are memory mapped.
+         *
          * @param path The path to the file.
-         * @return The loaded scene.
+         * @return The loaded scene, or nullptr if the file could not be read.
          */
         static Ref<Scene> Load(const std::filesystem::path& path);
 
@@ -100,19 +167,153 @@ namespace Coffee {
          * @brief Save a scene to a file.
          * @param path The path to the file.
          * @param scene The scene to save.
+         * @param format JSON, the format of the existing scene files, or Binary for the versioned chunked format.
+         */
+        static void Save(const std::filesystem::path& path, Ref<Scene> scene, ResourceFormat format = ResourceFormat::JSON);
+
+        /**
+         * @brief Duplicate a scene in memory.
+         *
+         * The registry is cloned pool by pool keeping the same entity identifiers, so the hierarchy links stay valid.
+         * Resources like meshes and materials are shared with the original scene.
+         *
+         * @param other The scene to copy.
+         * @return The new scene. Its world transforms and spatial indices are built by OnInitRuntime.
+         */
+        static Ref<Scene> Copy(const Ref<Scene>& other);
+
+        /**
+         * @brief Intersect a ray with the meshes of the scene on the CPU.
+         * @param ray The ray in world space, distances are measured in lengths of its direction.
+         * @param maxDistance Hits further than this distance are ignored.
+         * @param hit The closest hit.
+         * @return True if the ray hits a mesh.
+         */
+        bool Raycast(const Ray& ray, float maxDistance, RaycastHit& hit);
+
+        /**
+         * @brief Find the entities whose world position is within a distance of a point.
+         *
+         * The positions are the ones of the last scene tree update.
+         *
+         * @param center The center of the sphere.
+         * @param radius The radius of the sphere.
+         * @return The entities, in no particular order.
+         */
+        std::vector<Entity> GetEntitiesInRadius(const glm::vec3& center, float radius);
+
+        /**
+         * @brief Find the entities whose world position is inside a box.
+         * @param box The box, in world space.
+         * @return The entities, in no particular order.
          */
-        static void Save(const std::filesystem::path& path, Ref<Scene> scene);
+        std::vector<Entity> GetEntitiesInBox(const AABB& box);
+
+        /**
+         * @brief Find the entities whose world position is the closest to a point.
+         * @param point The point.
+         * @param count The maximum number of entities.
+         * @return The entities, nearest first.
+         */
+        std::vector<Entity> GetNearestEntities(const glm::vec3& point, size_t count);
+
+        const SpatialHash<entt::entity>& GetSpatialHash() const { return m_SpatialHash; }
+
+        /**
+         * @brief Select the spatial index used to cull the meshes at runtime.
+         * @param spatialIndex The spatial index.
+         */
+        void SetSpatialIndex(SpatialIndexType spatialIndex) { m_SpatialIndex = spatialIndex; }
+        SpatialIndexType GetSpatialIndex() const { return m_SpatialIndex; }
+
+        /**
+         * @brief Enable the CPU occlusion culling of the runtime meshes, after the frustum culling.
+         * @param enabled True to enable it.
+         */
+        void SetOcclusionCulling(bool enabled) { m_IsOcclusionCullingEnabled = enabled; }
+        bool IsOcclusionCullingEnabled() const { return m_IsOcclusionCullingEnabled; }
 
         const std::filesystem::path& GetFilePath() { return m_FilePath; }
     private:
+        /**
+         * @brief Fill the spatial indices with the meshes of the scene.
+         */
+        void RebuildSpatialIndices();
+
+        /**
+         * @brief Move the meshes whose transform changed in the last scene tree update, and add the new ones.
+         */
+        void UpdateSpatialIndices();
+
+        /**
+         * @brief Recalculate the cached world bounds of a mesh after its transform or its mesh changed.
+         * @param entity The entity of the mesh.
+         * @param mesh The mesh.
+         * @param worldTransform The world transform of the entity.
+         * @return The object to insert in the spatial indices, with the new world bounds.
+         */
+        ObjectContainer<entt::entity> UpdateWorldBounds(entt::entity entity, const Ref<Mesh>& mesh, const glm::mat4& worldTransform);
+
+        /**
+         * @brief Build the linear octree in bulk from all the meshes of the scene.
+         */
+        void RebuildLinearOctree();
+
+        /**
+         * @brief Test the bounds of every mesh against the frustum, without any hierarchy.
+         * @param frustum The frustum.
+         * @param visibleObjects The visible meshes.
+         */
+        void CullFlat(const Frustum& frustum, std::vector<ObjectContainer<entt::entity>>& visibleObjects);
+
+        /**
+         * @brief Rasterize the occluders and remove the meshes hidden behind them.
+         *
+         * The occluders are the entities with an OccluderComponent, plus the visible meshes whose bounds are the
+         * largest on screen.
+         *
+         * @param viewProjection The projection * view matrix of the camera.
+         * @param cameraPosition The position of the camera.
+         * @param visibleObjects The meshes that passed the frustum culling, the hidden ones are removed.
+         */
+        void CullOccluded(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, std::vector<ObjectContainer<entt::entity>>& visibleObjects);
+
+        void OnMeshComponentChanged(entt::registry& registry, entt::entity entity);
+        void OnMeshComponentDestroyed(entt::registry& registry, entt::entity entity);
+        void OnTransformComponentDestroyed(entt::registry& registry, entt::entity entity);
+
+        static void SaveJSON(const std::filesystem::path& path, const Ref<Scene>& scene);
+        static void SaveBinary(const std::filesystem::path& path, const Ref<Scene>& scene);
+
+        SceneRaycaster m_Raycaster; ///< Declared before the registry, it listens to the mesh signals until the end.
         entt::registry m_Registry;
         Scope<SceneTree> m_SceneTree;
-        Octree<Ref<Mesh>> m_Octree;
+        Octree<entt::entity> m_Octree;
+        std::vector<entt::entity> m_PendingOctreeUpdates; ///< Entities whose mesh changed since the last octree update.
+        LinearOctree<entt::entity> m_LinearOctree; ///< Alternative culling structure, rebuilt in bulk when a mesh moves.
+        bool m_IsLinearOctreeValid = false;
+        BVH<entt::entity> m_BVH; ///< Alternative culling structure, refitted when a mesh moves.
+        SpatialIndexType m_SpatialIndex = SpatialIndexType::Octree; ///< The index used to cull the runtime meshes.
+        SpatialHash<entt::entity> m_SpatialHash; ///< The world position of every entity, for the radius and nearest queries.
+        AABBSoA m_FlatBounds; ///< The world bounds of the meshes for the flat culling, reused between frames.
+        std::vector<ObjectContainer<entt::entity>> m_FlatObjects; ///< The meshes for the flat culling.
+        OcclusionBuffer m_OcclusionBuffer;
+        bool m_IsOcclusionCullingEnabled = false;
+        uint32_t m_OccludedCount = 0; ///< The meshes hidden by the occlusion culling in the last frame.
+
+        static constexpr size_t s_MaxAutoOccluders = 8; ///< Meshes picked as occluders each frame, on top of the OccluderComponents.
+        static constexpr size_t s_MaxAutoOccluderTriangles = 1024; ///< Denser meshes are too slow to rasterize on the CPU.
+        static constexpr float s_MinAutoOccluderSize = 0.01f; ///< Minimum (radius / distance)^2 of the bounds of an occluder.
+
+        std::vector<entt::entity> m_DestroyQueue; ///< Entities waiting to be destroyed on the next flush.
+        EntityCommandBuffer m_CommandBuffer; ///< Structural changes recorded during the last update.
 
         // Temporal: Scenes should be Resources and the Base Resource class already has a path variable.
         std::filesystem::path m_FilePath;
 
         friend class Entity;
+        friend class EntityCommandBuffer;
+        friend class SceneLoader;
         friend class SceneTree;
         friend class SceneTreePanel;
 
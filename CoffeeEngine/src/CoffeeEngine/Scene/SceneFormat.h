@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Coffee {
+
+    /**
+     * @defgroup scene Scene
+     * @{
+     */
+
+    // Binary scene layout: header, table of contents, then one contiguous chunk per pool.
+    // Each chunk holds the raw entity identifiers followed by the cereal binary data of the components.
+
+    inline constexpr char s_SceneFileMagic[4] = {'T', 'E', 'A', 'S'}; ///< First bytes of a binary scene file.
+    inline constexpr uint32_t s_SceneFileVersion = 1; ///< Version of the binary scene format.
+
+    /**
+     * @brief Contents of a chunk of a binary scene file, the values are stored on disk.
+     */
+    enum class SceneChunkType : uint32_t
+    {
+        Entities = 0,
+        Tag,
+        Transform,
+        Hierarchy,
+        Camera,
+        Mesh,
+        Material,
+        Light,
+        UI,
+        LOD,
+        Occluder
+    };
+
+    /**
+     * @brief Header of a binary scene file.
+     */
+    struct SceneFileHeader
+    {
+        char Magic[4];
+        uint32_t Version;
+        uint32_t ChunkCount; ///< Number of entries of the table of contents, right after the header.
+        uint32_t Reserved;
+    };
+
+    /**
+     * @brief Entry of the table of contents of a binary scene file.
+     */
+    struct SceneChunkEntry
+    {
+        SceneChunkType Type;
+        uint32_t Count;  ///< Number of entities of the chunk.
+        uint64_t Offset; ///< Offset of the chunk from the start of the file.
+        uint64_t Size;   ///< Size of the chunk in bytes.
+    };
+
+    /** @} */ // end of scene group
+}
@@ -0,0 +1,396 @@
+#include "SceneLoader.h"
+#include "CoffeeEngine/Core/JobSystem.h"
+#include "CoffeeEngine/Core/Log.h"
+#include "CoffeeEngine/Core/Stopwatch.h"
+#include "CoffeeEngine/IO/MappedFile.h"
+#include "CoffeeEngine/Scene/Components.h"
+#include "CoffeeEngine/Scene/Scene.h"
+#include "CoffeeEngine/Scene/SceneFormat.h"
+#include "CoffeeEngine/Scene/SceneTree.h"
+
+#include <algorithm>
+#include <cereal/archives/binary.hpp>
+#include <cereal/archives/json.hpp>
+#include <cstring>
+#include <istream>
+#include <streambuf>
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    namespace
+    {
+        // Read-only stream over a memory range, lets cereal read straight from the mapped file
+        class MemoryStreamBuffer : public std::streambuf
+        {
+        public:
+            MemoryStreamBuffer(const uint8_t* data, size_t size)
+            {
+                char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+                setg(begin, begin, begin + size);
+            }
+        };
+
+        // Mesh and material components are resolved from the archive, the default constructors load placeholder resources
+        template<typename Component>
+        Component CreateEmptyComponent() { return Component(); }
+
+        template<>
+        MeshComponent CreateEmptyComponent<MeshComponent>() { return MeshComponent(Ref<Mesh>()); }
+
+        template<>
+        MaterialComponent CreateEmptyComponent<MaterialComponent>() { return MaterialComponent(Ref<Material>()); }
+    }
+
+    template<typename Component>
+    struct SceneLoader::ParsedComponentPool : SceneLoader::ParsedPool
+    {
+        std::vector<entt::entity> Entities;
+        std::vector<Component> Components;
+
+        ParsedComponentPool(const uint8_t* data, const SceneChunkEntry& entry)
+        {
+            ZoneScoped;
+
+            size_t entitiesSize = entry.Count * sizeof(entt::entity);
+
+            Entities.resize(entry.Count);
+            std::memcpy(Entities.data(), data, entitiesSize);
+
+            MemoryStreamBuffer buffer(data + entitiesSize, entry.Size - entitiesSize);
+            std::istream stream(&buffer);
+            cereal::BinaryInputArchive archive(stream);
+
+            // The resources (meshes, materials) are resolved here through the ResourceRegistry
+            Components.reserve(entry.Count);
+            for (uint32_t i = 0; i < entry.Count; i++)
+            {
+                Components.push_back(CreateEmptyComponent<Component>());
+                archive(Components.back());
+            }
+        }
+
+        ParsedComponentPool(cereal::JSONInputArchive& archive)
+        {
+            ZoneScoped;
+
+            // Same layout as entt::snapshot, the length followed by each entity and its component
+            std::underlying_type_t<entt::entity> length = 0;
+            archive(length);
+
+            // The length is not trusted for the allocations, a corrupted file runs out of values and throws instead
+            while (length--)
+            {
+                entt::entity entity = entt::null;
+                archive(entity);
+
+                if (entity == entt::null)
+                    continue;
+
+                Entities.push_back(entity);
+                Components.push_back(CreateEmptyComponent<Component>());
+                archive(Components.back());
+            }
+        }
+
+        uint32_t GetCount() const override { return static_cast<uint32_t>(Entities.size()); }
+
+        void Insert(entt::registry& registry, uint32_t begin, uint32_t end) override
+        {
+            registry.insert<Component>(Entities.begin() + begin, Entities.begin() + end, Components.begin() + begin);
+        }
+    };
+
+    struct SceneLoader::ParsedEntityPool : SceneLoader::ParsedPool
+    {
+        std::vector<entt::entity> Entities;
+
+        ParsedEntityPool(const uint8_t* data, const SceneChunkEntry& entry)
+        {
+            Entities.resize(entry.Count);
+            std::memcpy(Entities.data(), data, entry.Count * sizeof(entt::entity));
+        }
+
+        ParsedEntityPool(cereal::JSONInputArchive& archive)
+        {
+            // Same layout as entt::snapshot, the released entities are stored after the ones in use
+            std::underlying_type_t<entt::entity> count = 0;
+            std::underlying_type_t<entt::entity> inUse = 0;
+            archive(count);
+            archive(inUse);
+
+            for (std::underlying_type_t<entt::entity> i = 0; i < count; i++)
+            {
+                entt::entity entity = entt::null;
+                archive(entity);
+
+                if (i < inUse)
+                {
+                    Entities.push_back(entity);
+                }
+            }
+        }
+
+        uint32_t GetCount() const override { return static_cast<uint32_t>(Entities.size()); }
+
+        void Insert(entt::registry& registry, uint32_t begin, uint32_t end) override
+        {
+            // The registry starts empty, so each hint gives back the same identifier
+            for (uint32_t i = begin; i < end; i++)
+            {
+                registry.create(Entities[i]);
+            }
+        }
+    };
+
+    SceneLoader::SceneLoader(const std::filesystem::path& path) : m_FilePath(path)
+    {
+    }
+
+    SceneLoader::~SceneLoader() = default;
+
+    Ref<SceneLoader> SceneLoader::LoadAsync(const std::filesystem::path& path)
+    {
+        Ref<SceneLoader> loader = CreateRef<SceneLoader>(path);
+
+        // The job keeps the loader alive even if the caller drops it
+        JobSystem::Execute([loader]() { loader->Parse(); });
+
+        return loader;
+    }
+
+    bool SceneLoader::Parse()
+    {
+        ZoneScoped;
+
+        MappedFile file;
+        if (!file.Open(m_FilePath))
+        {
+            COFFEE_CORE_ERROR("SceneLoader: Could not open {0}", m_FilePath.string());
+            m_State = State::Failed;
+            return false;
+        }
+
+        bool isBinary = file.GetSize() >= sizeof(SceneFileHeader) &&
+                        std::memcmp(file.GetData(), s_SceneFileMagic, sizeof(s_SceneFileMagic)) == 0;
+
+        bool parsed = isBinary ? ParseBinary(file.GetData(), file.GetSize()) : ParseJSON(file.GetData(), file.GetSize());
+        if (!parsed)
+        {
+            m_Pools.clear();
+            m_State = State::Failed;
+            return false;
+        }
+
+        m_State = State::Instantiating;
+        return true;
+    }
+
+    bool SceneLoader::ParseBinary(const uint8_t* data, size_t size)
+    {
+        SceneFileHeader header;
+        std::memcpy(&header, data, sizeof(SceneFileHeader));
+
+        if (std::memcmp(header.Magic, s_SceneFileMagic, sizeof(s_SceneFileMagic)) != 0)
+        {
+            COFFEE_CORE_ERROR("SceneLoader: {0} is not a binary scene file", m_FilePath.string());
+            return false;
+        }
+
+        if (header.Version != s_SceneFileVersion)
+        {
+            COFFEE_CORE_ERROR("SceneLoader: Unsupported scene file version {0}", header.Version);
+            return false;
+        }
+
+        size_t tableSize = static_cast<size_t>(header.ChunkCount) * sizeof(SceneChunkEntry);
+        if (tableSize > size - sizeof(SceneFileHeader))
+        {
+            COFFEE_CORE_ERROR("SceneLoader: Corrupted scene file {0}", m_FilePath.string());
+            return false;
+        }
+
+        std::vector<SceneChunkEntry> table(header.ChunkCount);
+        std::memcpy(table.data(), data + sizeof(SceneFileHeader), tableSize);
+
+        for (const SceneChunkEntry& entry : table)
+        {
+            // Written this way so huge offsets and sizes can not overflow the checks
+            if (entry.Offset > size || entry.Size > size - entry.Offset || entry.Count > entry.Size / sizeof(entt::entity))
+            {
+                COFFEE_CORE_ERROR("SceneLoader: Corrupted scene file {0}", m_FilePath.string());
+                return false;
+            }
+        }
+
+        m_ChunkCount = header.ChunkCount;
+
+        // The chunks are stored in the same order as the JSON snapshot, the entities first
+        for (const SceneChunkEntry& entry : table)
+        {
+            const uint8_t* chunkData = data + entry.Offset;
+
+            // A truncated or corrupted chunk makes cereal throw, it must not escape the worker thread
+            Scope<ParsedPool> pool;
+            try
+            {
+                switch (entry.Type)
+                {
+                    case SceneChunkType::Entities:  pool = CreateScope<ParsedEntityPool>(chunkData, entry); break;
+                    case SceneChunkType::Tag:       pool = CreateScope<ParsedComponentPool<TagComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Transform: pool = CreateScope<ParsedComponentPool<TransformComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Hierarchy: pool = CreateScope<ParsedComponentPool<HierarchyComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Camera:    pool = CreateScope<ParsedComponentPool<CameraComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Mesh:      pool = CreateScope<ParsedComponentPool<MeshComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Material:  pool = CreateScope<ParsedComponentPool<MaterialComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Light:     pool = CreateScope<ParsedComponentPool<LightComponent>>(chunkData, entry); break;
+                    case SceneChunkType::UI:        pool = CreateScope<ParsedComponentPool<UIComponent>>(chunkData, entry); break;
+                    case SceneChunkType::LOD:       pool = CreateScope<ParsedComponentPool<LODComponent>>(chunkData, entry); break;
+                    case SceneChunkType::Occluder:  pool = CreateScope<ParsedComponentPool<OccluderComponent>>(chunkData, entry); break;
+                    default:
+                        COFFEE_CORE_WARN("SceneLoader: Skipping unknown chunk type {0}", (uint32_t)entry.Type);
+                        break;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                COFFEE_CORE_ERROR("SceneLoader: Corrupted chunk {0} in scene file {1} ({2})", (uint32_t)entry.Type, m_FilePath.string(), e.what());
+                return false;
+            }
+
+            if (pool)
+            {
+                m_TotalCount += pool->GetCount();
+                m_Pools.push_back(std::move(pool));
+            }
+
+            m_ParsedChunkCount++;
+        }
+
+        return true;
+    }
+
+    bool SceneLoader::ParseJSON(const uint8_t* data, size_t size)
+    {
+        // The same pools as Scene::SaveJSON, in the same order
+        m_ChunkCount = 11;
+
+        auto addPool = [this](Scope<ParsedPool> pool) {
+            m_TotalCount += pool->GetCount();
+            m_Pools.push_back(std::move(pool));
+            m_ParsedChunkCount++;
+        };
+
+        MemoryStreamBuffer buffer(data, size);
+        std::istream stream(&buffer);
+
+        // Malformed JSON or missing values make cereal throw, it must not escape the worker thread
+        try
+        {
+            cereal::JSONInputArchive archive(stream);
+
+            addPool(CreateScope<ParsedEntityPool>(archive));
+            addPool(CreateScope<ParsedComponentPool<TagComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<TransformComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<HierarchyComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<CameraComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<MeshComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<MaterialComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<LightComponent>>(archive));
+            addPool(CreateScope<ParsedComponentPool<UIComponent>>(archive));
+
+            // The pools added later are at the end, the files saved before them just stop here
+            try
+            {
+                addPool(CreateScope<ParsedComponentPool<LODComponent>>(archive));
+                addPool(CreateScope<ParsedComponentPool<OccluderComponent>>(archive));
+            }
+            catch (const cereal::Exception& e)
+            {
+                COFFEE_CORE_WARN("Scene {0} was saved without some components ({1})", m_FilePath.filename().string(), e.what());
+            }
+        }
+        catch (const std::exception& e)
+        {
+            COFFEE_CORE_ERROR("SceneLoader: Corrupted scene file {0} ({1})", m_FilePath.string(), e.what());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SceneLoader::Instantiate(double timeBudget)
+    {
+        State state = m_State;
+
+        if (state == State::Parsing)
+            return false;
+
+        if (state == State::Finished)
+            return true;
+
+        ZoneScoped;
+
+        if (!m_Scene)
+        {
+            m_Scene = CreateRef<Scene>();
+            m_Scene->m_FilePath = m_FilePath;
+        }
+
+        if (state == State::Failed)
+            return true;
+
+        auto& registry = m_Scene->m_Registry;
+
+        Stopwatch stopwatch;
+        stopwatch.Start();
+
+        while (m_PoolIndex < m_Pools.size())
+        {
+            ParsedPool& pool = *m_Pools[m_PoolIndex];
+
+            uint32_t end = std::min(m_PoolOffset + s_InstantiateBatchSize, pool.GetCount());
+            pool.Insert(registry, m_PoolOffset, end);
+
+            m_InstantiatedCount += end - m_PoolOffset;
+            m_PoolOffset = end;
+
+            if (m_PoolOffset == pool.GetCount())
+            {
+                m_PoolIndex++;
+                m_PoolOffset = 0;
+            }
+
+            if (stopwatch.GetPreciseElapsedTime() >= timeBudget)
+                break;
+        }
+
+        if (m_PoolIndex < m_Pools.size())
+            return false;
+
+        m_Pools.clear();
+        m_State = State::Finished;
+
+        COFFEE_INFO("Scene {0} loaded", m_FilePath.filename().string());
+
+        return true;
+    }
+
+    float SceneLoader::GetProgress() const
+    {
+        // Parsing and instantiating are weighted the same
+        switch (m_State.load())
+        {
+            case State::Parsing:
+            {
+                uint32_t chunkCount = m_ChunkCount;
+                return chunkCount > 0 ? 0.5f * m_ParsedChunkCount / chunkCount : 0.0f;
+            }
+            case State::Instantiating:
+                return m_TotalCount > 0 ? 0.5f + 0.5f * (float)m_InstantiatedCount / m_TotalCount : 0.5f;
+            default:
+                return 1.0f;
+        }
+    }
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "CoffeeEngine/Core/Base.h"
+#include "entt/entity/fwd.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace cereal {
+    class JSONInputArchive;
+}
+
+namespace Coffee {
+
+    /**
+     * @defgroup scene Scene
+     * @{
+     */
+
+    class Scene;
+
+    /**
+     * @brief Loads a scene file in two steps, so the slow part can run while the application keeps updating.
+     *
+     * Parse reads the file and resolves the resources referenced by the components, it can run on a worker thread.
+     * Instantiate creates the entities and components on the main thread in batches, within a time budget per call.
+     * @ingroup scene
+     */
+    class SceneLoader
+    {
+    public:
+        /**
+         * @brief The steps of the load.
+         */
+        enum class State
+        {
+            Parsing,       ///< The file is being read.
+            Instantiating, ///< The file was read, the entities are being created.
+            Finished,      ///< The scene is ready.
+            Failed         ///< The file could not be read, the scene is empty.
+        };
+
+        /**
+         * @brief Constructor for SceneLoader.
+         * @param path The path of the scene file.
+         */
+        SceneLoader(const std::filesystem::path& path);
+        ~SceneLoader();
+
+        /**
+         * @brief Start loading a scene, the file is parsed on a JobSystem worker thread.
+         *
+         * Call Instantiate every frame from the main thread until it returns true.
+         *
+         * @param path The path of the scene file.
+         * @return The loader of the scene.
+         */
+        static Ref<SceneLoader> LoadAsync(const std::filesystem::path& path);
+
+        /**
+         * @brief Read the scene file and resolve the resources. Can be called from any thread.
+         * @return True if the file was read.
+         */
+        bool Parse();
+
+        /**
+         * @brief Create the next batches of entities. Must be called from the main thread.
+         * @param timeBudget The maximum time to spend, in seconds. At least one batch is created per call.
+         * @return True when the load is over (finished or failed), false if there is still work to do.
+         */
+        bool Instantiate(double timeBudget);
+
+        /**
+         * @brief Get the progress of the load.
+         * @return The progress, from 0 to 1.
+         */
+        float GetProgress() const;
+
+        /**
+         * @brief Get the current step of the load.
+         * @return The state of the load.
+         */
+        State GetState() const { return m_State; }
+
+        /**
+         * @brief Get the loaded scene, only complete once Instantiate returned true.
+         * @return The loaded scene.
+         */
+        const Ref<Scene>& GetScene() const { return m_Scene; }
+
+        /**
+         * @brief Get the path of the scene file.
+         * @return The path of the scene file.
+         */
+        const std::filesystem::path& GetFilePath() const { return m_FilePath; }
+
+    private:
+        /**
+         * @brief The parsed entities or components of a pool, waiting to be added to the registry.
+         */
+        struct ParsedPool
+        {
+            virtual ~ParsedPool() = default;
+            virtual uint32_t GetCount() const = 0;
+            virtual void Insert(entt::registry& registry, uint32_t begin, uint32_t end) = 0;
+        };
+
+        template<typename Component>
+        struct ParsedComponentPool;
+        struct ParsedEntityPool;
+
+        bool ParseBinary(const uint8_t* data, size_t size);
+        bool ParseJSON(const uint8_t* data, size_t size);
+
+    private:
+        std::filesystem::path m_FilePath;
+        Ref<Scene> m_Scene;
+
+        std::atomic<State> m_State = State::Parsing;
+
+        std::vector<Scope<ParsedPool>> m_Pools;
+        size_t m_PoolIndex = 0; ///< The pool being instantiated.
+        uint32_t m_PoolOffset = 0; ///< The next element of the pool to instantiate.
+
+        std::atomic<uint32_t> m_ParsedChunkCount = 0;
+        std::atomic<uint32_t> m_ChunkCount = 0;
+        uint64_t m_InstantiatedCount = 0;
+        uint64_t m_TotalCount = 0;
+
+        static constexpr uint32_t s_InstantiateBatchSize = 256; ///< Elements added to the registry between time checks.
+    };
+
+    /** @} */ // end of scene group
+}
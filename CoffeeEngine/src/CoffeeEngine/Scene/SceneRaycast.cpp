@@ -0,0 +1,130 @@
+#include "SceneRaycast.h"
+#include "CoffeeEngine/Renderer/Mesh.h"
+#include "CoffeeEngine/Scene/Components.h"
+
+#include <tracy/Tracy.hpp>
+
+namespace Coffee {
+
+    bool SceneRaycaster::Raycast(entt::registry& registry, const Ray& ray, float maxDistance, RaycastHit& hit)
+    {
+        ZoneScoped;
+
+        if (m_Dirty)
+        {
+            Rebuild(registry);
+        }
+        else if (!m_MovedEntities.empty())
+        {
+            Refit(registry);
+        }
+
+        uint32_t hitPrimitive = 0;
+        uint32_t hitTriangle = 0;
+        bool found = false;
+
+        m_BVH.Raycast(ray, maxDistance, [&](uint32_t primitive, float& closestDistance) {
+            const Ref<Mesh>& mesh = registry.get<MeshComponent>(m_Entities[primitive]).GetMesh();
+
+            // The local ray keeps the same parametrization, so the distances can be compared with the world ones
+            Ray localRay = ray.Transform(m_InverseTransforms[primitive]);
+
+            float distance;
+            uint32_t triangle;
+            if (mesh->Raycast(localRay, closestDistance, distance, triangle))
+            {
+                closestDistance = distance;
+                hitPrimitive = primitive;
+                hitTriangle = triangle;
+                found = true;
+            }
+        });
+
+        if (!found)
+            return false;
+
+        const Ref<Mesh>& mesh = registry.get<MeshComponent>(m_Entities[hitPrimitive]).GetMesh();
+        const std::vector<Vertex>& vertices = mesh->GetVertices();
+        const std::vector<uint32_t>& indices = mesh->GetIndices();
+
+        const glm::vec3& v0 = vertices[indices[hitTriangle]].Position;
+        const glm::vec3& v1 = vertices[indices[hitTriangle + 1]].Position;
+        const glm::vec3& v2 = vertices[indices[hitTriangle + 2]].Position;
+
+        // Normals are transformed with the inverse transpose of the world matrix
+        glm::vec3 normal = glm::transpose(glm::mat3(m_InverseTransforms[hitPrimitive])) * glm::cross(v1 - v0, v2 - v0);
+        normal = glm::normalize(normal);
+
+        if (glm::dot(normal, ray.Direction) > 0.0f)
+        {
+            normal = -normal;
+        }
+
+        hit.Entity = m_Entities[hitPrimitive];
+        hit.Distance = maxDistance;
+        hit.Point = ray.GetPoint(maxDistance);
+        hit.Normal = normal;
+
+        return true;
+    }
+
+    void SceneRaycaster::Rebuild(entt::registry& registry)
+    {
+        ZoneScoped;
+
+        m_Entities.clear();
+        m_PrimitiveIndices.clear();
+        m_InverseTransforms.clear();
+        m_Bounds.clear();
+        m_MovedEntities.clear();
+
+        auto view = registry.view<MeshComponent, TransformComponent>();
+        for (auto entity : view)
+        {
+            const Ref<Mesh>& mesh = view.get<MeshComponent>(entity).GetMesh();
+            if (!mesh)
+                continue;
+
+            const glm::mat4& worldTransform = view.get<TransformComponent>(entity).GetWorldTransform();
+
+            m_PrimitiveIndices[entity] = static_cast<uint32_t>(m_Entities.size());
+            m_Entities.push_back(entity);
+            m_InverseTransforms.push_back(glm::inverse(worldTransform));
+            // The cached bounds are missing until the first spatial index update of the scene
+            const auto* worldBounds = registry.try_get<WorldBoundsComponent>(entity);
+            m_Bounds.push_back(worldBounds ? worldBounds->Bounds : mesh->GetAABB().CalculateTransformedAABB(worldTransform));
+        }
+
+        m_BVH.Build(m_Bounds);
+        m_BuiltSurfaceArea = m_BVH.IsEmpty() ? 0.0f : PrimitiveBVH::GetSurfaceArea(m_BVH.GetNodes()[0].Bounds);
+        m_Dirty = false;
+    }
+
+    void SceneRaycaster::Refit(entt::registry& registry)
+    {
+        ZoneScoped;
+
+        for (entt::entity entity : m_MovedEntities)
+        {
+            auto it = m_PrimitiveIndices.find(entity);
+            if (it == m_PrimitiveIndices.end() || !registry.valid(entity))
+                continue;
+
+            const glm::mat4& worldTransform = registry.get<TransformComponent>(entity).GetWorldTransform();
+            const auto* worldBounds = registry.try_get<WorldBoundsComponent>(entity);
+
+            m_InverseTransforms[it->second] = glm::inverse(worldTransform);
+            m_Bounds[it->second] = worldBounds ? worldBounds->Bounds : registry.get<MeshComponent>(entity).GetMesh()->GetAABB().CalculateTransformedAABB(worldTransform);
+        }
+        m_MovedEntities.clear();
+
+        m_BVH.Refit(m_Bounds);
+
+        // Entities that moved apart make the nodes overlap, the rays visit more of the tree
+        if (!m_BVH.IsEmpty() && PrimitiveBVH::GetSurfaceArea(m_BVH.GetNodes()[0].Bounds) > m_BuiltSurfaceArea * s_MaxRefitGrowth)
+        {
+            Rebuild(registry);
+        }
+    }
+
+}
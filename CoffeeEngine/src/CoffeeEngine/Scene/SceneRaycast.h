@@ -0,0 +1,101 @@
+#pragma once
+
+#include "CoffeeEngine/Core/DataStructures/PrimitiveBVH.h"
+#include "CoffeeEngine/Math/Ray.h"
+#include "entt/entity/fwd.hpp"
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace Coffee {
+
+    /**
+     * @defgroup scene Scene
+     * @{
+     */
+
+    /**
+     * @brief The result of a scene raycast.
+     * @ingroup scene
+     */
+    struct RaycastHit
+    {
+        entt::entity Entity = entt::null; ///< The entity that was hit.
+        float Distance = std::numeric_limits<float>::max(); ///< The distance along the ray, in ray direction lengths.
+        glm::vec3 Point = glm::vec3(0.0f); ///< The hit point in world space.
+        glm::vec3 Normal = glm::vec3(0.0f); ///< The world space normal of the hit triangle, facing the ray.
+    };
+
+    /**
+     * @brief Answers ray queries against the meshes of a scene on the CPU.
+     *
+     * A top level BVH over the world bounds of the mesh entities selects the candidates, then the ray is moved to the
+     * local space of each candidate and tested against the triangle BVH of its mesh. The top level tree is rebuilt
+     * lazily on the next query after a mesh was added, replaced or removed, and only refitted when mesh entities moved.
+     * @ingroup scene
+     */
+    class SceneRaycaster
+    {
+    public:
+        /**
+         * @brief Intersect a ray with the meshes of the scene.
+         * @param registry The registry of the scene.
+         * @param ray The ray in world space.
+         * @param maxDistance Hits further than this distance are ignored.
+         * @param hit The closest hit, left untouched if nothing was hit.
+         * @return True if the ray hits a mesh.
+         */
+        bool Raycast(entt::registry& registry, const Ray& ray, float maxDistance, RaycastHit& hit);
+
+        /**
+         * @brief Mark the top level tree as outdated, it is rebuilt on the next query.
+         */
+        void Invalidate() { m_Dirty = true; }
+
+        /**
+         * @brief Record that the world transform of a mesh entity changed, its bounds are refitted on the next query.
+         * @param entity The entity that moved, ignored if it is not in the tree.
+         */
+        void OnEntityMoved(entt::entity entity)
+        {
+            if (m_Dirty)
+                return;
+
+            // Without queries the list would keep growing, past one entry per primitive the tree is rebuilt instead
+            if (m_MovedEntities.size() >= m_Entities.size())
+            {
+                m_MovedEntities.clear();
+                m_Dirty = true;
+                return;
+            }
+
+            m_MovedEntities.push_back(entity);
+        }
+
+        /**
+         * @brief Signal listener that invalidates the tree when a mesh component is added, replaced or removed.
+         */
+        void OnMeshChanged(entt::registry&, entt::entity) { m_Dirty = true; }
+
+    private:
+        void Rebuild(entt::registry& registry);
+        void Refit(entt::registry& registry);
+
+    private:
+        PrimitiveBVH m_BVH; ///< The hierarchy of the world bounds of the mesh entities.
+        std::vector<entt::entity> m_Entities; ///< The entity of each primitive of the BVH.
+        std::unordered_map<entt::entity, uint32_t> m_PrimitiveIndices; ///< The primitive of each entity of the BVH.
+        std::vector<glm::mat4> m_InverseTransforms; ///< The inverse world transform of each primitive of the BVH.
+        std::vector<AABB> m_Bounds; ///< The world bounds of each primitive of the BVH.
+        std::vector<entt::entity> m_MovedEntities; ///< The entities to refit on the next query.
+        float m_BuiltSurfaceArea = 0.0f; ///< The surface area of the root right after the last build.
+        bool m_Dirty = true;
+
+        static constexpr float s_MaxRefitGrowth = 2.0f; ///< Rebuild when the refitted root grows more than this.
+    };
+
+    /** @} */ // end of scene group
+}
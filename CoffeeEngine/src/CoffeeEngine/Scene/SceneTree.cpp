@@ -1,56 +1,109 @@
 #include "SceneTree.h"
+#include "CoffeeEngine/Core/JobSystem.h"
 #include "CoffeeEngine/Core/Log.h"
 #include "CoffeeEngine/Scene/Components.h"
 #include "CoffeeEngine/Scene/Scene.h"
 #include "entt/entity/entity.hpp"
 #include "entt/entity/fwd.hpp"
+#include <atomic>
 #include <tracy/Tracy.hpp>
 
 namespace Coffee {
 
+    static constexpr uint32_t s_ParallelBatchSize = 512;
+
     void HierarchyComponent::OnConstruct(entt::registry& registry, entt::entity entity)
     {
         auto& hierarchy = registry.get<HierarchyComponent>(entity);
 
-        if(hierarchy.m_Parent != entt::null)
+        if(hierarchy.m_Parent == entt::null)
         {
-            auto& parentHierarchy = registry.get<HierarchyComponent>(hierarchy.m_Parent);
+            return;
+        }
+
+        // The parent may not be constructed yet when loading a scene, the links are already serialized
+        auto parentHierarchy = registry.try_get<HierarchyComponent>(hierarchy.m_Parent);
+        if(parentHierarchy == nullptr)
+        {
+            return;
+        }
 
-            if(parentHierarchy.m_First == entt::null)
+        // Already linked (loaded from a file or created in bulk), only keep track of the last child
+        if(hierarchy.m_Prev != entt::null || parentHierarchy->m_First == entity)
+        {
+            if(hierarchy.m_Next == entt::null)
             {
-                parentHierarchy.m_First = entity;
+                parentHierarchy->m_Last = entity;
             }
-            else
-            {
-                //Get the last child of the parent
-                auto lastEntity = parentHierarchy.m_First;
-                auto lastHierarchy = registry.try_get<HierarchyComponent>(lastEntity);
-                while(lastHierarchy != nullptr && lastHierarchy->m_Next != entt::null)
-                {
-                    auto nextEntity = lastHierarchy->m_Next;
-                    auto nextHierarchy = registry.try_get<HierarchyComponent>(nextEntity);
+            return;
+        }
 
-                    if(nextHierarchy == nullptr)
-                    {
-                        break;
-                    }
+        if(parentHierarchy->m_First == entt::null)
+        {
+            parentHierarchy->m_First = entity;
+            parentHierarchy->m_Last = entity;
+            return;
+        }
 
-                    lastEntity = nextEntity;
-                    lastHierarchy = nextHierarchy;
-                }
-                if (lastEntity == entity)
-                {
-                    return;
-                }
-                lastHierarchy->m_Next = entity;
-                lastHierarchy->m_Prev = lastEntity;
+        auto lastEntity = GetLastChild(registry, hierarchy.m_Parent);
+        if (lastEntity == entity)
+        {
+            return;
+        }
+
+        registry.get<HierarchyComponent>(lastEntity).m_Next = entity;
+        hierarchy.m_Prev = lastEntity;
+        parentHierarchy->m_Last = entity;
+    }
+
+    entt::entity HierarchyComponent::GetLastChild(entt::registry& registry, entt::entity entity)
+    {
+        auto& hierarchy = registry.get<HierarchyComponent>(entity);
+
+        if(hierarchy.m_Last != entt::null && registry.valid(hierarchy.m_Last))
+        {
+            return hierarchy.m_Last;
+        }
+
+        if(hierarchy.m_First == entt::null)
+        {
+            return entt::null;
+        }
+
+        // The last child is not serialized, walk the children once and keep it cached
+        auto lastEntity = hierarchy.m_First;
+        auto lastHierarchy = registry.try_get<HierarchyComponent>(lastEntity);
+        while(lastHierarchy != nullptr && lastHierarchy->m_Next != entt::null)
+        {
+            auto nextEntity = lastHierarchy->m_Next;
+            auto nextHierarchy = registry.try_get<HierarchyComponent>(nextEntity);
+
+            if(nextHierarchy == nullptr)
+            {
+                break;
             }
+
+            lastEntity = nextEntity;
+            lastHierarchy = nextHierarchy;
         }
+
+        hierarchy.m_Last = lastEntity;
+        return lastEntity;
     }
 
     void HierarchyComponent::OnDestroy(entt::registry& registry, entt::entity entity)
     {
         auto& hierarchy = registry.get<HierarchyComponent>(entity);
+
+        if(hierarchy.m_Parent != entt::null && registry.valid(hierarchy.m_Parent))
+        {
+            auto parent_hierarchy = registry.try_get<HierarchyComponent>(hierarchy.m_Parent);
+            if(parent_hierarchy != nullptr && parent_hierarchy->m_Last == entity)
+            {
+                parent_hierarchy->m_Last = hierarchy.m_Prev;
+            }
+        }
+
         // if is the first child
         if(hierarchy.m_Prev == entt::null || !registry.valid(hierarchy.m_Prev))
         {
@@ -105,11 +158,20 @@ namespace Coffee {
         hierarchyComponent->m_Next = entt::null;
         hierarchyComponent->m_Prev = entt::null;
 
+        // The local values stay the same but the world transform depends on the new parent
+        if(auto transformComponent = registry.try_get<TransformComponent>(entity))
+        {
+            transformComponent->MarkDirty();
+        }
+
         if(parent != entt::null)
         {
             hierarchyComponent->m_Parent = parent;
             HierarchyComponent::OnConstruct(registry, entity);
         }
+
+        // Notify the listeners (SceneTree) that the hierarchy changed
+        registry.patch<HierarchyComponent>(entity);
     }
 
     SceneTree::SceneTree(Scene* scene) : m_Context(scene)
@@ -118,51 +180,236 @@ namespace Coffee {
         registry.on_construct<HierarchyComponent>().connect<&HierarchyComponent::OnConstruct>();
         registry.on_update<HierarchyComponent>().connect<&HierarchyComponent::OnUpdate>();
         registry.on_destroy<HierarchyComponent>().connect<&HierarchyComponent::OnDestroy>();
+
+        // Any structural change invalidates the flattened hierarchy (and the cached component pointers)
+        registry.on_construct<HierarchyComponent>().connect<&SceneTree::OnHierarchyChanged>(*this);
+        registry.on_update<HierarchyComponent>().connect<&SceneTree::OnHierarchyChanged>(*this);
+        registry.on_destroy<HierarchyComponent>().connect<&SceneTree::OnHierarchyChanged>(*this);
+        registry.on_construct<TransformComponent>().connect<&SceneTree::OnHierarchyChanged>(*this);
+        registry.on_destroy<TransformComponent>().connect<&SceneTree::OnHierarchyChanged>(*this);
     }
 
-    void SceneTree::Update()
+    SceneTree::~SceneTree()
     {
         auto& registry = m_Context->m_Registry;
-        auto view = registry.view<HierarchyComponent>();
-        for(auto entity : view)
+        registry.on_construct<HierarchyComponent>().disconnect(*this);
+        registry.on_update<HierarchyComponent>().disconnect(*this);
+        registry.on_destroy<HierarchyComponent>().disconnect(*this);
+        registry.on_construct<TransformComponent>().disconnect(*this);
+        registry.on_destroy<TransformComponent>().disconnect(*this);
+    }
+
+    void SceneTree::Update()
+    {
+        ZoneScoped;
+
+        if(!m_IsFlatHierarchyValid)
         {
-            const auto hierarchy = registry.get<HierarchyComponent>(entity);
+            RebuildFlatHierarchy();
+        }
 
-            if(hierarchy.m_Parent == entt::null)
+        m_UpdatedTransformCount = 0;
+
+        // Entities of the same depth level are independent, their parents were updated in a previous level
+        for(size_t level = 0; level + 1 < m_LevelOffsets.size(); level++)
+        {
+            uint32_t levelBegin = m_LevelOffsets[level];
+            uint32_t levelEnd = m_LevelOffsets[level + 1];
+            uint32_t levelSize = levelEnd - levelBegin;
+
+            auto updateRange = [this](uint32_t begin, uint32_t end) {
+                return m_UseAffineTransforms ? UpdateAffineTransforms(begin, end) : UpdateTransforms(begin, end);
+            };
+
+            if(!m_Multithreaded || levelSize < s_ParallelBatchSize * 2)
             {
-                UpdateTransform(entity);
+                m_UpdatedTransformCount += updateRange(levelBegin, levelEnd);
+                continue;
             }
+
+            std::atomic<uint32_t> updatedTransformCount = 0;
+
+            JobSystem::ParallelFor(levelSize, s_ParallelBatchSize, [&](uint32_t begin, uint32_t end) {
+                updatedTransformCount += updateRange(levelBegin + begin, levelBegin + end);
+            });
+
+            m_UpdatedTransformCount += updatedTransformCount;
         }
     }
 
-    void SceneTree::UpdateTransform(entt::entity entity)
+    void SceneTree::GetUpdatedEntities(std::vector<entt::entity>& entities) const
     {
-        auto& registry = m_Context->m_Registry;
-        
-        auto& hierarchyComponent = registry.get<HierarchyComponent>(entity);
-        auto& transformComponent = registry.get<TransformComponent>(entity);
+        if(m_UpdatedTransformCount == 0)
+            return;
+
+        for(size_t i = 0; i < m_Entities.size(); i++)
+        {
+            if(m_DirtyFlags[i])
+            {
+                entities.push_back(m_Entities[i]);
+            }
+        }
+    }
 
-        // Update the world transform of the entity
+    uint32_t SceneTree::UpdateTransforms(uint32_t begin, uint32_t end)
+    {
+        ZoneScoped;
 
-        if(hierarchyComponent.m_Parent != entt::null)
+        uint32_t updatedTransformCount = 0;
+
+        for(uint32_t i = begin; i < end; i++)
         {
-            auto& parentTransformComponent = registry.get<TransformComponent>(hierarchyComponent.m_Parent);
+            TransformComponent& transformComponent = *m_Transforms[i];
+            int32_t parentIndex = m_ParentIndices[i];
+
+            bool isParentDirty = parentIndex != -1 && m_DirtyFlags[parentIndex];
+            bool isDirty = isParentDirty || transformComponent.IsDirty();
+
+            m_DirtyFlags[i] = isDirty;
+
+            if(!isDirty)
+            {
+                continue;
+            }
 
-            transformComponent.SetWorldTransform(parentTransformComponent.GetWorldTransform());
+            transformComponent.SetWorldTransform(parentIndex != -1 ? m_Transforms[parentIndex]->GetWorldTransform() : glm::mat4(1.0f));
+            m_WorldMatrices[i] = Affine3x4::FromMat4(transformComponent.GetWorldTransform());
+
+            updatedTransformCount++;
         }
-        else
+
+        return updatedTransformCount;
+    }
+
+    uint32_t SceneTree::UpdateAffineTransforms(uint32_t begin, uint32_t end)
+    {
+        ZoneScoped;
+
+        static const Affine3x4 identity;
+
+        const Affine3x4* parents[s_AffineBatchSize];
+        const Affine3x4* locals[s_AffineBatchSize];
+        Affine3x4* results[s_AffineBatchSize];
+        uint32_t indices[s_AffineBatchSize];
+        uint32_t batchSize = 0;
+
+        auto flushBatch = [&]() {
+            Affine3x4::MultiplyBatch(parents, locals, results, batchSize);
+
+            for(uint32_t j = 0; j < batchSize; j++)
+            {
+                m_Transforms[indices[j]]->SetWorldAffineTransform(*results[j]);
+            }
+
+            batchSize = 0;
+        };
+
+        uint32_t updatedTransformCount = 0;
+
+        for(uint32_t i = begin; i < end; i++)
+        {
+            TransformComponent& transformComponent = *m_Transforms[i];
+            int32_t parentIndex = m_ParentIndices[i];
+
+            bool isParentDirty = parentIndex != -1 && m_DirtyFlags[parentIndex];
+            bool isDirty = isParentDirty || transformComponent.IsDirty();
+
+            m_DirtyFlags[i] = isDirty;
+
+            if(!isDirty)
+            {
+                continue;
+            }
+
+            // The parents belong to a previous depth level, so they are already composed
+            parents[batchSize] = parentIndex != -1 ? &m_WorldMatrices[parentIndex] : &identity;
+            locals[batchSize] = &transformComponent.GetLocalAffineTransform();
+            results[batchSize] = &m_WorldMatrices[i];
+            indices[batchSize] = i;
+
+            if(++batchSize == s_AffineBatchSize)
+            {
+                flushBatch();
+            }
+
+            updatedTransformCount++;
+        }
+
+        flushBatch();
+
+        return updatedTransformCount;
+    }
+
+    void SceneTree::RebuildFlatHierarchy()
+    {
+        ZoneScoped;
+
+        auto& registry = m_Context->m_Registry;
+
+        m_Entities.clear();
+        m_ParentIndices.clear();
+        m_Transforms.clear();
+
+        auto pushEntity = [&](entt::entity entity, int32_t parentIndex) {
+            auto transformComponent = registry.try_get<TransformComponent>(entity);
+
+            // Entities without a transform (and their children) can not be placed in the world
+            if(transformComponent == nullptr)
+            {
+                return;
+            }
+
+            m_Entities.push_back(entity);
+            m_ParentIndices.push_back(parentIndex);
+            m_Transforms.push_back(transformComponent);
+        };
+
+        auto view = registry.view<HierarchyComponent>();
+        for(auto entity : view)
         {
-            transformComponent.SetWorldTransform(glm::mat4(1.0f));
+            if(view.get<HierarchyComponent>(entity).m_Parent == entt::null)
+            {
+                pushEntity(entity, -1);
+            }
         }
 
-        // Recursively update all the children
+        m_LevelOffsets.clear();
+        m_LevelOffsets.push_back(0);
 
-        entt::entity child = hierarchyComponent.m_First;
-        while(child != entt::null)
+        // Breadth first traversal, one depth level at a time
+        size_t levelBegin = 0;
+        while(levelBegin < m_Entities.size())
         {
-            UpdateTransform(child);
-            child = registry.get<HierarchyComponent>(child).m_Next;
+            size_t levelEnd = m_Entities.size();
+
+            for(size_t i = levelBegin; i < levelEnd; i++)
+            {
+                entt::entity child = registry.get<HierarchyComponent>(m_Entities[i]).m_First;
+                while(child != entt::null)
+                {
+                    pushEntity(child, static_cast<int32_t>(i));
+                    child = registry.get<HierarchyComponent>(child).m_Next;
+                }
+            }
+
+            m_LevelOffsets.push_back(static_cast<uint32_t>(levelEnd));
+            levelBegin = levelEnd;
         }
+
+        m_WorldMatrices.resize(m_Entities.size());
+        m_DirtyFlags.assign(m_Entities.size(), 0);
+
+        for(size_t i = 0; i < m_Entities.size(); i++)
+        {
+            m_WorldMatrices[i] = Affine3x4::FromMat4(m_Transforms[i]->GetWorldTransform());
+        }
+
+        m_IsFlatHierarchyValid = true;
+    }
+
+    void SceneTree::OnHierarchyChanged(entt::registry& registry, entt::entity entity)
+    {
+        m_IsFlatHierarchyValid = false;
     }
 
 }
\ No newline at end of file
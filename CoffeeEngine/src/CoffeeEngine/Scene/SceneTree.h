@@ -1,15 +1,18 @@
 #pragma once
 
 #include "CoffeeEngine/Core/Base.h"
+#include "CoffeeEngine/Math/AffineTransform.h"
 #include "entt/entity/fwd.hpp"
 #include <cereal/cereal.hpp>
 #include <entt/entt.hpp>
+#include <glm/glm.hpp>
 #include <vector> // Necesario para manejar los hijos
 
 namespace Coffee
 {
 
     class Scene;
+    struct TransformComponent;
 
     /**
      * @defgroup scene Scene
@@ -27,14 +30,14 @@ namespace Coffee
          * @param parent The parent entity.
          */
         HierarchyComponent(entt::entity parent)
-            : m_Parent(parent), m_First(entt::null), m_Next(entt::null), m_Prev(entt::null)
+            : m_Parent(parent), m_First(entt::null), m_Last(entt::null), m_Next(entt::null), m_Prev(entt::null)
         {
         }
 
         /**
          * @brief Default constructor.
          */
-        HierarchyComponent() : m_Parent(entt::null), m_First(entt::null), m_Next(entt::null), m_Prev(entt::null) {}
+        HierarchyComponent() : m_Parent(entt::null), m_First(entt::null), m_Last(entt::null), m_Next(entt::null), m_Prev(entt::null) {}
 
         /**
          * @brief Called when the component is constructed.
@@ -65,9 +68,18 @@ namespace Coffee
          */
         static void Reparent(entt::registry& registry, entt::entity entity, entt::entity parent);
 
+        /**
+         * @brief Get the last child of an entity in O(1).
+         * @param registry The entity registry.
+         * @param entity The parent entity.
+         * @return The last child, or entt::null if the entity has no children.
+         */
+        static entt::entity GetLastChild(entt::registry& registry, entt::entity entity);
+
         // Miembros
         entt::entity m_Parent;
         entt::entity m_First;
+        entt::entity m_Last; ///< Last child, used to append children in O(1). Not serialized.
         entt::entity m_Next;
         entt::entity m_Prev;
 
@@ -108,23 +120,109 @@ namespace Coffee
         SceneTree(Scene* scene);
 
         /**
-         * @brief Default destructor.
+         * @brief Destructor, disconnects the registry listeners.
          */
-        ~SceneTree() = default;
+        ~SceneTree();
 
         /**
          * @brief Update the scene tree.
+         *
+         * World transforms are propagated in a single linear sweep over the flattened hierarchy.
+         * Only the subtrees whose root transform is dirty are recalculated, static entities are skipped.
          */
         void Update();
 
         /**
-         * @brief Update the transform of an entity.
-         * @param entity The entity to update.
+         * @brief Get the number of world transforms recalculated in the last update.
+         * @return The number of recalculated transforms.
+         */
+        uint32_t GetUpdatedTransformCount() const { return m_UpdatedTransformCount; }
+
+        /**
+         * @brief Get the entities whose world transform was recalculated in the last update.
+         * @param entities The vector the entities are appended to.
+         */
+        void GetUpdatedEntities(std::vector<entt::entity>& entities) const;
+
+        /**
+         * @brief Enable or disable the multi-threaded transform propagation.
+         *
+         * Each depth level of the hierarchy is split across the JobSystem threads. The result is identical to
+         * the serial path because every entity only reads the world matrix of its parent, from a previous level.
+         *
+         * @param multithreaded True to update the transforms in parallel.
+         */
+        void SetMultithreaded(bool multithreaded) { m_Multithreaded = multithreaded; }
+
+        /**
+         * @brief Check if the multi-threaded transform propagation is enabled.
+         * @return True if the transforms are updated in parallel.
+         */
+        bool IsMultithreaded() const { return m_Multithreaded; }
+
+        /**
+         * @brief Enable or disable the compact affine transform propagation.
+         *
+         * When enabled the world transforms are composed as 3x4 affine matrices with SSE or AVX, gathered in batches,
+         * from the cached local transforms. When disabled every transform goes through the original 4x4 matrix path
+         * of TransformComponent::SetWorldTransform, Benchmarks/src/TransformBenchmark.cpp compares both.
+         *
+         * @param useAffineTransforms True to use the affine path.
+         */
+        void SetUseAffineTransforms(bool useAffineTransforms) { m_UseAffineTransforms = useAffineTransforms; }
+
+        /**
+         * @brief Check if the compact affine transform propagation is enabled.
+         * @return True if the affine path is used.
          */
-        void UpdateTransform(entt::entity entity);
+        bool IsUsingAffineTransforms() const { return m_UseAffineTransforms; }
+
+      private:
+        /**
+         * @brief Update the world transforms of a range of the flattened hierarchy.
+         * @param begin The first index of the range.
+         * @param end The index past the last element of the range.
+         * @return The number of recalculated transforms.
+         */
+        uint32_t UpdateTransforms(uint32_t begin, uint32_t end);
+
+        /**
+         * @brief Affine version of UpdateTransforms, the dirty transforms are gathered and composed with MultiplyBatch.
+         * @param begin The first index of the range.
+         * @param end The index past the last element of the range.
+         * @return The number of recalculated transforms.
+         */
+        uint32_t UpdateAffineTransforms(uint32_t begin, uint32_t end);
+
+        /**
+         * @brief Rebuild the flattened hierarchy arrays in parent-before-child order.
+         */
+        void RebuildFlatHierarchy();
+
+        /**
+         * @brief Called when an entity is added, removed or moved in the hierarchy.
+         * @param registry The entity registry.
+         * @param entity The entity.
+         */
+        void OnHierarchyChanged(entt::registry& registry, entt::entity entity);
 
       private:
         Scene* m_Context;
+
+        // Flattened hierarchy, sorted by depth so a parent is always before its children
+        std::vector<entt::entity> m_Entities; ///< Entities of the hierarchy.
+        std::vector<int32_t> m_ParentIndices; ///< Index of the parent of each entity, -1 for roots.
+        std::vector<TransformComponent*> m_Transforms; ///< Transform component of each entity.
+        std::vector<Affine3x4> m_WorldMatrices; ///< Packed copy of the world matrices.
+        std::vector<uint8_t> m_DirtyFlags; ///< Whether each entity was recalculated in the current update.
+        std::vector<uint32_t> m_LevelOffsets; ///< First index of each depth level, plus the total size at the end.
+        bool m_IsFlatHierarchyValid = false; ///< False when the hierarchy changed since the last rebuild.
+
+        uint32_t m_UpdatedTransformCount = 0; ///< Number of world transforms recalculated in the last update.
+        bool m_Multithreaded = true; ///< Update the transforms across the JobSystem threads.
+        bool m_UseAffineTransforms = true; ///< Compose the world transforms as 3x4 affine matrices.
+
+        static constexpr uint32_t s_AffineBatchSize = 64; ///< Number of dirty transforms gathered before composing them.
     };
 
     /** @} */ // end of scene group
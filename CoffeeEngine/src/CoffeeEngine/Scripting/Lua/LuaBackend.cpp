@@ -7,6 +7,8 @@
 #include "CoffeeEngine/Scene/Components.h"
 #include "CoffeeEngine/Scene/Entity.h"
 
+#include <algorithm>
+
 #define SOL_PRINT_ERRORS 1
 
 namespace Coffee {
@@ -340,11 +342,13 @@ namespace Coffee {
         luaState.new_usertype<Entity>("Entity",
         sol::constructors<Entity(), Entity(entt::entity, Scene*)>(),
 
+        // Structural changes are recorded and applied at the start of the next frame, scripts run inside a view loop
         "AddComponent", [](Entity& self, const std::string& componentName) {
+            auto& commandBuffer = self.GetScene()->GetCommandBuffer();
             if (componentName == "TagComponent") {
-                self.AddComponent<TagComponent>();
+                commandBuffer.AddComponent<TagComponent>(self);
             } else if (componentName == "TransformComponent") {
-                self.AddComponent<TransformComponent>();
+                commandBuffer.AddComponent<TransformComponent>(self);
             } else {
                 throw std::runtime_error("Unknown component type");
             }
@@ -375,16 +379,42 @@ namespace Coffee {
         },
 
         "RemoveComponent", [](Entity& self, const std::string& componentName) {
+            auto& commandBuffer = self.GetScene()->GetCommandBuffer();
             if (componentName == "TagComponent") {
-                self.RemoveComponent<TagComponent>();
+                commandBuffer.RemoveComponent<TagComponent>(self);
             } else if (componentName == "TransformComponent") {
-                self.RemoveComponent<TransformComponent>();
+                commandBuffer.RemoveComponent<TransformComponent>(self);
             } else {
                 throw std::runtime_error("Unknown component type");
             }
         },
 
-        "SetParent", &Entity::SetParent,
+        "SetParent", [](Entity& self, Entity parent) {
+            self.GetScene()->GetCommandBuffer().Reparent(self, parent);
+        },
+        "Destroy", [](Entity& self) {
+            self.GetScene()->GetCommandBuffer().DestroyEntity(self);
+        },
+        "Raycast", [](Entity& self, float ox, float oy, float oz, float dx, float dy, float dz, float maxDistance) {
+            // Ray distances are measured in direction lengths, the direction is normalized so they are in world units
+            glm::vec3 direction(dx, dy, dz);
+            float length = glm::length(direction);
+
+            RaycastHit hit;
+            bool isHit = length > 0.0f && self.GetScene()->Raycast(Ray({ox, oy, oz}, direction / length), maxDistance, hit);
+            Entity hitEntity = isHit ? Entity(hit.Entity, self.GetScene()) : Entity();
+            return std::make_tuple(isHit, hitEntity, hit.Distance, hit.Point.x, hit.Point.y, hit.Point.z, hit.Normal.x, hit.Normal.y, hit.Normal.z);
+        },
+        // Spatial queries on the world positions of the entities, answered by the spatial hash of the scene
+        "GetEntitiesInRadius", [](Entity& self, float x, float y, float z, float radius) {
+            return sol::as_table(self.GetScene()->GetEntitiesInRadius({x, y, z}, radius));
+        },
+        "GetEntitiesInBox", [](Entity& self, float minX, float minY, float minZ, float maxX, float maxY, float maxZ) {
+            return sol::as_table(self.GetScene()->GetEntitiesInBox(AABB({minX, minY, minZ}, {maxX, maxY, maxZ})));
+        },
+        "GetNearestEntities", [](Entity& self, float x, float y, float z, int count) {
+            return sol::as_table(self.GetScene()->GetNearestEntities({x, y, z}, static_cast<size_t>(std::max(count, 0))));
+        },
         "IsValid", [](Entity& self) { return static_cast<bool>(self); }
     );
 
@@ -346,7 +346,10 @@ LightComponent = {
 }
 
 -- Entity functions
+-- AddComponent, RemoveComponent, SetParent and Destroy are deferred: they are recorded and applied in recording
+-- order at the start of the next frame, so HasComponent and the hierarchy do not see them until then
 Entity = {
+    -- Deferred to the start of the next frame
     AddComponent = function(self, componentName)
         -- Implementation here
     end,
@@ -358,12 +361,39 @@ Entity = {
         -- Implementation here
         return false
     end,
+    -- Deferred to the start of the next frame
     RemoveComponent = function(self, componentName)
         -- Implementation here
     end,
+    -- Deferred to the start of the next frame
     SetParent = function(self, parent)
         -- Implementation here
     end,
+    -- Deferred to the start of the next frame
+    Destroy = function(self)
+        -- Implementation here
+    end,
+    -- Returns hit, entity, distance, point x, y, z and normal x, y, z
+    -- The direction does not need to be normalized, the distances are in world units. A zero direction never hits
+    Raycast = function(self, ox, oy, oz, dx, dy, dz, maxDistance)
+        -- Implementation here
+        return false, nil, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0
+    end,
+    -- Returns the entities whose position is within radius of x, y, z
+    GetEntitiesInRadius = function(self, x, y, z, radius)
+        -- Implementation here
+        return {}
+    end,
+    -- Returns the entities whose position is inside the box
+    GetEntitiesInBox = function(self, minX, minY, minZ, maxX, maxY, maxZ)
+        -- Implementation here
+        return {}
+    end,
+    -- Returns up to count entities, nearest to x, y, z first
+    GetNearestEntities = function(self, x, y, z, count)
+        -- Implementation here
+        return {}
+    end,
     IsValid = function(self)
         -- Implementation here
         return true